@@ -4,7 +4,9 @@
  */
 
 #include "fat_routines.h"
+#include "../kernel/kern_lock.h"
 #include "../kernel/kern_sys_calls.h"
+#include "../kernel/scheduler.h"
 #include "../kernel/signal.h"
 #include "../lib/pennos-errno.h"
 #include "../shell/builtins.h"
@@ -22,8 +24,6 @@
 #include <time.h>
 #include <unistd.h>
 
-extern pcb_t* current_running_pcb;
-
 ////////////////////////////////////////////////////////////////////////////////
 //                           SPECIAL ROUTINES                                 //
 ////////////////////////////////////////////////////////////////////////////////
@@ -208,10 +208,118 @@ int unmount() {
 //                             OTHER ROUTINES                                 //
 ////////////////////////////////////////////////////////////////////////////////
 
+// cat opens, reads and writes this many files per group, since opening a file
+// takes three submissions
+#define CAT_BATCH_FILES (FS_RING_SIZE / 3)
+
+/**
+ * @brief Writes files to out_fd, a group of files at a time. Each group takes
+ *        three batches: one that opens the files and finds their sizes, one
+ *        that reads and closes them, and one that writes what was read.
+ */
+static void cat_files(char** files, int num_files, int out_fd) {
+  fs_ring_t ring;
+  fs_ring_init(&ring);
+
+  for (int start = 0; start < num_files; start += CAT_BATCH_FILES) {
+    int count = num_files - start < CAT_BATCH_FILES ? num_files - start
+                                                    : CAT_BATCH_FILES;
+    int fds[CAT_BATCH_FILES];
+    int sizes[CAT_BATCH_FILES];
+    char* buffers[CAT_BATCH_FILES];
+
+    // open each file, and seek to its end and back to get its size
+    for (int i = 0; i < count; i++) {
+      *fs_ring_get_sqe(&ring) = (fs_sqe_t){
+          .op = FS_OP_OPEN, .fname = files[start + i], .mode = F_READ};
+      *fs_ring_get_sqe(&ring) = (fs_sqe_t){
+          .op = FS_OP_LSEEK, .fd = FS_LAST_OPEN, .whence = SEEK_END};
+      *fs_ring_get_sqe(&ring) = (fs_sqe_t){
+          .op = FS_OP_LSEEK, .fd = FS_LAST_OPEN, .whence = SEEK_SET};
+    }
+    k_submit(&ring);
+    for (int i = 0; i < count; i++) {
+      fds[i] = fs_ring_reap(&ring);
+      if (fds[i] < 0) {
+        // the seeks failed along with the open
+        u_perror("cat");
+        fs_ring_reap(&ring);
+        fs_ring_reap(&ring);
+        continue;
+      }
+      sizes[i] = fs_ring_reap(&ring);
+      if (fs_ring_reap(&ring) < 0 || sizes[i] < 0) {
+        u_perror("cat");
+        sizes[i] = -1;
+      }
+    }
+
+    // read each file whole, and close it
+    for (int i = 0; i < count; i++) {
+      buffers[i] = NULL;
+      if (fds[i] < 0) {
+        continue;
+      }
+      if (sizes[i] > 0) {
+        buffers[i] = malloc(sizes[i]);
+        if (buffers[i] == NULL) {
+          P_ERRNO = P_EMALLOC;
+          u_perror("cat");
+        } else {
+          *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_READ,
+                                               .fd = fds[i],
+                                               .buf = buffers[i],
+                                               .n = sizes[i]};
+        }
+      }
+      *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_CLOSE, .fd = fds[i]};
+    }
+    k_submit(&ring);
+    for (int i = 0; i < count; i++) {
+      if (fds[i] < 0) {
+        continue;
+      }
+      if (buffers[i] != NULL) {
+        sizes[i] = fs_ring_reap(&ring);
+        if (sizes[i] < 0) {
+          u_perror("cat");
+        }
+      }
+      fs_ring_reap(&ring);
+    }
+
+    // write out what was read, which the kernel merges into one write
+    for (int i = 0; i < count; i++) {
+      if (buffers[i] != NULL && sizes[i] > 0) {
+        *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_WRITE,
+                                             .fd = out_fd,
+                                             .buf = buffers[i],
+                                             .n = sizes[i]};
+      }
+    }
+    k_submit(&ring);
+    bool write_failed = false;
+    for (int i = 0; i < count; i++) {
+      if (buffers[i] != NULL && sizes[i] > 0) {
+        if (fs_ring_reap(&ring) != sizes[i] && !write_failed) {
+          u_perror("cat");
+          write_failed = true;
+        }
+      }
+      free(buffers[i]);
+    }
+
+    // the output can't take any more, e.g. a pipe nobody reads any longer
+    if (write_failed) {
+      return;
+    }
+  }
+}
+
 /**
  * @brief Concatenates and displays files.
  */
-void* cat(void* arg) {
+static void* cat_locked(void* arg) {
   char** args = (char**)arg;
 
   // verify that the file system is mounted
@@ -225,15 +333,17 @@ void* cat(void* arg) {
   if (args[1] == NULL) {
     // if none of the above conditions, then check if we need to redirect stdin
     if (current_running_pcb) {
-      // open new stdin
+      // the process's input and output belong to it, so we don't close them
       int in_fd = current_running_pcb->input_fd;
       int out_fd = current_running_pcb->output_fd;
       char* file_1 = fd_table[in_fd].filename;
       char* file_2 = fd_table[out_fd].filename;
+      bool same_file = in_fd > STDERR_FILENO && fd_table[in_fd].pipe == NULL &&
+                       strcmp(file_1, file_2) == 0;
 
       // edge case when input and output have the same file name and we're
       // appending
-      if ((strcmp(file_1, file_2) == 0) && is_append) {
+      if (same_file && is_append) {
         P_ERRNO = P_EREDIR;
         u_perror("cat");
         return NULL;
@@ -241,65 +351,31 @@ void* cat(void* arg) {
 
       // edge case when input and output files names are the same but we're not
       // appending truncates the file
-      if ((strcmp(file_1, file_2) == 0)) {
-        return NULL;
-      }
-
-      // get the size of stdin file
-      off_t in_fd_size = k_lseek(in_fd, 0, SEEK_END);
-      if (in_fd_size == -1) {
-        k_close(in_fd);
-        u_perror("cat");
-        return NULL;
-      }
-      if (k_lseek(in_fd, 0, SEEK_SET) == -1) {
-        k_close(in_fd);
-        u_perror("cat");
+      if (same_file) {
         return NULL;
       }
 
       char* buffer = (char*)malloc(block_size);
       if (buffer == NULL) {
         P_ERRNO = P_EMALLOC;
-        k_close(in_fd);
         u_perror("cat");
         return NULL;
       }
 
+      // read until end of file, so a pipe or the terminal works like a file
       int bytes_read;
-      ssize_t bytes_remaining = in_fd_size;
-
-      while (bytes_remaining > 0) {
-        ssize_t bytes_to_read =
-            bytes_remaining < block_size ? bytes_remaining : block_size;
-        bytes_read = k_read(in_fd, buffer, bytes_to_read);
-
-        if (bytes_read <= 0) {
-          break;
-        }
-
+      while ((bytes_read = k_read(in_fd, buffer, block_size)) > 0) {
         if (k_write(out_fd, buffer, bytes_read) != bytes_read) {
-          free(buffer);
-          k_close(in_fd);
           u_perror("cat");
           break;
         }
-
-        bytes_remaining -= bytes_read;
       }
 
       // read error
       if (bytes_read < 0) {
-        free(buffer);
-        k_close(in_fd);
         u_perror("cat");
-        return NULL;
       }
 
-      k_close(in_fd);
-      if (out_fd != STDOUT_FILENO) {
-        k_close(out_fd);
-      }
       free(buffer);
       return NULL;
     }
@@ -344,13 +420,15 @@ void* cat(void* arg) {
   }
 
   // handle small case: cat -w OUTPUT_FILE or cat -a OUTPUT_FILE (read from
-  // stdin)
+  // stdin, or the pipe or file the process reads from)
   if ((strcmp(args[1], "-w") == 0 || strcmp(args[1], "-a") == 0) &&
       args[2] != NULL && args[3] == NULL) {
     char buffer[1024];
+    int in_fd =
+        current_running_pcb ? current_running_pcb->input_fd : STDIN_FILENO;
 
     while (1) {
-      ssize_t bytes_read = k_read(STDIN_FILENO, buffer, sizeof(buffer));
+      ssize_t bytes_read = k_read(in_fd, buffer, sizeof(buffer));
 
       if (bytes_read < 0) {
         u_perror("cat");
@@ -387,81 +465,12 @@ void* cat(void* arg) {
     end = i - 1;  // skip the output redirection arguments
   }
 
-  // process each input file
-  for (i = start; i <= end; i++) {
-    // skip the redirection flags and their arguments
-    if (strcmp(args[i], "-w") == 0 || strcmp(args[i], "-a") == 0) {
-      i++;
-      continue;
-    }
-
-    // open the current input file
-    int in_fd = k_open(args[i], F_READ);
-    if (in_fd < 0) {
-      u_perror("cat");
-      continue;
-    }
-
-    // use lseek to get the size of in_fd
-    off_t in_fd_size = k_lseek(in_fd, 0, SEEK_END);
-    if (in_fd_size == -1) {
-      k_close(in_fd);
-      u_perror("cat");
-      continue;
-    }
-
-    // use lseek to reset position to 0 for reading
-    if (k_lseek(in_fd, 0, SEEK_SET) == -1) {
-      k_close(in_fd);
-      u_perror("cat");
-      continue;
-    }
-
-    // copy file content to output
-    char* buffer = (char*)malloc(block_size);
-    if (buffer == NULL) {
-      P_ERRNO = P_EMALLOC;
-      k_close(in_fd);
-      u_perror("cat");
-      continue;
-    }
-
-    int bytes_read;
-    ssize_t bytes_remaining = in_fd_size;
-
-    while (bytes_remaining > 0) {
-      ssize_t bytes_to_read =
-          bytes_remaining < block_size ? bytes_remaining : block_size;
-      bytes_read = k_read(in_fd, buffer, bytes_to_read);
+  // process the input files
+  cat_files(args + start, end - start + 1, out_fd);
 
-      if (bytes_read <= 0) {
-        break;
-      }
-
-      if (k_write(out_fd, buffer, bytes_read) != bytes_read) {
-        free(buffer);
-        k_close(in_fd);
-        u_perror("cat");
-        break;
-      }
-
-      bytes_remaining -= bytes_read;
-    }
-
-    // read error
-    if (bytes_read < 0) {
-      free(buffer);
-      k_close(in_fd);
-      u_perror("cat");
-      continue;
-    }
-
-    k_close(in_fd);
-    free(buffer);
-  }
-
-  // close output file if not stdout
-  if (out_fd != STDOUT_FILENO) {
+  // close the output file if we opened it; the process's own output stays
+  // open until it exits
+  if (out_mode != 0) {
     k_close(out_fd);
   }
 
@@ -473,7 +482,7 @@ void* cat(void* arg) {
  *
  * This function is a wrapper for k_ls, which is a kernel-level function.
  */
-void* ls(void* arg) {
+static void* ls_locked(void* arg) {
   // Note: we already check if fs is mounted in k_ls
 
   char** args = (char**)arg;
@@ -498,7 +507,7 @@ void* ls(void* arg) {
  * For each file argument, creates the file if it doesn't exist,
  * or updates its timestamp if it already exists.
  */
-void* touch(void* arg) {
+static void* touch_locked(void* arg) {
   char** args = (char**)arg;
 
   // verify that the file system is mounted
@@ -558,7 +567,7 @@ void* touch(void* arg) {
 /**
  * @brief Renames files.
  */
-void* mv(void* arg) {
+static void* mv_locked(void* arg) {
   char** args = (char**)arg;
 
   // verify that the file system is mounted
@@ -637,7 +646,7 @@ void* mv(void* arg) {
 /**
  * @brief Copies the source file to the destination.
  */
-void* cp(void* arg) {
+static void* cp_locked(void* arg) {
   char** args = (char**)arg;
 
   // check that we have enough arguments
@@ -695,7 +704,7 @@ void* cp(void* arg) {
 /**
  * @brief Removes files.
  */
-void* rm(void* arg) {
+static void* rm_locked(void* arg) {
   char** args = (char**)arg;
 
   // verify that the file system is mounted
@@ -767,7 +776,7 @@ void* rm(void* arg) {
  * - chmod +rw FILE (adds read and write permissions)
  * - chmod -wx FILE (removes write and executable permissions)
  */
-void* chmod(void* arg) {
+static void* chmod_locked(void* arg) {
   char** args = (char**)arg;
   if (!args || !args[0] || !args[1] || !args[2]) {
     P_ERRNO = P_EINVAL;
@@ -848,7 +857,7 @@ void* chmod(void* arg) {
 /**
  * @brief Implements compaction of root directory.
  */
-void* cmpctdir(void* arg) {
+static void* cmpctdir_locked(void* arg) {
   if (!is_mounted) {
     P_ERRNO = P_EFS_NOT_MOUNTED;
     u_perror("cmpctdir");
@@ -860,4 +869,91 @@ void* cmpctdir(void* arg) {
   }
 
   return NULL;
-}
\ No newline at end of file
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                         LOCKED ROUTINE ENTRY POINTS                        //
+////////////////////////////////////////////////////////////////////////////////
+
+// The routines above touch fat and fd_table directly, so each entry point
+// holds the kernel lock for the whole routine.
+
+/**
+ * @brief Concatenates and displays files.
+ */
+void* cat(void* arg) {
+  kernel_lock();
+  void* ret = cat_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Lists all files in the root directory.
+ */
+void* ls(void* arg) {
+  kernel_lock();
+  void* ret = ls_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Creates files or updates timestamps.
+ */
+void* touch(void* arg) {
+  kernel_lock();
+  void* ret = touch_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Renames files.
+ */
+void* mv(void* arg) {
+  kernel_lock();
+  void* ret = mv_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Copies the source file to the destination.
+ */
+void* cp(void* arg) {
+  kernel_lock();
+  void* ret = cp_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Removes files.
+ */
+void* rm(void* arg) {
+  kernel_lock();
+  void* ret = rm_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Changes the permissions of a file.
+ */
+void* chmod(void* arg) {
+  kernel_lock();
+  void* ret = chmod_locked(arg);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief Implements compaction of root directory.
+ */
+void* cmpctdir(void* arg) {
+  kernel_lock();
+  void* ret = cmpctdir_locked(arg);
+  kernel_unlock();
+  return ret;
+}
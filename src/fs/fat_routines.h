@@ -54,8 +54,11 @@ typedef struct {
     char reserved[16];
 } dir_entry_t;
 
+struct pipe_st;
+
 /**
- * @brief File descriptor entry structure for open files.
+ * @brief File descriptor entry structure for open files and pipe ends. A
+ *        pipe's read end has mode F_READ and its write end F_WRITE.
  */
 typedef struct {
   int in_use;            // 1 for in use, 0 for not in use
@@ -65,6 +68,7 @@ typedef struct {
   uint16_t first_block;  // first block of the file
   uint32_t position;     // current file position
   uint8_t mode;          // open mode (read, write, append)
+  struct pipe_st* pipe;  // the pipe if this is one of its ends, else NULL
 } fd_entry_t;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -7,6 +7,7 @@
 #include "fs_helpers.h"
 #include "fat_routines.h"
 #include "fs_kfuncs.h"
+#include "kernel/pipe.h"
 #include "lib/pennos-errno.h"
 #include "shell/builtins.h"
 
@@ -33,6 +34,15 @@ bool is_mounted = false;
 int MAX_FDS = 100;
 fd_entry_t fd_table[100];
 
+// the root directory, held in memory between dir_cache_begin and dir_cache_end
+static struct {
+  bool active;      // between dir_cache_begin and dir_cache_end
+  bool loaded;      // blocks and data hold the directory
+  int num_blocks;   // blocks in the root directory's chain
+  uint16_t* blocks; // the chain, in order
+  char* data;       // the blocks' contents, block_size bytes each
+} dir_cache;
+
 ////////////////////////////////////////////////////////////////////////////////
 //                            FD TABLE HELPERS                                //
 ////////////////////////////////////////////////////////////////////////////////
@@ -68,6 +78,7 @@ void init_fd_table(fd_entry_t* fd_table) {
     fd_table[i].first_block = 0;
     fd_table[i].position = 0;
     fd_table[i].mode = 0;
+    fd_table[i].pipe = NULL;
   }
 }
 
@@ -102,7 +113,8 @@ int increment_fd_ref_count(int fd) {
 /**
  * @brief Decrements the reference count of a file descriptor.
  *
- * If reference count reaches 0, flush field values.
+ * If reference count reaches 0, close the pipe end (if it is one) and flush
+ * field values.
  */
 int decrement_fd_ref_count(int fd) {
   if (fd < 0 || fd >= MAX_FDS) {
@@ -117,6 +129,10 @@ int decrement_fd_ref_count(int fd) {
 
   fd_table[fd].ref_count--;
   if (fd_table[fd].ref_count == 0) {
+    if (fd_table[fd].pipe != NULL) {
+      pipe_close_end(fd_table[fd].pipe, fd_table[fd].mode == F_WRITE);
+      fd_table[fd].pipe = NULL;
+    }
     fd_table[fd].in_use = 0;
     memset(fd_table[fd].filename, 0, sizeof(fd_table[fd].filename));
     fd_table[fd].size = 0;
@@ -183,6 +199,87 @@ uint16_t allocate_block() {
   return 0;
 }
 
+/**
+ * @brief Searches one block of the root directory for a file.
+ *
+ * @return the offset of the file's entry within the block, or -1 if it isn't
+ *         there
+ */
+static int find_in_dir_block(const char* data,
+                             const char* filename,
+                             dir_entry_t* entry) {
+  for (int offset = 0; offset < block_size; offset += sizeof(dir_entry_t)) {
+    const dir_entry_t* dir_entry = (const dir_entry_t*)(data + offset);
+
+    // check if we've reached the end of directory
+    if (dir_entry->name[0] == 0) {
+      break;
+    }
+
+    // skip deleted entries
+    if (dir_entry->name[0] == 1 || dir_entry->name[0] == 2) {
+      continue;
+    }
+
+    if (strcmp(dir_entry->name, filename) == 0) {
+      if (entry) {
+        memcpy(entry, dir_entry, sizeof(dir_entry_t));
+      }
+      return offset;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Drops the cached copy of the root directory. The next lookup loads
+ *        it again if caching is still on.
+ */
+static void dir_cache_drop() {
+  free(dir_cache.blocks);
+  free(dir_cache.data);
+  dir_cache.blocks = NULL;
+  dir_cache.data = NULL;
+  dir_cache.num_blocks = 0;
+  dir_cache.loaded = false;
+}
+
+/**
+ * @brief Reads the whole root directory into the cache, one host read per
+ *        block.
+ *
+ * @return 0 on success, -1 with P_ERRNO set on error
+ */
+static int dir_cache_load() {
+  int num_blocks = 1;
+  for (uint16_t block = 1; fat[block] != FAT_EOF; block = fat[block]) {
+    num_blocks++;
+  }
+
+  dir_cache.blocks = malloc(num_blocks * sizeof(uint16_t));
+  dir_cache.data = malloc((size_t)num_blocks * block_size);
+  if (dir_cache.blocks == NULL || dir_cache.data == NULL) {
+    dir_cache_drop();
+    P_ERRNO = P_EMALLOC;
+    return -1;
+  }
+
+  uint16_t block = 1;
+  for (int i = 0; i < num_blocks; i++) {
+    dir_cache.blocks[i] = block;
+    if (pread(fs_fd, dir_cache.data + i * block_size, block_size,
+              fat_size + (block - 1) * block_size) != block_size) {
+      dir_cache_drop();
+      P_ERRNO = P_EREAD;
+      return -1;
+    }
+    block = fat[block];
+  }
+  dir_cache.num_blocks = num_blocks;
+  dir_cache.loaded = true;
+  return 0;
+}
+
 /**
  * @brief Searches for a file in the root directory.
  *
@@ -194,55 +291,39 @@ int find_file(const char* filename, dir_entry_t* entry) {
     return -1;
   }
 
-  // Start with root directory block (block 1)
-  uint16_t current_block = 1;
-  int offset_in_block = 0;
-  int absolute_offset = 0;
-  dir_entry_t dir_entry;
+  // answer from the cache when there is one
+  if (dir_cache.active && (dir_cache.loaded || dir_cache_load() == 0)) {
+    for (int i = 0; i < dir_cache.num_blocks; i++) {
+      int offset = find_in_dir_block(dir_cache.data + i * block_size,
+                                     filename, entry);
+      if (offset >= 0) {
+        return fat_size + (dir_cache.blocks[i] - 1) * block_size + offset;
+      }
+    }
+    P_ERRNO = P_ENOENT;
+    return -1;
+  }
+
+  char* data = malloc(block_size);
+  if (data == NULL) {
+    P_ERRNO = P_EMALLOC;
+    return -1;
+  }
 
+  // start with root directory block (block 1), reading a block at a time
+  uint16_t current_block = 1;
   while (1) {
-    // Position at the start of current block
-    if (lseek(fs_fd, fat_size + (current_block - 1) * block_size, SEEK_SET) ==
-        -1) {
-      P_ERRNO = P_ELSEEK;
+    int block_start = fat_size + (current_block - 1) * block_size;
+    if (pread(fs_fd, data, block_size, block_start) != block_size) {
+      P_ERRNO = P_EREAD;
+      free(data);
       return -1;
     }
 
-    // reset offset for new block
-    offset_in_block = 0;
-
-    // calculate the absolute offset
-    absolute_offset = fat_size + (current_block - 1) * block_size;
-
-    // search current block
-    while (offset_in_block < block_size) {
-      if (read(fs_fd, &dir_entry, sizeof(dir_entry)) != sizeof(dir_entry)) {
-        P_ERRNO = P_EREAD;
-        return -1;
-      }
-
-      // check if we've reached the end of directory
-      if (dir_entry.name[0] == 0) {
-        break;
-      }
-
-      // check if this is a deleted entry
-      if (dir_entry.name[0] == 1 || dir_entry.name[0] == 2) {
-        offset_in_block += sizeof(dir_entry);
-        absolute_offset += sizeof(dir_entry);
-        continue;
-      }
-
-      // check if we found the file
-      if (strcmp(dir_entry.name, filename) == 0) {
-        if (entry) {
-          memcpy(entry, &dir_entry, sizeof(dir_entry));
-        }
-        return absolute_offset;  // return the absolute file offset
-      }
-
-      offset_in_block += sizeof(dir_entry);
-      absolute_offset += sizeof(dir_entry);
+    int offset = find_in_dir_block(data, filename, entry);
+    if (offset >= 0) {
+      free(data);
+      return block_start + offset;  // return the absolute file offset
     }
 
     // if we've reached the end of the current block, check if there's a next
@@ -257,6 +338,7 @@ int find_file(const char* filename, dir_entry_t* entry) {
   }
 
   // file not found
+  free(data);
   P_ERRNO = P_ENOENT;
   return -1;
 }
@@ -281,55 +363,42 @@ int add_file_entry(const char* filename,
     return -1;
   }
 
-  // start with root directory block (block 1)
-  uint16_t current_block = 1;
-  int offset = 0;
+  // initialize the new entry
   dir_entry_t dir_entry;
+  memset(&dir_entry, 0, sizeof(dir_entry));
+  strncpy(dir_entry.name, filename, 31);
+  dir_entry.size = size;
+  dir_entry.firstBlock = first_block;
+  dir_entry.type = type;
+  dir_entry.perm = perm;
+  dir_entry.mtime = time(NULL);
+
+  char* data = malloc(block_size);
+  if (data == NULL) {
+    P_ERRNO = P_EMALLOC;
+    return -1;
+  }
 
+  // start with root directory block (block 1), reading a block at a time
+  uint16_t current_block = 1;
   while (1) {
-    // position at the start of current block of the root directory
-    if (lseek(fs_fd, fat_size + (current_block - 1) * block_size, SEEK_SET) ==
-        -1) {
-      P_ERRNO = P_ELSEEK;
+    int block_start = fat_size + (current_block - 1) * block_size;
+    if (pread(fs_fd, data, block_size, block_start) != block_size) {
+      P_ERRNO = P_EREAD;
+      free(data);
       return -1;
     }
 
-    // reset offset for new block
-    offset = 0;
-
     // search current block for free slot
-    while (offset < block_size) {
-      if (read(fs_fd, &dir_entry, sizeof(dir_entry)) != sizeof(dir_entry)) {
-        P_ERRNO = P_EREAD;
-        return -1;
-      }
-
-      // found a free slot
-      if (dir_entry.name[0] == 0 || dir_entry.name[0] == 1) {
-        // initialize the new entry
-        memset(&dir_entry, 0, sizeof(dir_entry));
-        strncpy(dir_entry.name, filename, 31);
-        dir_entry.size = size;
-        dir_entry.firstBlock = first_block;
-        dir_entry.type = type;
-        dir_entry.perm = perm;
-        dir_entry.mtime = time(NULL);
-
-        // write the entry
-        if (lseek(fs_fd, fat_size + (current_block - 1) * block_size + offset,
-                  SEEK_SET) == -1) {
-          P_ERRNO = P_ELSEEK;
-          return -1;
-        }
-        if (write(fs_fd, &dir_entry, sizeof(dir_entry)) != sizeof(dir_entry)) {
-          P_ERRNO = P_EWRITE;
+    for (int offset = 0; offset < block_size; offset += sizeof(dir_entry_t)) {
+      char first_char = ((dir_entry_t*)(data + offset))->name[0];
+      if (first_char == 0 || first_char == 1) {
+        free(data);
+        if (write_dir_entry(block_start + offset, &dir_entry) == -1) {
           return -1;
         }
-
         return offset;
       }
-
-      offset += sizeof(dir_entry);
     }
 
     // current block is full, check if there's a next block
@@ -337,60 +406,48 @@ int add_file_entry(const char* filename,
       current_block = fat[current_block];
       continue;
     }
+    break;
+  }
+  free(data);
 
-    // allocate a new block for the root directory
-    uint16_t new_block = allocate_block();
-    if (new_block == 0) {
-      P_ERRNO = P_EFULL;
-      return -1;
-    }
+  // allocate a new block for the root directory
+  uint16_t new_block = allocate_block();
+  if (new_block == 0) {
+    P_ERRNO = P_EFULL;
+    return -1;
+  }
 
-    // chain the new block
-    fat[current_block] = new_block;
-    fat[new_block] = FAT_EOF;
+  // chain the new block
+  fat[current_block] = new_block;
+  fat[new_block] = FAT_EOF;
 
-    // initialize new block
-    uint8_t* zero_block = calloc(block_size, 1);
-    if (!zero_block) {
-      P_ERRNO = P_EINVAL;
-      return -1;
-    }
+  // the cached directory is missing the new block, so reload it next time
+  dir_cache_drop();
 
-    // write this new block to the file system
-    if (lseek(fs_fd, fat_size + (new_block - 1) * block_size, SEEK_SET) == -1) {
-      P_ERRNO = P_ELSEEK;
-      free(zero_block);
-      return -1;
-    }
-    if (write(fs_fd, zero_block, block_size) != block_size) {
-      P_ERRNO = P_EWRITE;
-      free(zero_block);
-      return -1;
-    }
+  // initialize new block
+  uint8_t* zero_block = calloc(block_size, 1);
+  if (!zero_block) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
 
+  // write this new block to the file system
+  if (pwrite(fs_fd, zero_block, block_size,
+             fat_size + (new_block - 1) * block_size) != block_size) {
+    P_ERRNO = P_EWRITE;
     free(zero_block);
+    return -1;
+  }
 
-    // initialize the new entry
-    memset(&dir_entry, 0, sizeof(dir_entry));
-    strncpy(dir_entry.name, filename, 31);
-    dir_entry.size = size;
-    dir_entry.firstBlock = first_block;
-    dir_entry.type = type;
-    dir_entry.perm = perm;
-    dir_entry.mtime = time(NULL);
-
-    // write the new entry at the start of the new block in the file system
-    if (lseek(fs_fd, fat_size + (new_block - 1) * block_size, SEEK_SET) == -1) {
-      P_ERRNO = P_ELSEEK;
-      return -1;
-    }
-    if (write(fs_fd, &dir_entry, sizeof(dir_entry)) != sizeof(dir_entry)) {
-      P_ERRNO = P_EWRITE;
-      return -1;
-    }
+  free(zero_block);
 
-    return 0;
+  // write the new entry at the start of the new block in the file system
+  if (write_dir_entry(fat_size + (new_block - 1) * block_size, &dir_entry) ==
+      -1) {
+    return -1;
   }
+
+  return 0;
 }
 
 /**
@@ -413,12 +470,7 @@ int mark_entry_as_deleted(dir_entry_t* entry, int absolute_offset) {
   // mark the entry as deleted in the root directory
   dir_entry_t deleted_entry = *entry;
   deleted_entry.name[0] = 1;
-  if (lseek(fs_fd, absolute_offset, SEEK_SET) == -1) {
-    P_ERRNO = P_ELSEEK;
-    return -1;
-  }
-  if (write(fs_fd, &deleted_entry, sizeof(deleted_entry)) !=
-      sizeof(deleted_entry)) {
+  if (write_dir_entry(absolute_offset, &deleted_entry) == -1) {
     P_ERRNO = P_EINVAL;
     return -1;
   }
@@ -428,6 +480,47 @@ int mark_entry_as_deleted(dir_entry_t* entry, int absolute_offset) {
   return 0;
 }
 
+/**
+ * @brief Writes a directory entry back to its slot in the root directory.
+ */
+int write_dir_entry(int offset, const dir_entry_t* entry) {
+  if (pwrite(fs_fd, entry, sizeof(dir_entry_t), offset) !=
+      sizeof(dir_entry_t)) {
+    P_ERRNO = P_EWRITE;
+    return -1;
+  }
+
+  // keep the cached copy of the entry's block in step
+  for (int i = 0; dir_cache.loaded && i < dir_cache.num_blocks; i++) {
+    int block_start = fat_size + (dir_cache.blocks[i] - 1) * block_size;
+    if (offset >= block_start && offset < block_start + block_size) {
+      memcpy(dir_cache.data + i * block_size + (offset - block_start), entry,
+             sizeof(dir_entry_t));
+      break;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                              DIRECTORY CACHE                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Starts caching the root directory.
+ */
+void dir_cache_begin() {
+  dir_cache.active = true;
+}
+
+/**
+ * @brief Stops caching the root directory and drops the cache.
+ */
+void dir_cache_end() {
+  dir_cache.active = false;
+  dir_cache_drop();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                CP HELPERS                                  //
 ////////////////////////////////////////////////////////////////////////////////
@@ -618,75 +711,75 @@ int copy_source_to_dest(const char* source_filename,
     return -1;
   }
 
-  // open the source file
-  int source_fd = k_open(source_filename, F_READ);
-  if (source_fd < 0) {
-    return -1;
-  }
-
-  // get the source file size
-  off_t source_file_size_in_bytes = k_lseek(source_fd, 0, SEEK_END);
-  if (source_file_size_in_bytes == -1) {
-    k_close(source_fd);
-    return -1;
-  }
-
-  // move to the beginning of the source file for reading
-  if (k_lseek(source_fd, 0, SEEK_SET) < 0) {
-    k_close(source_fd);
-    return -1;
-  }
+  fs_ring_t ring;
+  fs_ring_init(&ring);
 
-  // open the destination file
-  int dest_fd = k_open(dest_filename, F_WRITE);
-  if (dest_fd < 0) {
-    k_close(source_fd);
+  // open the source file, and seek to its end and back to get its size
+  *fs_ring_get_sqe(&ring) =
+      (fs_sqe_t){.op = FS_OP_OPEN, .fname = source_filename, .mode = F_READ};
+  *fs_ring_get_sqe(&ring) =
+      (fs_sqe_t){.op = FS_OP_LSEEK, .fd = FS_LAST_OPEN, .whence = SEEK_END};
+  *fs_ring_get_sqe(&ring) =
+      (fs_sqe_t){.op = FS_OP_LSEEK, .fd = FS_LAST_OPEN, .whence = SEEK_SET};
+  k_submit(&ring);
+  int source_fd = fs_ring_reap(&ring);
+  if (source_fd < 0) {
     return -1;
   }
-
-  // read from source to destination
-  char* buffer = (char*)malloc(block_size);
-  if (!buffer) {
-    P_ERRNO = P_EMALLOC;
+  int source_file_size_in_bytes = fs_ring_reap(&ring);
+  if (fs_ring_reap(&ring) < 0 || source_file_size_in_bytes < 0) {
     k_close(source_fd);
-    k_close(dest_fd);
     return -1;
   }
 
-  uint32_t bytes_remaining = source_file_size_in_bytes;
-  ssize_t bytes_read;
-
-  while (bytes_remaining > 0) {
-    // make sure the bytes to read doesn't exceed block size
-    ssize_t bytes_to_read =
-        bytes_remaining < block_size ? bytes_remaining : block_size;
-    bytes_read = k_read(source_fd, buffer, bytes_to_read);
-
-    if (bytes_read <= 0) {
-      break;
-    }
-
-    if (k_write(dest_fd, buffer, bytes_read) != bytes_read) {
-      free(buffer);
+  char* buffer = NULL;
+  if (source_file_size_in_bytes > 0) {
+    buffer = (char*)malloc(source_file_size_in_bytes);
+    if (!buffer) {
+      P_ERRNO = P_EMALLOC;
       k_close(source_fd);
-      k_close(dest_fd);
       return -1;
     }
   }
 
-  // check for read error
+  // read the whole source file, and close it. Reading before the destination
+  // is opened means a source copied onto itself isn't truncated first
+  if (buffer != NULL) {
+    *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_READ,
+                                         .fd = source_fd,
+                                         .buf = buffer,
+                                         .n = source_file_size_in_bytes};
+  }
+  *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_CLOSE, .fd = source_fd};
+  k_submit(&ring);
+  int bytes_read = buffer != NULL ? fs_ring_reap(&ring) : 0;
   if (bytes_read < 0) {
     free(buffer);
-    k_close(source_fd);
-    k_close(dest_fd);
     return -1;
   }
+  fs_ring_reap(&ring);
 
-  // otherwise, cleanup and return success
+  // open the destination file, write it and close it
+  *fs_ring_get_sqe(&ring) =
+      (fs_sqe_t){.op = FS_OP_OPEN, .fname = dest_filename, .mode = F_WRITE};
+  if (bytes_read > 0) {
+    *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_WRITE,
+                                         .fd = FS_LAST_OPEN,
+                                         .buf = buffer,
+                                         .n = bytes_read};
+  }
+  *fs_ring_get_sqe(&ring) = (fs_sqe_t){.op = FS_OP_CLOSE, .fd = FS_LAST_OPEN};
+  k_submit(&ring);
   free(buffer);
-  k_close(source_fd);
-  k_close(dest_fd);
-  return 0;
+
+  // the write and close fail along with the open, so stop at its error
+  if (fs_ring_reap(&ring) < 0) {
+    return -1;
+  }
+  if (bytes_read > 0 && fs_ring_reap(&ring) != bytes_read) {
+    return -1;
+  }
+  return fs_ring_reap(&ring) < 0 ? -1 : 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -814,6 +907,9 @@ int compact_directory() {
     }
   }
 
+  // entries are about to move, so the cached directory goes stale
+  dir_cache_drop();
+
   // rewrite the directory with only valid entries
   current_block = 1;
   int entries_per_block = block_size / sizeof(dir_entry_t);
@@ -55,7 +55,8 @@ int get_free_fd(fd_entry_t* fd_table);
 int increment_fd_ref_count(int fd);
 
 /**
- * @brief Decrements the reference count of a file descriptor.
+ * @brief Decrements the reference count of a file descriptor. The last
+ *        reference to a pipe end closes that end.
  *
  * @param fd file descriptor to decrement
  * @return new reference count, or -1 on error
@@ -115,6 +116,34 @@ int add_file_entry(const char* filename,
  */
 int mark_entry_as_deleted(dir_entry_t* entry, int offset);
 
+/**
+ * @brief Writes a directory entry back to its slot in the root directory,
+ *        keeping the directory cache up to date.
+ *
+ * @param offset absolute offset of the entry in the filesystem
+ * @param entry the entry to write
+ * @return 0 on success, -1 with P_ERRNO set to P_EWRITE on error
+ */
+int write_dir_entry(int offset, const dir_entry_t* entry);
+
+////////////////////////////////////////////////////////////////////////////////
+//                              DIRECTORY CACHE                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Starts caching the root directory. Until dir_cache_end, find_file
+ *        reads the directory from disk once and answers every later lookup
+ *        from memory. Called with the kernel lock held, which must not be
+ *        dropped before dir_cache_end, and every directory write in between
+ *        must go through write_dir_entry or add_file_entry.
+ */
+void dir_cache_begin();
+
+/**
+ * @brief Stops caching the root directory and drops the cache.
+ */
+void dir_cache_end();
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                CP HELPERS                                  //
 ////////////////////////////////////////////////////////////////////////////////
@@ -4,9 +4,13 @@
  */
 
 #include "fs_kfuncs.h"
+#include "../kernel/kern_lock.h"
 #include "../kernel/kern_pcb.h"
 #include "../kernel/kern_sys_calls.h"
+#include "../kernel/pipe.h"
+#include "../kernel/scheduler.h"
 #include "../kernel/signal.h"
+#include "../kernel/tty.h"
 #include "../lib/pennos-errno.h"
 #include "fat_routines.h"
 #include "fs_helpers.h"
@@ -14,6 +18,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,8 +27,7 @@
 #include <time.h>
 #include <unistd.h>
 
-extern pcb_t* current_running_pcb;
-extern pid_t current_fg_pid;
+extern pid_t current_fg_pgid;
 
 /**
  * @brief Kernel-level call to open a file.
@@ -111,12 +115,7 @@ int k_open(const char* fname, int mode) {
       entry.mtime = time(NULL);
 
       // update the file system with the truncated file
-      if (lseek(fs_fd, file_offset, SEEK_SET) == -1) {
-        P_ERRNO = P_ELSEEK;
-        return -1;
-      }
-      if (write(fs_fd, &entry, sizeof(entry)) != sizeof(entry)) {
-        P_ERRNO = P_EWRITE;
+      if (write_dir_entry(file_offset, &entry) == -1) {
         return -1;
       }
     }
@@ -164,14 +163,21 @@ int k_open(const char* fname, int mode) {
 int k_read(int fd, char* buf, int n) {
   // handle terminal control (if doesn't control, send a STOP signal)
   if (fd == STDIN_FILENO && current_running_pcb != NULL) {
-    if (current_running_pcb->pid != current_fg_pid) {
+    if (current_running_pcb->pgid != current_fg_pgid) {
       s_kill(current_running_pcb->pid, P_SIGSTOP);
     }
   }
 
-  // handle standard input
+  // handle standard input. A process waits on the terminal's line buffer;
+  // without a scheduler (pennfat) we read the host directly
   if (fd == STDIN_FILENO) {
-    return read(STDIN_FILENO, buf, n);
+    if (current_running_pcb != NULL) {
+      return tty_read(buf, n);
+    }
+    int depth = kernel_unlock_all();
+    int bytes_read = read(STDIN_FILENO, buf, n);
+    kernel_relock(depth);
+    return bytes_read;
   }
 
   // validate inputs
@@ -187,6 +193,15 @@ int k_read(int fd, char* buf, int n) {
     return 0;
   }
 
+  // a pipe's read end blocks until there is data or no writer is left
+  if (fd_table[fd].pipe != NULL) {
+    if (fd_table[fd].mode != F_READ) {
+      P_ERRNO = P_EBADF;
+      return -1;
+    }
+    return pipe_read(fd_table[fd].pipe, buf, n);
+  }
+
   // check if we're at EOF already
   if (fd_table[fd].position >= fd_table[fd].size) {
     return 0;
@@ -217,26 +232,23 @@ int k_read(int fd, char* buf, int n) {
   uint32_t bytes_read = 0;
 
   while (bytes_read < bytes_to_read) {
-    // how much data can we read from the current block
-    uint32_t bytes_left_in_block = block_size - block_offset;
-    uint32_t bytes_to_read_now =
-        (bytes_to_read - bytes_read) < bytes_left_in_block
-            ? (bytes_to_read - bytes_read)
-            : bytes_left_in_block;
-
-    // seek to the right position in the file
-    if (lseek(fs_fd, fat_size + (current_block - 1) * block_size + block_offset,
-              SEEK_SET) == -1) {
-      P_ERRNO = P_ELSEEK;
-      if (bytes_read > 0) {
-        fd_table[fd].position += bytes_read;
-        return bytes_read;
-      }
-      return -1;
+    // stretch the read over the blocks that follow this one on disk, so a
+    // contiguous run of the file takes a single host read
+    uint32_t run_length = block_size - block_offset;
+    uint16_t last_block = current_block;
+    while (run_length < bytes_to_read - bytes_read &&
+           fat[last_block] != FAT_EOF && fat[last_block] == last_block + 1) {
+      last_block++;
+      run_length += block_size;
     }
+    uint32_t bytes_to_read_now = (bytes_to_read - bytes_read) < run_length
+                                     ? (bytes_to_read - bytes_read)
+                                     : run_length;
 
     // read the data from the file
-    ssize_t read_result = read(fs_fd, buf + bytes_read, bytes_to_read_now);
+    ssize_t read_result =
+        pread(fs_fd, buf + bytes_read, bytes_to_read_now,
+              fat_size + (current_block - 1) * block_size + block_offset);
     if (read_result <= 0) {
       P_ERRNO = P_EREAD;
       // if we already read some data, return that count
@@ -248,23 +260,22 @@ int k_read(int fd, char* buf, int n) {
     }
 
     bytes_read += read_result;
-    block_offset += read_result;
 
-    // if we've read all data from this block and still have more to read, go to
-    // the next block
-    if (block_offset == block_size && bytes_read < bytes_to_read) {
-      if (current_block == FAT_EOF) {
+    // if we read less than expected, we might have hit EOF
+    if (read_result < bytes_to_read_now) {
+      break;
+    }
+
+    // if we've read the whole run and still have more to read, go to the
+    // block after it
+    if (bytes_read < bytes_to_read) {
+      if (fat[last_block] == FAT_EOF) {
         // unexpected end of chain
         break;
       }
-      current_block = fat[current_block];
+      current_block = fat[last_block];
       block_offset = 0;
     }
-
-    // if we read less than expected, we might have hit EOF
-    if (read_result < bytes_to_read_now) {
-      break;
-    }
   }
 
   // update file position
@@ -298,6 +309,15 @@ int k_write(int fd, const char* str, int n) {
     return 0;
   }
 
+  // a pipe's write end blocks while the pipe is full
+  if (fd_table[fd].pipe != NULL) {
+    if (fd_table[fd].mode != F_WRITE) {
+      P_ERRNO = P_EBADF;
+      return -1;
+    }
+    return pipe_write(fd_table[fd].pipe, str, n);
+  }
+
   // check if filesystem is mounted and FAT is valid
   if (!is_mounted || fat == NULL) {
     P_ERRNO = P_EFS_NOT_MOUNTED;
@@ -409,14 +429,9 @@ int k_write(int fd, const char* str, int n) {
     // if we're not writing a full block or not starting at the beginning, we
     // need to read-modify-write
     if (bytes_to_write < block_size || block_offset > 0) {
-      // read the current block
-      if (lseek(fs_fd, block_position, SEEK_SET) == -1) {
-        P_ERRNO = P_ELSEEK;
-        break;
-      }
-
       // read the current block data
-      ssize_t read_result = read(fs_fd, block_buffer, block_size);
+      ssize_t read_result =
+          pread(fs_fd, block_buffer, block_size, block_position);
       if (read_result < 0) {
         P_ERRNO = P_EREAD;
         break;
@@ -425,14 +440,9 @@ int k_write(int fd, const char* str, int n) {
       // copy the new data into the block buffer
       memcpy(block_buffer + block_offset, str + bytes_written, bytes_to_write);
 
-      // seek back to write the modified block
-      if (lseek(fs_fd, block_position, SEEK_SET) == -1) {
-        P_ERRNO = P_ELSEEK;
-        break;
-      }
-
       // write the full block back
-      ssize_t write_result = write(fs_fd, block_buffer, block_size);
+      ssize_t write_result =
+          pwrite(fs_fd, block_buffer, block_size, block_position);
       if (write_result != block_size) {
         P_ERRNO = P_EWRITE;
         // we might have a partial write, but that's hard to handle correctly
@@ -440,12 +450,8 @@ int k_write(int fd, const char* str, int n) {
       }
     } else {
       // we're writing a full block from the beginning
-      if (lseek(fs_fd, block_position, SEEK_SET) == -1) {
-        P_ERRNO = P_ELSEEK;
-        break;
-      }
-
-      ssize_t write_result = write(fs_fd, str + bytes_written, bytes_to_write);
+      ssize_t write_result =
+          pwrite(fs_fd, str + bytes_written, bytes_to_write, block_position);
       if (write_result != bytes_to_write) {
         P_ERRNO = P_EWRITE;
         break;
@@ -506,12 +512,7 @@ int k_write(int fd, const char* str, int n) {
       entry.size = fd_table[fd].size;
       entry.mtime = time(NULL);
 
-      if (lseek(fs_fd, dir_offset, SEEK_SET) == -1) {
-        P_ERRNO = P_ELSEEK;
-        return -1;
-      }
-      if (write(fs_fd, &entry, sizeof(entry)) != sizeof(entry)) {
-        P_ERRNO = P_EWRITE;
+      if (write_dir_entry(dir_offset, &entry) == -1) {
         return -1;
       }
     }
@@ -533,20 +534,17 @@ int k_close(int fd) {
   // ensure any pending changes are written to disk
   // update the directory entry with the current file size
   dir_entry_t entry;
-  int file_offset = find_file(fd_table[fd].filename, &entry);
+  int file_offset = fd_table[fd].pipe == NULL
+                        ? find_file(fd_table[fd].filename, &entry)
+                        : -1;
 
   if (file_offset >= 0) {
     // update file size if it changed
     if (entry.size != fd_table[fd].size) {
       entry.size = fd_table[fd].size;
       entry.mtime = time(NULL);
-      
-      if (lseek(fs_fd, file_offset, SEEK_SET) == -1) {
-        P_ERRNO = P_ELSEEK;
-        return -1;
-      }
-      if (write(fs_fd, &entry, sizeof(entry)) != sizeof(entry)) {
-        P_ERRNO = P_EWRITE;
+
+      if (write_dir_entry(file_offset, &entry) == -1) {
         return -1;
       }
     }
@@ -592,12 +590,7 @@ int k_unlink(const char* fname) {
   entry.name[0] = 1;
 
   // write the modified directory entry back
-  if (lseek(fs_fd, file_offset, SEEK_SET) == -1) {
-    P_ERRNO = P_ELSEEK;
-    return -1;
-  }
-  if (write(fs_fd, &entry, sizeof(entry)) != sizeof(entry)) {
-    P_ERRNO = P_EWRITE;
+  if (write_dir_entry(file_offset, &entry) == -1) {
     return -1;
   }
 
@@ -630,6 +623,12 @@ int k_lseek(int fd, int offset, int whence) {
     return -1;
   }
 
+  // neither do pipes
+  if (fd_table[fd].pipe != NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
   // calculate new position based on whence
   int32_t new_position;
 
@@ -660,6 +659,52 @@ int k_lseek(int fd, int offset, int whence) {
   return new_position;
 }
 
+/**
+ * @brief Kernel-level call to create a pipe.
+ */
+int k_pipe(int fds[2]) {
+  if (fds == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  // take both fds before the pipe, so a full table leaves nothing to undo
+  int read_fd = get_free_fd(fd_table);
+  if (read_fd < 0) {
+    P_ERRNO = P_EFULL;
+    return -1;
+  }
+  fd_table[read_fd].in_use = 1;
+  int write_fd = get_free_fd(fd_table);
+  fd_table[read_fd].in_use = 0;
+  if (write_fd < 0) {
+    P_ERRNO = P_EFULL;
+    return -1;
+  }
+
+  pipe_t* pipe = pipe_new();
+  if (pipe == NULL) {
+    return -1;  // P_ERRNO set by pipe_new
+  }
+
+  int ends[2] = {read_fd, write_fd};
+  for (int i = 0; i < 2; i++) {
+    fd_entry_t* entry = &fd_table[ends[i]];
+    entry->in_use = 1;
+    entry->ref_count = 1;
+    strncpy(entry->filename, "<pipe>", 31);
+    entry->size = 0;
+    entry->first_block = 0;
+    entry->position = 0;
+    entry->mode = i == 0 ? F_READ : F_WRITE;
+    entry->pipe = pipe;
+  }
+
+  fds[0] = read_fd;
+  fds[1] = write_fd;
+  return 0;
+}
+
 /**
  * @brief Kernel-level call to list files.
  */
@@ -810,3 +855,178 @@ int k_ls(const char* filename) {
 
   return 0;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+//                        BATCHED FILE SYSTEM CALLS                           //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Runs one submission against the given fd.
+ *
+ * @return what the matching k_ call returns
+ */
+static int run_sqe(const fs_sqe_t* sqe, int fd) {
+  switch (sqe->op) {
+    case FS_OP_OPEN:
+      return k_open(sqe->fname, sqe->mode);
+    case FS_OP_READ:
+      return k_read(fd, sqe->buf, sqe->n);
+    case FS_OP_WRITE:
+      return k_write(fd, sqe->buf, sqe->n);
+    case FS_OP_LSEEK:
+      return k_lseek(fd, sqe->offset, sqe->whence);
+    case FS_OP_CLOSE:
+      return k_close(fd);
+    case FS_OP_UNLINK:
+      return k_unlink(sqe->fname);
+  }
+  P_ERRNO = P_EINVAL;
+  return -1;
+}
+
+/**
+ * @brief Takes the submission at the head of the queue off it and posts its
+ *        completion.
+ */
+static void complete_sqe(fs_ring_t* ring, int res) {
+  const fs_sqe_t* sqe = &ring->sq[ring->sq_head++ & (FS_RING_SIZE - 1)];
+  fs_cqe_t* cqe = &ring->cq[ring->cq_tail++ & (FS_RING_SIZE - 1)];
+  cqe->res = res;
+  cqe->err = res < 0 ? P_ERRNO : 0;
+  cqe->user_data = sqe->user_data;
+}
+
+/**
+ * @brief Counts the submissions at the head of the queue that can be merged
+ *        into one read or write: the same op on the same fd, each with a
+ *        buffer and a positive length, and each with room for a completion.
+ */
+static int io_run_length(const fs_ring_t* ring, int fd, int last_open) {
+  const fs_sqe_t* first = &ring->sq[ring->sq_head & (FS_RING_SIZE - 1)];
+  unsigned int pending = ring->sq_tail - ring->sq_head;
+  unsigned int room = FS_RING_SIZE - (ring->cq_tail - ring->cq_head);
+
+  int count = 0;
+  int total = 0;
+  while (count < pending && count < room) {
+    const fs_sqe_t* sqe =
+        &ring->sq[(ring->sq_head + count) & (FS_RING_SIZE - 1)];
+    int sqe_fd = sqe->fd == FS_LAST_OPEN ? last_open : sqe->fd;
+    if (sqe->op != first->op || sqe_fd != fd || sqe->buf == NULL ||
+        sqe->n <= 0 || sqe->n > INT_MAX - total) {
+      break;
+    }
+    total += sqe->n;
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief Runs a run of reads or writes on one fd as a single k_read or
+ *        k_write through a bounce buffer, then hands each submission its
+ *        share of the result, in order.
+ *
+ * @return 0 on success, -1 if the bounce buffer couldn't be allocated (the
+ *         submissions are left on the queue)
+ */
+static int run_merged_io(fs_ring_t* ring, int count, int fd) {
+  fs_op_t op = ring->sq[ring->sq_head & (FS_RING_SIZE - 1)].op;
+  int total = 0;
+  for (int i = 0; i < count; i++) {
+    total += ring->sq[(ring->sq_head + i) & (FS_RING_SIZE - 1)].n;
+  }
+
+  char* buf = malloc(total);
+  if (buf == NULL) {
+    return -1;
+  }
+
+  int res;
+  if (op == FS_OP_WRITE) {
+    int offset = 0;
+    for (int i = 0; i < count; i++) {
+      const fs_sqe_t* sqe = &ring->sq[(ring->sq_head + i) & (FS_RING_SIZE - 1)];
+      memcpy(buf + offset, sqe->buf, sqe->n);
+      offset += sqe->n;
+    }
+    res = k_write(fd, buf, total);
+  } else {
+    res = k_read(fd, buf, total);
+  }
+
+  // a short read or write ends in the submission where it ran out, and the
+  // ones after it get 0, as if they had run one at a time
+  int handed_out = 0;
+  for (int i = 0; i < count; i++) {
+    const fs_sqe_t* sqe = &ring->sq[ring->sq_head & (FS_RING_SIZE - 1)];
+    int sqe_res = res;
+    if (res >= 0) {
+      sqe_res = res - handed_out < sqe->n ? res - handed_out : sqe->n;
+      if (op == FS_OP_READ) {
+        memcpy(sqe->buf, buf + handed_out, sqe_res);
+      }
+      handed_out += sqe_res;
+    }
+    complete_sqe(ring, sqe_res);
+  }
+
+  free(buf);
+  return 0;
+}
+
+/**
+ * @brief Kernel-level call to run a ring's submissions.
+ */
+int k_submit(fs_ring_t* ring) {
+  if (ring == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  int submitted = 0;
+  int last_open = -1;
+  dir_cache_begin();
+  while (ring->sq_head != ring->sq_tail &&
+         ring->cq_tail - ring->cq_head < FS_RING_SIZE) {
+    const fs_sqe_t* sqe = &ring->sq[ring->sq_head & (FS_RING_SIZE - 1)];
+    int fd = sqe->fd == FS_LAST_OPEN ? last_open : sqe->fd;
+
+    // reading the terminal or using a pipe may block, which lets go of the
+    // kernel lock, so the directory can change while we wait
+    bool is_pipe = fd >= 0 && fd < MAX_FDS && fd_table[fd].in_use &&
+                   fd_table[fd].pipe != NULL;
+    bool may_block =
+        (sqe->op == FS_OP_READ && fd == STDIN_FILENO) ||
+        (is_pipe && (sqe->op == FS_OP_READ || sqe->op == FS_OP_WRITE));
+    if (may_block) {
+      dir_cache_end();
+    }
+
+    // merge back-to-back reads or writes on the same fd. Reads that may
+    // block aren't merged: the first would take whatever is there and leave
+    // 0, which reads as end of file, to the rest
+    if ((sqe->op == FS_OP_READ && !may_block) || sqe->op == FS_OP_WRITE) {
+      int count = io_run_length(ring, fd, last_open);
+      if (count > 1 && run_merged_io(ring, count, fd) == 0) {
+        if (may_block) {
+          dir_cache_begin();
+        }
+        submitted += count;
+        continue;
+      }
+    }
+
+    int res = run_sqe(sqe, fd);
+    if (sqe->op == FS_OP_OPEN) {
+      last_open = res;
+    }
+    complete_sqe(ring, res);
+    if (may_block) {
+      dir_cache_begin();
+    }
+    submitted++;
+  }
+  dir_cache_end();
+  return submitted;
+}
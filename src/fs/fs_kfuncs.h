@@ -8,6 +8,7 @@
 
 #include <stddef.h>
 #include "fat_routines.h"
+#include "fs_ring.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 //                   KERNEL-RELATED FILE SYSTEM FUNCTIONS                     //
@@ -123,6 +124,25 @@ int k_unlink(const char* fname);
  */
 int k_lseek(int fd, int offset, int whence);
 
+/**
+ * @brief Creates a pipe.
+ *
+ * This is a kernel-level function that creates a pipe and opens its two ends
+ * as file descriptors: bytes written to fds[1] are read from fds[0]. A read
+ * blocks while the pipe is empty and returns 0 once it is empty and the write
+ * end is closed; a write blocks while the pipe is full. The caller owns one
+ * reference to each end, like an fd from k_open.
+ *
+ * @param fds Where to store the read end (fds[0]) and write end (fds[1]).
+ *
+ * @return 0 on success, -1 on error with P_ERRNO set.
+ *         Possible error codes:
+ *         - P_EINVAL: fds is NULL.
+ *         - P_EFULL: Fewer than two free file descriptors.
+ *         - P_EMALLOC: The pipe couldn't be allocated.
+ */
+int k_pipe(int fds[2]);
+
 /**
  * @brief Lists files or file information.
  *
@@ -140,4 +160,22 @@ int k_lseek(int fd, int offset, int whence);
  */
 int k_ls(const char* filename);
 
+/**
+ * @brief Runs the submissions queued on a ring, in order, and posts a
+ *        completion for each.
+ *
+ * This is a kernel-level function that runs a whole batch of file system
+ * operations in one pass. The root directory is read at most once for the
+ * batch, back-to-back reads or writes on the same fd are merged into one, and
+ * an fd of FS_LAST_OPEN stands for the result of the batch's latest open.
+ * Runs until the submission queue is empty or the completion queue is full.
+ *
+ * @param ring The ring to run.
+ *
+ * @return The number of submissions run, -1 on error with P_ERRNO set.
+ *         Possible error codes:
+ *         - P_EINVAL: ring is NULL.
+ */
+int k_submit(fs_ring_t* ring);
+
 #endif
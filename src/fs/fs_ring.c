@@ -0,0 +1,69 @@
+/* CS5480 PennOS Group 61
+ * Authors: Dan Kim and Kevin Zhou
+ * Purpose: Implements the process side of the file system submission ring.
+ *          The kernel side is k_submit.
+ */
+
+#include "fs_ring.h"
+#include <stddef.h>
+#include "../lib/pennos-errno.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                             FS RING FUNCTIONS                              //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Empties both queues of a ring.
+ */
+void fs_ring_init(fs_ring_t* ring) {
+  ring->sq_head = 0;
+  ring->sq_tail = 0;
+  ring->cq_head = 0;
+  ring->cq_tail = 0;
+}
+
+/**
+ * @brief Claims the next free submission slot.
+ */
+fs_sqe_t* fs_ring_get_sqe(fs_ring_t* ring) {
+  if (ring->sq_tail - ring->sq_head == FS_RING_SIZE) {
+    return NULL;
+  }
+  return &ring->sq[ring->sq_tail++ & (FS_RING_SIZE - 1)];
+}
+
+/**
+ * @brief Returns the oldest completion without removing it.
+ */
+fs_cqe_t* fs_ring_peek_cqe(fs_ring_t* ring) {
+  if (ring->cq_head == ring->cq_tail) {
+    return NULL;
+  }
+  return &ring->cq[ring->cq_head & (FS_RING_SIZE - 1)];
+}
+
+/**
+ * @brief Removes the oldest completion.
+ */
+void fs_ring_cqe_seen(fs_ring_t* ring) {
+  if (ring->cq_head != ring->cq_tail) {
+    ring->cq_head++;
+  }
+}
+
+/**
+ * @brief Removes the oldest completion and returns its result.
+ */
+int fs_ring_reap(fs_ring_t* ring) {
+  fs_cqe_t* cqe = fs_ring_peek_cqe(ring);
+  if (cqe == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  int res = cqe->res;
+  if (res < 0) {
+    P_ERRNO = cqe->err;
+  }
+  fs_ring_cqe_seen(ring);
+  return res;
+}
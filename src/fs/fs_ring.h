@@ -0,0 +1,113 @@
+/* CS5480 PennOS Group 61
+ * Authors: Dan Kim and Kevin Zhou
+ * Purpose: Defines the file system submission ring, which lets a process
+ *          queue up several file system operations and hand them to the
+ *          kernel in one call.
+ */
+
+#ifndef FS_RING_H_
+#define FS_RING_H_
+
+#define FS_RING_SIZE 64  // entries in each queue, must be a power of two
+#define FS_LAST_OPEN -2  // sqe fd meaning the fd of the batch's last open
+
+/**
+ * @brief The operations a submission can ask for. Each one behaves like the
+ *        matching s_ call.
+ */
+typedef enum fs_op_en {
+  FS_OP_OPEN,
+  FS_OP_READ,
+  FS_OP_WRITE,
+  FS_OP_LSEEK,
+  FS_OP_CLOSE,
+  FS_OP_UNLINK
+} fs_op_t;
+
+/**
+ * @brief A submission queue entry: one file system operation and its
+ *        arguments. Fields the operation doesn't use are ignored.
+ */
+typedef struct fs_sqe_st {
+  fs_op_t op;
+  int fd;             // read, write, lseek, close; may be FS_LAST_OPEN
+  const char* fname;  // open, unlink
+  int mode;           // open
+  char* buf;          // read, write
+  int n;              // read, write
+  int offset;         // lseek
+  int whence;         // lseek
+  void* user_data;    // handed back untouched in the completion
+} fs_sqe_t;
+
+/**
+ * @brief A completion queue entry: the result of one submission.
+ */
+typedef struct fs_cqe_st {
+  int res;          // what the matching s_ call would have returned
+  int err;          // P_ERRNO when res is -1, 0 otherwise
+  void* user_data;  // the submission's user_data
+} fs_cqe_t;
+
+/**
+ * @brief A process's submission and completion queues. The ring belongs to
+ *        the process that made it; the kernel only touches it inside
+ *        s_submit. Submissions complete in order, and a submission is only
+ *        taken off the submission queue once there is room for its
+ *        completion, so a process that reaps its completions never loses one.
+ */
+typedef struct fs_ring_st {
+  fs_sqe_t sq[FS_RING_SIZE];
+  fs_cqe_t cq[FS_RING_SIZE];
+  unsigned int sq_head;  // next submission the kernel runs
+  unsigned int sq_tail;  // next free submission slot
+  unsigned int cq_head;  // next completion the process reaps
+  unsigned int cq_tail;  // next free completion slot
+} fs_ring_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                             FS RING FUNCTIONS                              //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Empties both queues of a ring.
+ *
+ * @param ring a ptr to the ring
+ */
+void fs_ring_init(fs_ring_t* ring);
+
+/**
+ * @brief Claims the next free submission slot. The caller fills it in, and
+ *        it is run by the next s_submit.
+ *
+ * @param ring a ptr to the ring
+ * @return a ptr to the slot, or NULL if the submission queue is full
+ */
+fs_sqe_t* fs_ring_get_sqe(fs_ring_t* ring);
+
+/**
+ * @brief Returns the oldest completion without removing it.
+ *
+ * @param ring a ptr to the ring
+ * @return a ptr to the completion, or NULL if there is none
+ */
+fs_cqe_t* fs_ring_peek_cqe(fs_ring_t* ring);
+
+/**
+ * @brief Removes the oldest completion, once the caller is done with it.
+ *
+ * @param ring a ptr to the ring
+ */
+void fs_ring_cqe_seen(fs_ring_t* ring);
+
+/**
+ * @brief Removes the oldest completion and returns its result, setting
+ *        P_ERRNO to its error if it failed.
+ *
+ * @param ring a ptr to the ring
+ * @return the completion's res, or -1 with P_ERRNO set to P_EINVAL if there
+ *         is no completion
+ */
+int fs_ring_reap(fs_ring_t* ring);
+
+#endif  // FS_RING_H_
@@ -4,68 +4,123 @@
  */
 
 #include "fs_syscalls.h"
+#include "../kernel/kern_lock.h"
 #include "../lib/pennos-errno.h"
 #include "fs_kfuncs.h"
 
 /**
  * @brief System call to open a file.
  *
- * This is a wrapper around the kernel function k_open.
+ * This is a wrapper around the kernel function k_open, called with the kernel
+ * lock held.
  */
 int s_open(const char* fname, int mode) {
-  return k_open(fname, mode);
+  kernel_lock();
+  int ret = k_open(fname, mode);
+  kernel_unlock();
+  return ret;
 }
 
 /**
  * @brief System call to read from a file.
  *
- * This is a wrapper around the kernel function k_read.
+ * This is a wrapper around the kernel function k_read, called with the kernel
+ * lock held.
  */
 int s_read(int fd, char* buf, int n) {
-  return k_read(fd, buf, n);
+  kernel_lock();
+  int ret = k_read(fd, buf, n);
+  kernel_unlock();
+  return ret;
 }
 
 /**
  * @brief System call to write to a file.
  *
- * This is a wrapper around the kernel function k_write.
+ * This is a wrapper around the kernel function k_write, called with the kernel
+ * lock held.
  */
 int s_write(int fd, const char* str, int n) {
-  return k_write(fd, str, n);
+  kernel_lock();
+  int ret = k_write(fd, str, n);
+  kernel_unlock();
+  return ret;
 }
 
 /**
  * @brief System call to close a file.
  *
- * This is a wrapper around the kernel function k_close.
+ * This is a wrapper around the kernel function k_close, called with the kernel
+ * lock held.
  */
 int s_close(int fd) {
-  return k_close(fd);
+  kernel_lock();
+  int ret = k_close(fd);
+  kernel_unlock();
+  return ret;
 }
 
 /**
  * @brief System call to remove a file.
  *
- * This is a wrapper around the kernel function k_unlink.
+ * This is a wrapper around the kernel function k_unlink, called with the kernel
+ * lock held.
  */
 int s_unlink(const char* fname) {
-  return k_unlink(fname);
+  kernel_lock();
+  int ret = k_unlink(fname);
+  kernel_unlock();
+  return ret;
 }
 
 /**
  * @brief System call to reposition the file offset.
  *
- * This is a wrapper around the kernel function k_lseek.
+ * This is a wrapper around the kernel function k_lseek, called with the kernel
+ * lock held.
  */
 int s_lseek(int fd, int offset, int whence) {
-  return k_lseek(fd, offset, whence);
+  kernel_lock();
+  int ret = k_lseek(fd, offset, whence);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief System call to create a pipe.
+ *
+ * This is a wrapper around the kernel function k_pipe, called with the kernel
+ * lock held.
+ */
+int s_pipe(int fds[2]) {
+  kernel_lock();
+  int ret = k_pipe(fds);
+  kernel_unlock();
+  return ret;
 }
 
 /**
  * @brief System call to list files.
  *
- * This is a wrapper around the kernel function k_ls.
+ * This is a wrapper around the kernel function k_ls, called with the kernel
+ * lock held.
  */
 int s_ls(const char* filename) {
-  return k_ls(filename);
-}
\ No newline at end of file
+  kernel_lock();
+  int ret = k_ls(filename);
+  kernel_unlock();
+  return ret;
+}
+
+/**
+ * @brief System call to run a ring's queued file system operations.
+ *
+ * This is a wrapper around the kernel function k_submit, called with the
+ * kernel lock held.
+ */
+int s_submit(fs_ring_t* ring) {
+  kernel_lock();
+  int ret = k_submit(ring);
+  kernel_unlock();
+  return ret;
+}
@@ -7,6 +7,7 @@
 #define FS_SYS_CALLS_H_
 
 #include <stddef.h>
+#include "fs_ring.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 //       SYSTEM-LEVEL FILE SYSTEM VARIABLES (USER-ACCESSIBLE)                 //
@@ -133,6 +134,25 @@ int s_unlink(const char* fname);
  */
 int s_lseek(int fd, int offset, int whence);
 
+/**
+ * @brief Creates a pipe.
+ *
+ * This function creates a pipe and stores its read end in fds[0] and its
+ * write end in fds[1]. A read blocks while the pipe is empty and returns 0
+ * once it is empty and every write end is closed. A write blocks while the
+ * pipe is full and fails with P_EPIPE once every read end is closed. The
+ * caller must close or hand to s_spawn each end, like an fd from s_open.
+ *
+ * @param fds Where to store the two file descriptors.
+ *
+ * @return On success, returns 0.
+ *         On error, returns -1 and sets P_ERRNO appropriately:
+ *         - P_EINVAL: fds is NULL.
+ *         - P_EFULL: There are fewer than two free file descriptors.
+ *         - P_EMALLOC: The pipe could not be allocated.
+ */
+int s_pipe(int fds[2]);
+
 /**
  * @brief Lists files in the current directory or displays file information.
  *
@@ -149,4 +169,24 @@ int s_lseek(int fd, int offset, int whence);
  */
 int s_ls(const char* filename);
 
+/**
+ * @brief Runs the file system operations queued on a ring.
+ *
+ * This function hands every submission queued on the ring to the kernel in a
+ * single call. The submissions run in order, and each one posts a completion
+ * holding what the matching s_ call would have returned and the P_ERRNO it
+ * would have set. A submission's fd may be FS_LAST_OPEN, the fd returned by
+ * the latest open of the same call, so a file can be opened, used and closed
+ * in one batch. The whole batch enters the kernel once, taking the kernel lock
+ * a single time where the matching s_ calls would each take and drop it.
+ *
+ * @param ring The ring to run.
+ *
+ * @return On success, returns the number of submissions run. Fewer than were
+ *         queued are run if the completion queue fills up.
+ *         On error, returns -1 and sets P_ERRNO appropriately:
+ *         - P_EINVAL: ring is NULL.
+ */
+int s_submit(fs_ring_t* ring);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the copy-on-write per-process fd tables.
+ */
+
+#include "fd_table.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include "../fs/fs_helpers.h"
+#include "../fs/fs_syscalls.h"
+#include "../lib/pennos-errno.h"
+#include "../shell/builtins.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Allocates an unshared table with every slot set to -1.
+ */
+static fd_table_t* fd_table_alloc(int capacity) {
+  fd_table_t* table = malloc(sizeof(fd_table_t) + capacity * sizeof(int));
+  if (table == NULL) {
+    return NULL;
+  }
+  table->ref_count = 1;
+  table->len = 0;
+  table->capacity = capacity;
+  for (int i = 0; i < capacity; i++) {
+    table->fds[i] = -1;
+  }
+  return table;
+}
+
+/**
+ * @brief Drops a table's reference to a system-wide fd, closing the fd if no
+ *        other table holds it.
+ */
+static void release_sys_fd(int sys_fd) {
+  if (decrement_fd_ref_count(sys_fd) == 0) {
+    if (s_close(sys_fd) == -1) {
+      u_perror("closing on a non-valid fd");
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                             FD TABLE FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Creates the fd table of init.
+ */
+fd_table_t* fd_table_new() {
+  fd_table_t* table = fd_table_alloc(FD_TABLE_INITIAL_SIZE);
+  if (table == NULL) {
+    return NULL;
+  }
+  table->fds[0] = STDIN_FILENO;
+  table->fds[1] = STDOUT_FILENO;
+  table->fds[2] = STDERR_FILENO;
+  table->len = 3;
+
+  increment_fd_ref_count(STDIN_FILENO);
+  increment_fd_ref_count(STDOUT_FILENO);
+  increment_fd_ref_count(STDERR_FILENO);
+  return table;
+}
+
+/**
+ * @brief Shares an fd table with one more process.
+ */
+fd_table_t* fd_table_share(fd_table_t* table) {
+  table->ref_count++;
+  return table;
+}
+
+/**
+ * @brief Looks up the system-wide fd behind a process's fd.
+ */
+int fd_table_get(const fd_table_t* table, int fd) {
+  if (fd < 0 || fd >= table->len) {
+    return -1;
+  }
+  return table->fds[fd];
+}
+
+/**
+ * @brief Points a process's fd at a system-wide fd.
+ */
+int fd_table_set(fd_table_t** table, int fd, int sys_fd) {
+  if (fd < 0) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  fd_table_t* old = *table;
+  if (fd_table_get(old, fd) == sys_fd) {
+    return 0;
+  }
+  if (old->ref_count > 1 || fd >= old->capacity) {
+    // copy (and maybe grow) the table. A copy holds its own reference to
+    // every fd in it; a table that only grew hands its references over
+    int capacity = old->capacity;
+    while (fd >= capacity) {
+      capacity *= 2;
+    }
+    fd_table_t* copy = fd_table_alloc(capacity);
+    if (copy == NULL) {
+      P_ERRNO = P_ENULL;
+      return -1;
+    }
+    copy->len = old->len;
+    for (int i = 0; i < old->len; i++) {
+      copy->fds[i] = old->fds[i];
+      if (old->ref_count > 1 && copy->fds[i] != -1) {
+        increment_fd_ref_count(copy->fds[i]);
+      }
+    }
+
+    if (old->ref_count > 1) {
+      old->ref_count--;
+    } else {
+      free(old);
+    }
+    *table = copy;
+  }
+
+  fd_table_t* curr = *table;
+  int prev_sys_fd = fd < curr->len ? curr->fds[fd] : -1;
+  curr->fds[fd] = sys_fd;
+  if (fd >= curr->len) {
+    curr->len = fd + 1;
+  }
+  if (prev_sys_fd != -1) {
+    release_sys_fd(prev_sys_fd);
+  }
+  return 0;
+}
+
+/**
+ * @brief Drops a process's reference to its fd table.
+ */
+void fd_table_release(fd_table_t* table) {
+  if (table == NULL || --table->ref_count > 0) {
+    return;
+  }
+  for (int i = 0; i < table->len; i++) {
+    if (table->fds[i] != -1) {
+      release_sys_fd(table->fds[i]);
+    }
+  }
+  free(table);
+}
@@ -0,0 +1,83 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the per-process fd tables, which map a process's fds to
+ *          entries of the system-wide fd table. A child shares its parent's
+ *          table until one of them changes it (copy-on-write).
+ */
+
+#ifndef FD_TABLE_H_
+#define FD_TABLE_H_
+
+#define FD_TABLE_INITIAL_SIZE 4  // fds a new table has room for
+
+/**
+ * @brief A per-process fd table. Slot i holds the system-wide fd that the
+ *        process's fd i refers to, or -1. Only slots below len can be in use,
+ *        so walking a table never looks past the highest fd ever set.
+ *
+ *        The system-wide ref_count of an fd counts the tables holding it, not
+ *        the processes: processes sharing a table don't touch it, and it is
+ *        only adjusted when a table is copied or freed.
+ */
+typedef struct fd_table_st {
+  int ref_count;  // number of pcbs sharing the table
+  int len;        // slots [0, len) may be in use, the rest are -1
+  int capacity;   // number of slots allocated
+  int fds[];
+} fd_table_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                             FD TABLE FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Creates the fd table of init, with stdin, stdout and stderr at fds
+ *        0, 1 and 2.
+ *
+ * @return a ptr to the table, or NULL if it couldn't be allocated
+ */
+fd_table_t* fd_table_new();
+
+/**
+ * @brief Shares an fd table with one more process, e.g. a new child. Takes
+ *        O(1) regardless of the number of open fds.
+ *
+ * @param table the table to share
+ * @return the same table
+ */
+fd_table_t* fd_table_share(fd_table_t* table);
+
+/**
+ * @brief Looks up the system-wide fd behind a process's fd.
+ *
+ * @param table the process's table
+ * @param fd    the process's fd
+ * @return the system-wide fd, or -1 if fd isn't in use
+ */
+int fd_table_get(const fd_table_t* table, int fd);
+
+/**
+ * @brief Points a process's fd at a system-wide fd, taking over the caller's
+ *        reference to it (as for the fds s_spawn hands a child). The fd it
+ *        pointed at before is released. Does nothing if fd already points at
+ *        sys_fd. If the table is shared it is copied first, and it grows past
+ *        its capacity as needed. Called with the kernel lock held.
+ *
+ * @param table  the process's table, updated if it had to be copied or grown
+ * @param fd     the process's fd
+ * @param sys_fd the system-wide fd, or -1 to clear the slot
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL for a negative fd or
+ *         P_ENULL if the table couldn't be copied or grown
+ */
+int fd_table_set(fd_table_t** table, int fd, int sys_fd);
+
+/**
+ * @brief Drops a process's reference to its fd table. When the last process
+ *        lets go, the table's fds are released, closing those no other table
+ *        holds, and the table is freed. Called with the kernel lock held.
+ *
+ * @param table the table to release, may be NULL
+ */
+void fd_table_release(fd_table_t* table);
+
+#endif  // FD_TABLE_H_
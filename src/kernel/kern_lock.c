@@ -0,0 +1,64 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the kernel lock.
+ */
+
+#include "kern_lock.h"
+#include <pthread.h>
+#include <signal.h>
+#include "../lib/spthread.h"
+
+static pthread_mutex_t kernel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local int lock_depth = 0;      // levels held by this thread
+static _Thread_local sigset_t unlocked_mask;  // mask to restore on release
+
+/**
+ * @brief Acquires the kernel lock.
+ */
+void kernel_lock() {
+  if (lock_depth++ > 0) {
+    return;
+  }
+
+  sigset_t block_set;
+  sigemptyset(&block_set);
+  sigaddset(&block_set, SIGPTHD);
+  sigaddset(&block_set, SIGINT);
+  sigaddset(&block_set, SIGTSTP);
+  pthread_sigmask(SIG_BLOCK, &block_set, &unlocked_mask);
+  pthread_mutex_lock(&kernel_mutex);
+}
+
+/**
+ * @brief Releases one level of the kernel lock.
+ */
+void kernel_unlock() {
+  if (--lock_depth > 0) {
+    return;
+  }
+
+  pthread_mutex_unlock(&kernel_mutex);
+  pthread_sigmask(SIG_SETMASK, &unlocked_mask, NULL);
+}
+
+/**
+ * @brief Fully releases the kernel lock.
+ */
+int kernel_unlock_all() {
+  int depth = lock_depth;
+  if (depth > 0) {
+    lock_depth = 1;
+    kernel_unlock();
+  }
+  return depth;
+}
+
+/**
+ * @brief Re-acquires the kernel lock after kernel_unlock_all.
+ */
+void kernel_relock(int depth) {
+  if (depth > 0) {
+    kernel_lock();
+    lock_depth = depth;
+  }
+}
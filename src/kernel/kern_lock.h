@@ -0,0 +1,48 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the kernel lock that serializes access to kernel data
+ *          (pcbs, scheduler queues, fd_table, fat) between virtual cpus.
+ */
+
+#ifndef KERN_LOCK_H_
+#define KERN_LOCK_H_
+
+////////////////////////////////////////////////////////////////////////////////
+//                           KERNEL LOCK FUNCTIONS                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Acquires the kernel lock. The lock is recursive, so kernel functions
+ *        that call each other may each take it.
+ *
+ * While the lock is held, SIGPTHD, SIGINT and SIGTSTP are blocked on the
+ * calling thread. A process can therefore not be suspended by its scheduler,
+ * and the shell's signal handlers can not re-enter the kernel, while it is in
+ * the middle of updating kernel data.
+ */
+void kernel_lock();
+
+/**
+ * @brief Releases one level of the kernel lock. The signal mask is restored
+ *        once the outermost level is released.
+ */
+void kernel_unlock();
+
+/**
+ * @brief Fully releases the kernel lock, no matter how many levels the calling
+ *        thread holds. Used before a process waits for something (being
+ *        suspended by the scheduler, the terminal) that needs other threads to
+ *        make progress in the kernel.
+ *
+ * @return the number of levels that were held, to pass to kernel_relock
+ */
+int kernel_unlock_all();
+
+/**
+ * @brief Re-acquires the kernel lock after kernel_unlock_all.
+ *
+ * @param depth the value returned by kernel_unlock_all
+ */
+void kernel_relock(int depth);
+
+#endif  // KERN_LOCK_H_
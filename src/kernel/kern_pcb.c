@@ -10,16 +10,15 @@
 #include "../lib/pennos-errno.h"
 #include "../shell/builtins.h"
 #include "logger.h"
+#include "msg.h"
+#include "pcb_alloc.h"
+#include "pgrp.h"
+#include "pid_table.h"
 #include "scheduler.h"
+#include "shm.h"
 #include "stdio.h"  // for perror
 #include "stdlib.h"
 
-int next_pid = 2;  // global variable to track the next pid to be assigned
-                   // Note: Starts at 2 because init is 1
-
-extern Vec current_pcbs;
-extern pcb_t* current_running_pcb;
-
 ////////////////////////////////////////////////////////////////////////////////
 //                              PCB FUNCTIONS                                 //
 ////////////////////////////////////////////////////////////////////////////////
@@ -31,9 +30,10 @@ void free_pcb(void* pcb) {
   pcb_t* casted_pcb = (pcb_t*)pcb;
 
   free(casted_pcb->cmd_str);
-  vec_destroy(&casted_pcb->child_pcbs);  // will free any remaining
-                                         // children too!
-  free(casted_pcb);
+  fd_table_release(casted_pcb->fd_table);
+  pgrp_leave(casted_pcb);
+  pgrp_pid_free(casted_pcb->pid);  // held back while a group goes by it
+  pcb_free(casted_pcb);
 }
 
 /**
@@ -44,9 +44,9 @@ pcb_t* create_pcb(pid_t pid,
                   int priority,
                   int input_fd,
                   int output_fd) {
-  pcb_t* ret_pcb = malloc(sizeof(pcb_t));
+  pcb_t* ret_pcb = pcb_alloc();
   if (ret_pcb == NULL) {
-    perror("malloc failed for PCB creation");
+    perror("pcb_alloc failed for PCB creation");
     return NULL;
   }
 
@@ -58,30 +58,177 @@ pcb_t* create_pcb(pid_t pid,
   ret_pcb->output_fd = output_fd;
   ret_pcb->process_status = 0;  // default status
 
-  ret_pcb->child_pcbs = vec_new(0, NULL);  // NULL deconstructor prevents
-                                           // double free
-
-  for (int i = 0; i < 3; i++) {
-    ret_pcb->signals[i] = false;
-  }
+  ret_pcb->pending_signals = 0;  // no signals pending
+  ret_pcb->signal_prev = NULL;
+  ret_pcb->signal_next = NULL;
 
   ret_pcb->is_sleeping = false;
   ret_pcb->time_to_wake = -1;  // default to not sleeping
+  ret_pcb->sleep_heap_index = -1;
+
+  ret_pcb->queue_prev = NULL;
+  ret_pcb->queue_next = NULL;
+  ret_pcb->queue = NULL;  // not on any scheduler queue yet
+  ret_pcb->pid_next = NULL;
+
+  ret_pcb->pgid = 0;  // set by k_proc_create
+  ret_pcb->pgrp = NULL;
+  ret_pcb->pgrp_prev = NULL;
+  ret_pcb->pgrp_next = NULL;
+
+  ret_pcb->parent = NULL;  // set by k_proc_create
+  ret_pcb->children = NULL;
+  ret_pcb->sibling_prev = NULL;
+  ret_pcb->sibling_next = NULL;
+  pcb_queue_init(&ret_pcb->zombies);
+  pcb_queue_init(&ret_pcb->child_wait_queue);
+  ret_pcb->waitpid_target = 0;
+
+  ret_pcb->base_priority = priority;
+  ret_pcb->held_mutexes = NULL;
+  ret_pcb->blocked_on = NULL;
+  ret_pcb->sem_granted = NULL;
+
+  ret_pcb->cpu = 0;
+  ret_pcb->on_cpu = -1;
+  ret_pcb->yield_pending = false;
+
+  ret_pcb->tickets = 0;
+  ret_pcb->vtime = 0;
+  ret_pcb->heap_index = -1;
+
+  ret_pcb->all_prev = NULL;
+  ret_pcb->all_next = NULL;
+  ret_pcb->cmd_str = NULL;
+  ret_pcb->fd_table = NULL;  // set by k_proc_create
+  ret_pcb->shm_attachments = NULL;
+  ret_pcb->mailbox_head = NULL;
+  ret_pcb->mailbox_tail = NULL;
+  pcb_queue_init(&ret_pcb->mailbox_wait_queue);
+  ret_pcb->msgs_owned = 0;
 
   return ret_pcb;
 }
 
+/**
+ * @brief Checks if a child is one s_waitpid with the given pid waits for.
+ */
+bool waitpid_matches(pid_t pid, const pcb_t* child) {
+  if (pid == -1) {
+    return true;
+  } else if (pid < -1) {
+    return child->pgid == -pid;
+  }
+  return child->pid == pid;
+}
+
 /**
  * @brief Removes a child PCB from its parent's child list.
  */
 void remove_child_in_parent(pcb_t* parent, pcb_t* child) {
-  for (int i = 0; i < vec_len(&parent->child_pcbs); i++) {
-    pcb_t* curr_child = (pcb_t*)vec_get(&parent->child_pcbs, i);
-    if (curr_child->pid == child->pid) {
-      vec_erase_no_deletor(&parent->child_pcbs, i);
-      return;
-    }
+  if (child->sibling_prev != NULL) {
+    child->sibling_prev->sibling_next = child->sibling_next;
+  } else if (parent->children == child) {
+    parent->children = child->sibling_next;
+  } else {
+    return;  // not a child of parent
+  }
+  if (child->sibling_next != NULL) {
+    child->sibling_next->sibling_prev = child->sibling_prev;
+  }
+  child->sibling_prev = NULL;
+  child->sibling_next = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                            PCB QUEUE FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes an empty PCB queue.
+ */
+void pcb_queue_init(pcb_queue_t* queue) {
+  queue->head = NULL;
+  queue->tail = NULL;
+  queue->length = 0;
+}
+
+/**
+ * @brief Appends the PCB to the back of the queue, unlinking it from any
+ * queue it was previously on.
+ */
+void pcb_queue_push_back(pcb_queue_t* queue, pcb_t* pcb) {
+  pcb_queue_remove(pcb);
+
+  pcb->queue_prev = queue->tail;
+  pcb->queue_next = NULL;
+  if (queue->tail != NULL) {
+    queue->tail->queue_next = pcb;
+  } else {
+    queue->head = pcb;
+  }
+  queue->tail = pcb;
+  queue->length++;
+  pcb->queue = queue;
+}
+
+/**
+ * @brief Removes and returns the PCB at the front of the queue.
+ */
+pcb_t* pcb_queue_pop_front(pcb_queue_t* queue) {
+  pcb_t* front = queue->head;
+  if (front != NULL) {
+    pcb_queue_remove(front);
   }
+  return front;
+}
+
+/**
+ * @brief Unlinks the PCB from whichever queue it is on.
+ */
+void pcb_queue_remove(pcb_t* pcb) {
+  pcb_queue_t* queue = pcb->queue;
+  if (queue == NULL) {
+    return;
+  }
+
+  if (pcb->queue_prev != NULL) {
+    pcb->queue_prev->queue_next = pcb->queue_next;
+  } else {
+    queue->head = pcb->queue_next;
+  }
+  if (pcb->queue_next != NULL) {
+    pcb->queue_next->queue_prev = pcb->queue_prev;
+  } else {
+    queue->tail = pcb->queue_prev;
+  }
+  queue->length--;
+
+  pcb->queue_prev = NULL;
+  pcb->queue_next = NULL;
+  pcb->queue = NULL;
+}
+
+/**
+ * @brief Moves every PCB of one queue to the back of another.
+ */
+void pcb_queue_splice(pcb_queue_t* dst, pcb_queue_t* src) {
+  if (src->head == NULL) {
+    return;
+  }
+  for (pcb_t* pcb = src->head; pcb != NULL; pcb = pcb->queue_next) {
+    pcb->queue = dst;
+  }
+
+  src->head->queue_prev = dst->tail;
+  if (dst->tail != NULL) {
+    dst->tail->queue_next = src->head;
+  } else {
+    dst->head = src->head;
+  }
+  dst->tail = src->tail;
+  dst->length += src->length;
+  pcb_queue_init(src);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -94,52 +241,57 @@ void remove_child_in_parent(pcb_t* parent, pcb_t* child) {
  */
 pcb_t* k_proc_create(pcb_t* parent, int priority) {
   if (parent == NULL) {  // init creation case
-    pcb_t* init = create_pcb(1, 0, 0, 0, 1);
+    pid_t pid = pid_alloc();  // 1, the first pid handed out
+    if (pid == -1) {
+      return NULL;
+    }
+    pcb_t* init = create_pcb(pid, 0, 0, 0, 1);
     if (init == NULL) {
+      pid_free(pid);
       P_ERRNO = P_ENULL;
       return NULL;
     }
-    init->fd_table[0] = STDIN_FILENO;
-    init->fd_table[1] = STDOUT_FILENO;
-    init->fd_table[2] = STDERR_FILENO;
-    for (int i = 3; i < FILE_DESCRIPTOR_TABLE_SIZE; i++) {
-      init->fd_table[i] = -1;
+    init->fd_table = fd_table_new();
+    if (init->fd_table == NULL || pgrp_join(init, pid) == -1) {
+      free_pcb(init);
+      P_ERRNO = P_ENULL;
+      return NULL;
     }
 
-    increment_fd_ref_count(STDIN_FILENO);
-    increment_fd_ref_count(STDOUT_FILENO);
-    increment_fd_ref_count(STDERR_FILENO);
-
-    current_running_pcb = init;
-    put_pcb_into_correct_queue(init);
-    vec_push_back(&current_pcbs, init);
+    add_to_current_pcbs(init);
+    pid_table_insert(init);
     return init;
   }
 
-  pcb_t* child = create_pcb(next_pid++, parent->pid, priority, parent->input_fd,
+  pid_t pid = pid_alloc();
+  if (pid == -1) {
+    return NULL;  // P_EAGAIN, every pid is taken
+  }
+  pcb_t* child = create_pcb(pid, parent->pid, priority, parent->input_fd,
                             parent->output_fd);
   if (child == NULL) {
+    pid_free(pid);
     P_ERRNO = P_ENULL;
     return NULL;
   }
 
-  // copy parent's fd table
-  for (int i = 0; i < FILE_DESCRIPTOR_TABLE_SIZE; i++) {
-    child->fd_table[i] = parent->fd_table[i];
-  }
+  // share parent's fd table, it is copied once either of them changes it
+  child->fd_table = fd_table_share(parent->fd_table);
 
-  for (int i = 0; i < FILE_DESCRIPTOR_TABLE_SIZE; i++) {
-    if (child->fd_table[i] != -1) {
-      increment_fd_ref_count(child->fd_table[i]);
-    }
-  }
+  // join the parent's group, which exists, so this can't fail
+  pgrp_join(child, parent->pgid);
 
-  // update parent as needed
-  vec_push_back(&parent->child_pcbs, child);
+  // update parent as needed, the child starts on the parent's cpu
+  child->parent = parent;
+  child->cpu = parent->cpu;
+  child->sibling_next = parent->children;
+  if (parent->children != NULL) {
+    parent->children->sibling_prev = child;
+  }
+  parent->children = child;
 
-  // add to appropriate queue
-  put_pcb_into_correct_queue(child);
-  vec_push_back(&current_pcbs, child);
+  add_to_current_pcbs(child);
+  pid_table_insert(child);
 
   return child;
 }
@@ -152,7 +304,7 @@ pcb_t* k_proc_create(pcb_t* parent, int priority) {
 void k_proc_cleanup(pcb_t* proc) {
   // if proc has parent (i.e. isn't init) then remove it from parent's child
   // list
-  pcb_t* par_pcb = get_pcb_in_queue(&current_pcbs, proc->par_pid);
+  pcb_t* par_pcb = proc->parent;
   if (par_pcb != NULL) {
     remove_child_in_parent(par_pcb, proc);
   } else {
@@ -160,38 +312,43 @@ void k_proc_cleanup(pcb_t* proc) {
     return;
   }
 
-  // if proc has children, remove them and assign them to init parent
-  if (vec_len(&proc->child_pcbs) > 0) {
-    // retrieve the init process
-    pcb_t* init_pcb =
-        get_pcb_in_queue(&current_pcbs, 1);  // init process has pid 1
+  // if proc has children, hand them over to init: each one gets its new
+  // parent, then the whole list and zombie queue are spliced onto init's
+  if (proc->children != NULL) {
+    pcb_t* init_pcb = pid_table_get(1);  // init process has pid 1
+    pcb_queue_splice(&init_pcb->zombies, &proc->zombies);
 
-    while (vec_len(&proc->child_pcbs) > 0) {
-      pcb_t* curr_child = vec_get(&proc->child_pcbs, 0);
-      vec_push_back(&init_pcb->child_pcbs, curr_child);
-      vec_erase_no_deletor(&proc->child_pcbs, 0);  // don't free in erase
-      curr_child->par_pid = 1;  // update parent to init (pid 1)
-      log_generic_event('O', curr_child->pid, curr_child->priority,
-                        curr_child->cmd_str);
+    pcb_t* last_child = NULL;
+    bool has_zombie = false;
+    for (pcb_t* child = proc->children; child != NULL;
+         child = child->sibling_next) {
+      child->par_pid = 1;  // update parent to init (pid 1)
+      child->parent = init_pcb;
+      log_generic_event('O', child->pid, child->priority, child->cmd_str);
+      has_zombie |= child->process_state == 'Z';
+      last_child = child;
     }
-  }
 
-  // decr reference counts + close files if necessary
-  for (int i = 0; i < FILE_DESCRIPTOR_TABLE_SIZE; i++) {
-    if (proc->fd_table[i] != -1) {
-      if (decrement_fd_ref_count(proc->fd_table[i]) == 0) {
-        if (s_close(proc->fd_table[i]) == -1) {
-          u_perror("closing on a non-valid fd");
-        }
-      }
+    last_child->sibling_next = init_pcb->children;
+    if (init_pcb->children != NULL) {
+      init_pcb->children->sibling_prev = last_child;
+    }
+    init_pcb->children = proc->children;
+    proc->children = NULL;
+
+    // init may already be waiting for an orphan that is a zombie
+    if (has_zombie) {
+      wake_all(&init_pcb->child_wait_queue);
     }
   }
 
-  // cancel + join this thread
-  spthread_cancel(proc->thread_handle);
-  spthread_continue(proc->thread_handle);
-  spthread_suspend(proc->thread_handle);
-  spthread_join(proc->thread_handle, NULL);
+  // free the shared memory segments nobody else is attached to, and give
+  // its messages back to the pool
+  shm_detach_all(proc);
+  msg_release_all(proc);
+
+  // hand the thread back to the thread pool (or cancel + join it)
+  spthread_release(proc->thread_handle);
 
   // delete this process from any queue it's in + free it
   delete_process_from_all_queues(proc);
@@ -12,8 +12,27 @@
 #include <sys/types.h>
 #include "../lib/Vec.h"
 #include "../lib/spthread.h"
+#include "fd_table.h"
 
-#define FILE_DESCRIPTOR_TABLE_SIZE 100
+#define PCB_CACHE_LINE 64  // pcbs are aligned to cache lines
+
+struct pcb_st;
+struct pgrp_st;
+struct msg_st;
+struct p_mutex_st;
+struct p_sem_st;
+struct shm_attachment_st;
+
+/**
+ * @brief An intrusive doubly-linked queue of PCBs. The links live inside the
+ *        PCBs themselves, so pushing, popping, and removing an arbitrary PCB
+ *        are all O(1) and never allocate. A PCB is on at most one queue.
+ */
+typedef struct pcb_queue_st {
+  struct pcb_st* head;  // next pcb to be popped
+  struct pcb_st* tail;  // most recently pushed pcb
+  size_t length;
+} pcb_queue_t;
 
 ////////////////////////////////////////////////////////////////////////////////
 //              PROCESS CONTROL BLOCK (PCB) STRUCTURE AND FUNCTIONS           //
@@ -21,31 +40,68 @@
 
 /**
  * @brief The PCB structure, which contains all the information about a process.
- *        Notably, it contains the thread handle, pid, parent pid, child pcbs,
+ *        Notably, it contains the thread handle, pid, parent pid, children,
  *        priority level, process state, command string, signals to be sent,
  *        input and output file descriptors, process status, sleeping status,
  *        and time to wake.
+ *
+ *        The fields the scheduler touches on every dispatch come first, so
+ *        that they share the pcb's first cache lines. PCBs come from a slab
+ *        allocator (pcb_alloc) and start on a cache line.
  */
-typedef struct pcb_st {
+typedef struct __attribute__((aligned(PCB_CACHE_LINE))) pcb_st {
+  // hot: scheduling
   spthread_t thread_handle;
 
-  pid_t pid;      // 0 if init
-  pid_t par_pid;  // -1 if no parent
-
-  Vec child_pcbs;  // pcb ptrs to children, not ints
+  struct pcb_st* queue_prev;   // intrusive links for the scheduler queue
+  struct pcb_st* queue_next;   // the pcb is currently on
+  struct pcb_queue_st* queue;  // scheduler queue the pcb is on, NULL if none
 
+  pid_t pid;           // 0 if init
   int priority;        // priority level (0,1,2)
   char process_state;  // 'R' = running, 'S' = stopped,
                        // 'B' = blocked, 'Z' = zombied
+  bool is_sleeping;
 
-  char* cmd_str;  // str containing command
+  unsigned int pending_signals;  // bit P_SIGMASK(sig) is set while signal
+                                 // sig still has to be handled
+                                 // 0 = P_SIGSTOP, 1 = P_SIGCONT, 2 = P_SIGTERM
+  struct pcb_st* signal_prev;  // intrusive links for the scheduler's list
+  struct pcb_st* signal_next;  // of pcbs with pending signals
 
-  bool signals[3];  // signals to be sent to the process (true if
-                    // signal still has to be handled)
-                    // 0 = P_SIGSTOP, 1 = P_SIGCONT, 2 = P_SIGTERM
+  int cpu;     // home cpu, whose run queues the pcb is put on
+  int on_cpu;  // cpu the pcb is running on, -1 if it isn't running
+  volatile bool yield_pending;  // set when it yields early, cleared by the
+                                // cpu that suspends it
 
-  int input_fd;
-  int output_fd;
+  int tickets;               // proportional share, 0 = follow the priority
+  unsigned long long vtime;  // stride pass or cfs vruntime used so far
+  int heap_index;            // index in its cpu's vtime heap, -1 if not in it
+
+  int time_to_wake;      // time to wake up if sleeping, -1 if not sleeping
+  int sleep_heap_index;  // index in the scheduler's sleep heap, -1 if not in it
+
+  // warm: process tree and waiting
+  pid_t par_pid;          // -1 if no parent
+  struct pcb_st* parent;  // parent pcb, NULL for init
+
+  struct pcb_st* children;      // first child, zombies included, linked
+  struct pcb_st* sibling_prev;  // through sibling_prev/sibling_next
+  struct pcb_st* sibling_next;
+  pcb_queue_t zombies;  // children that exited and wait to be reaped,
+                        // oldest first
+
+  pcb_queue_t child_wait_queue;  // holds this process while it is blocked
+                                 // in s_waitpid on one of its children
+  pid_t waitpid_target;  // pid being waited on (-1 = any, -pgid = any in
+                         // group pgid), 0 if not waiting
+
+  int base_priority;  // priority set by s_nice; priority may be boosted
+                      // above it by the waiters on held_mutexes
+  struct p_mutex_st* held_mutexes;  // kernel mutexes owned, see sync.h
+  struct p_mutex_st* blocked_on;    // mutex waited for, NULL if none
+  struct p_sem_st* sem_granted;  // semaphore whose unit was handed to it
+                                 // while it waited, NULL if none
 
   int process_status;  // process status
                        // EXITED_NORMALLY 20
@@ -54,13 +110,45 @@ typedef struct pcb_st {
                        // CONT_BY_SIG 23
                        // 0 otherwise
 
-  bool is_sleeping;
-  int time_to_wake;  // time to wake up if sleeping, -1 if not sleeping
+  struct pcb_st* pid_next;  // next pcb in its pid table bucket
+
+  pid_t pgid;                // process group, inherited from the parent
+  struct pgrp_st* pgrp;      // the group with that pgid
+  struct pcb_st* pgrp_prev;  // intrusive links for the group's members
+  struct pcb_st* pgrp_next;
+
+  // cold
+  struct pcb_st* all_prev;  // intrusive links for current_pcbs, the list
+  struct pcb_st* all_next;  // of every process
+
+  char* cmd_str;  // str containing command
+
+  int input_fd;
+  int output_fd;
+
+  fd_table_t* fd_table;  // file descriptor table, shared copy-on-write
+                         // with the parent until either changes it
 
-  int fd_table[FILE_DESCRIPTOR_TABLE_SIZE];  // file descriptor table (-1 if not
-                                             // in use)
+  struct shm_attachment_st* shm_attachments;  // shared memory segments
+                                              // attached, see shm.h
+
+  struct msg_st* mailbox_head;     // messages sent to it, oldest first,
+  struct msg_st* mailbox_tail;     // see msg.h
+  pcb_queue_t mailbox_wait_queue;  // holds it while blocked in s_msg_recv
+  int msgs_owned;                  // messages received or allocated and
+                                   // not yet sent or freed
 } pcb_t;
 
+/**
+ * @brief Returns the number of PCBs in the queue.
+ */
+#define pcb_queue_len(queue) ((queue)->length)
+
+/**
+ * @brief Checks if the queue is empty.
+ */
+#define pcb_queue_is_empty(queue) ((queue)->length == 0)
+
 ////////////////////////////////////////////////////////////////////////////////
 //                               PCB FUNCTIONS                                //
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,7 +163,8 @@ typedef struct pcb_st {
  * @param input_fd      input fd
  * @param output_fd     output fd
  *
- * @return pointer to the newly created and malloced PCB or NULL if failure
+ * @return pointer to the newly created PCB, taken from the pcb slab
+ *         allocator, or NULL if failure
  */
 pcb_t* create_pcb(pid_t pid,
                   pid_t par_pid,
@@ -84,33 +173,91 @@ pcb_t* create_pcb(pid_t pid,
                   int output_fd);
 
 /**
- * @brief Frees all malloced memory associated with the PCB. Note that
- *        this will destroy children too, so be careful when using it.
- *        In particular, make sure to remove any children pcbs you want
- *        to preserve.
+ * @brief Frees all malloced memory associated with the PCB, releases its fd
+ *        table (closing files no other process holds), takes it out of its
+ *        process group, frees its pid and gives the PCB back to the slab
+ *        allocator. Its children are not touched, so make sure to move any
+ *        children pcbs you want to preserve first.
  *
  * @param pcb Pointer to the PCB to be freed, NULL if error
  */
 void free_pcb(void* pcb);
 
 /**
- * @brief Given a parent, removes the child from the parent's child
- *        vector if its exists. Notably, it does not free the child but
- *        simply removes it via the vec_erase_no_deletor function.
+ * @brief Checks if a child is one that s_waitpid(pid, ...) waits for.
+ *
+ * @param pid   the pid passed to s_waitpid: -1 for any child, -pgid for any
+ *              child in group pgid, or the child's pid
+ * @param child a pcb ptr to the child
+ * @return true if s_waitpid would pick up the child
+ */
+bool waitpid_matches(pid_t pid, const pcb_t* child);
+
+/**
+ * @brief Given a parent, unlinks the child from the parent's child list in
+ *        O(1). Notably, it does not free the child, nor take it off the
+ *        parent's zombie queue.
  *
  * @param parent a ptr to the parent pcb with the child list
  * @param child  a ptr to the child pcb that we'd like to remove
  */
 void remove_child_in_parent(pcb_t* parent, pcb_t* child);
 
+////////////////////////////////////////////////////////////////////////////////
+//                            PCB QUEUE FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes an empty PCB queue.
+ *
+ * @param queue ptr to the queue to initialize
+ */
+void pcb_queue_init(pcb_queue_t* queue);
+
+/**
+ * @brief Appends the PCB to the back of the queue. If the PCB is already on
+ *        a queue (including this one), it is unlinked from it first.
+ *
+ * @param queue ptr to the queue to push onto
+ * @param pcb   ptr to the pcb to push
+ */
+void pcb_queue_push_back(pcb_queue_t* queue, pcb_t* pcb);
+
+/**
+ * @brief Removes and returns the PCB at the front of the queue.
+ *
+ * @param queue ptr to the queue to pop from
+ * @return ptr to the popped pcb, or NULL if the queue is empty
+ */
+pcb_t* pcb_queue_pop_front(pcb_queue_t* queue);
+
+/**
+ * @brief Unlinks the PCB from whichever queue it is on. Does nothing if the
+ *        PCB is not on a queue. Notably, it does not free the PCB.
+ *
+ * @param pcb ptr to the pcb to unlink
+ */
+void pcb_queue_remove(pcb_t* pcb);
+
+/**
+ * @brief Moves every PCB of one queue to the back of another, keeping their
+ *        order, and leaves the first queue empty. The links are spliced in
+ *        O(1), but each PCB's queue ptr is updated, so this is O(len(src)).
+ *
+ * @param dst ptr to the queue to append to
+ * @param src ptr to the queue to empty
+ */
+void pcb_queue_splice(pcb_queue_t* dst, pcb_queue_t* src);
+
 ////////////////////////////////////////////////////////////////////////////////
 //        KERNEL-LEVEl PROCESS-RELATED REQUIRED KERNEL FUNCTIONS              //
 ////////////////////////////////////////////////////////////////////////////////
 
 /**
  * @brief Create a new child process, inheriting applicable properties from the
- * parent. Also inserts the created child into the correct scheduler queue based
- * on its priority.
+ * parent. The child is not put into a scheduler queue yet: the caller must do
+ * that with put_pcb_into_correct_queue once its thread and command are set, or
+ * the scheduler could run it half-initialized if the caller is preempted.
  * @param parent a pointer to the parent pcb
  * @param priority the priority of the child, usually 1 but exceptions like
  * shell exist
@@ -121,7 +268,9 @@ pcb_t* k_proc_create(pcb_t* parent, int priority);
 /**
  * @brief Clean up a terminated/finished thread's resources. This may include
  *        freeing the PCB, handling children, etc. If a child is orphaned, the
- *        INIT process becomes its parent.
+ *        INIT process becomes its parent. Its shared memory attachments are
+ *        dropped, freeing the segments no other process is attached to, and
+ *        the messages it holds or was sent go back to the message pool.
  *
  * @param proc a pcb ptr to the terminated/finished thread
  */
@@ -4,6 +4,7 @@
  */
 
 #include "kern_sys_calls.h"
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,22 +14,23 @@
 #include "../lib/pennos-errno.h"
 #include "../shell/builtins.h"
 #include "../shell/shell.h"
+#include "kern_lock.h"
 #include "kern_pcb.h"
 #include "logger.h"
+#include "pgrp.h"
+#include "pid_table.h"
+#include "sched_policy.h"
+#include "sched_stats.h"
 #include "scheduler.h"
 #include "signal.h"
+#include "sync.h"
 
-extern Vec zero_priority_queue;  // lower index = more recent
-extern Vec one_priority_queue;
-extern Vec two_priority_queue;
-extern Vec zombie_queue;
-extern Vec sleep_blocked_queue;
-extern Vec current_pcbs;
-extern pcb_t* current_running_pcb;  // currently running process
+extern pcb_t* current_pcbs;
+extern int num_current_pcbs;
 
 extern int tick_counter;
 
-pid_t current_fg_pid = 2;  // terminal controller
+pid_t current_fg_pgid = 2;  // terminal controller, the shell's group
 
 ////////////////////////////////////////////////////////////////////////////////
 //                         GENERAL HELPER FUNCTIONS                           //
@@ -49,66 +51,110 @@ int determine_index_in_queue(Vec* queue, int pid) {
 }
 
 /**
- * @brief Moves a PCB from its previous priority queue to its new priority
- * queue.
+ * @brief Requeues a PCB under its new priority.
  */
 void move_pcb_correct_queue(int prev_priority,
                             int new_priority,
                             pcb_t* curr_pcb) {
-  Vec* prev_queue;
-  Vec* new_queue;
+  // only runnable processes waiting in a run queue get moved
+  if (curr_pcb->priority == prev_priority && dequeue_runnable(curr_pcb)) {
+    curr_pcb->priority = new_priority;
+    put_pcb_into_correct_queue(curr_pcb);
+  }
+}
 
-  if (prev_priority == 0) {
-    prev_queue = &zero_priority_queue;
-  } else if (prev_priority == 1) {
-    prev_queue = &one_priority_queue;
-  } else {
-    prev_queue = &two_priority_queue;
+/**
+ * @brief Deletes a PCB from the run queue of the specified priority.
+ */
+void delete_from_queue(int queue_id, pcb_t* pcb) {
+  if (pcb->priority == queue_id) {
+    dequeue_runnable(pcb);
   }
+}
 
-  if (new_priority == 0) {
-    new_queue = &zero_priority_queue;
-  } else if (new_priority == 1) {
-    new_queue = &one_priority_queue;
-  } else {
-    new_queue = &two_priority_queue;
+/**
+ * @brief Deletes a PCB from the specified explicit queue based on its PID.
+ */
+void delete_from_explicit_queue(Vec* queue_to_delete_from, int pid) {
+  int index = determine_index_in_queue(queue_to_delete_from, pid);
+  if (index != -1) {
+    vec_erase_no_deletor(queue_to_delete_from, index);
   }
+}
 
-  // delete from prev_queue, if it's present at all
-  int ind = determine_index_in_queue(prev_queue, curr_pcb->pid);
-  if (ind != -1) {
-    vec_erase_no_deletor(prev_queue, ind);
+/**
+ * @brief Checks if the parent has a child that s_waitpid(pid, ...) could
+ *        return, so that it doesn't block forever.
+ */
+static bool has_waitable_child(pcb_t* parent, pid_t pid) {
+  if (pid == -1) {
+    return parent->children != NULL;
+  } else if (pid > 0) {
+    pcb_t* child = pid_table_get(pid);
+    return child != NULL && child->parent == parent;
   }
 
-  vec_push_back(new_queue, curr_pcb);
+  pgrp_t* group = pgrp_get(-pid);
+  if (group == NULL) {
+    return false;
+  }
+  for (pcb_t* member = group->head; member != NULL;
+       member = member->pgrp_next) {
+    if (member->parent == parent) {
+      return true;
+    }
+  }
+  return false;
 }
 
 /**
- * @brief Deletes a PCB from the specified queue based on its PID.
+ * @brief Finds a child of the parent that s_waitpid(pid, ...) can reap: the
+ *        oldest zombie for -1, in O(1), or the one with the pid, in O(1), or
+ *        the oldest one in the group, scanning only the parent's zombies.
  */
-void delete_from_queue(int queue_id, int pid) {
-  Vec* queue = NULL;
-  if (queue_id == 0) {
-    queue = &zero_priority_queue;
-  } else if (queue_id == 1) {
-    queue = &one_priority_queue;
-  } else {
-    queue = &two_priority_queue;
+static pcb_t* find_zombie_child(pcb_t* parent, pid_t pid) {
+  if (pid == -1) {
+    return parent->zombies.head;
+  } else if (pid > 0) {
+    pcb_t* child = pid_table_get(pid);
+    // a zombie is only reapable once its cpu put it on the zombie queue
+    if (child != NULL && child->queue == &parent->zombies) {
+      return child;
+    }
+    return NULL;
   }
 
-  int index = determine_index_in_queue(queue, pid);
-  if (index != -1) {
-    vec_erase_no_deletor(queue, index);
+  for (pcb_t* child = parent->zombies.head; child != NULL;
+       child = child->queue_next) {
+    if (waitpid_matches(pid, child)) {
+      return child;
+    }
   }
+  return NULL;
 }
 
 /**
- * @brief Deletes a PCB from the specified explicit queue based on its PID.
+ * @brief Flags a signal for a process and makes sure a cpu handles it. A
+ *        process stopping or terminating itself is left for the caller, which
+ *        has to yield once it is done signalling.
  */
-void delete_from_explicit_queue(Vec* queue_to_delete_from, int pid) {
-  int index = determine_index_in_queue(queue_to_delete_from, pid);
-  if (index != -1) {
-    vec_erase_no_deletor(queue_to_delete_from, index);
+static void deliver_signal(pcb_t* pcb, int signal) {
+  // a stop nobody has waited for is stale once the process is continued, so
+  // e.g. fg on a pipeline doesn't see another stage's old stop
+  if (signal == P_SIGCONT && pcb->process_status == 21) {  // STOPPED_BY_SIG
+    pcb->process_status = 0;
+  }
+
+  add_pending_signal(pcb, signal);  // signal flagged
+  log_generic_event('S', pcb->pid, pcb->priority, pcb->cmd_str);
+
+  if (pcb == current_running_pcb && signal != P_SIGCONT) {
+    return;
+  } else if (pcb->on_cpu != -1 && signal != P_SIGCONT) {
+    // running on another cpu, which handles the signal once it suspends it
+    kick_cpu(pcb->on_cpu);
+  } else {
+    kick_idle_cpu(pcb->cpu);  // make sure some cpu drains it
   }
 }
 
@@ -117,7 +163,8 @@ void delete_from_explicit_queue(Vec* queue_to_delete_from, int pid) {
  */
 void* init_func(void* input) {
   char* shell_argv[] = {"shell", NULL};
-  s_spawn(shell, shell_argv, STDIN_FILENO, STDOUT_FILENO);
+  spawn_attr_t shell_attr = {.pgid = SPAWN_NEW_PGRP};  // see current_fg_pgid
+  s_spawn_attr(shell, shell_argv, STDIN_FILENO, STDOUT_FILENO, &shell_attr);
 
   // continuously wait for and reap zombie children
   while (true) {
@@ -136,19 +183,23 @@ void* init_func(void* input) {
  * @brief Creates the init process and spawns the shell process.
  */
 pid_t s_spawn_init() {
+  spthread_t thread_handle;
+  if (spthread_create(&thread_handle, NULL, init_func, NULL) != 0) {
+    perror("Error in spthread_create in s_spawn_init call");
+  }
+
+  kernel_lock();
   pcb_t* init = k_proc_create(NULL, 0);
   if (init == NULL) {
+    kernel_unlock();
     P_ERRNO = P_ENULL;
     return -1;
   }
 
-  spthread_t thread_handle;
-  if (spthread_create(&thread_handle, NULL, init_func, NULL) != 0) {
-    perror("Error in spthread_create in s_spawn_init call");
-  }
-
   init->cmd_str = strdup("init");
   init->thread_handle = thread_handle;
+  put_pcb_into_correct_queue(init);
+  kernel_unlock();
   return init->pid;
 }
 
@@ -156,13 +207,52 @@ pid_t s_spawn_init() {
  * @brief Cleans up Init's resources.
  */
 void s_cleanup_init_process() {
-  k_proc_cleanup(get_pcb_in_queue(&current_pcbs, 1));
+  kernel_lock();
+  k_proc_cleanup(pid_table_get(1));
+  kernel_unlock();
 }
 
 /**
  * @brief Spawns a child process with the given function and arguments.
  */
 pid_t s_spawn(void* (*func)(void*), char* argv[], int fd0, int fd1) {
+  return s_spawn_attr(func, argv, fd0, fd1, NULL);
+}
+
+/**
+ * @brief Spawns a child process with the given attributes.
+ */
+pid_t s_spawn_attr(void* (*func)(void*),
+                   char* argv[],
+                   int fd0,
+                   int fd1,
+                   const spawn_attr_t* attr) {
+  // without a stack size, spthread uses its default (see --stack-kb)
+  pthread_attr_t thread_attr;
+  bool has_thread_attr = attr != NULL && attr->stack_size != 0;
+  if (has_thread_attr) {
+    pthread_attr_init(&thread_attr);
+    if (pthread_attr_setstacksize(&thread_attr, attr->stack_size) != 0) {
+      pthread_attr_destroy(&thread_attr);
+      P_ERRNO = P_EINVAL;
+      return -1;
+    }
+  }
+
+  // create the thread before taking the kernel lock: the thread inherits our
+  // signal mask, and the lock blocks SIGPTHD
+  spthread_t thread_handle;
+  int ret = spthread_create(&thread_handle,
+                            has_thread_attr ? &thread_attr : NULL, func, argv);
+  if (has_thread_attr) {
+    pthread_attr_destroy(&thread_attr);
+  }
+  if (ret != 0) {
+    P_ERRNO = ret == EINVAL ? P_EINVAL : P_EAGAIN;
+    return -1;
+  }
+
+  kernel_lock();
   pcb_t* child;
   if (strcmp(argv[0], "shell") == 0) {
     child = k_proc_create(current_running_pcb, 0);
@@ -171,26 +261,48 @@ pid_t s_spawn(void* (*func)(void*), char* argv[], int fd0, int fd1) {
   }
 
   if (child == NULL) {
-    P_ERRNO = P_ENULL;
-    return -1;
-  }
-
-  spthread_t thread_handle;
-
-  if (spthread_create(&thread_handle, NULL, func, argv) != 0) {
-    perror("Error in spthread_create in s_spawn call");
+    kernel_unlock();
+    spthread_release(thread_handle);
+    return -1;  // P_ERRNO set by k_proc_create
   }
 
   child->cmd_str = strdup(argv[0]);
   child->thread_handle = thread_handle;
   child->input_fd = fd0;
   child->output_fd = fd1;
-  child->fd_table[0] = fd0;
-  child->fd_table[1] = fd1;
+
+  // k_proc_create put the child in our group, move it if asked to
+  pid_t pgid = attr != NULL ? attr->pgid : 0;
+  if (pgid == SPAWN_NEW_PGRP) {
+    pgid = child->pid;
+  } else if (pgid != 0 && pgrp_get(pgid) == NULL) {
+    k_proc_cleanup(child);  // also releases the thread
+    kernel_unlock();
+    P_ERRNO = P_ESRCH;
+    return -1;
+  }
+  if (pgid != 0 && pgrp_join(child, pgid) == -1) {
+    k_proc_cleanup(child);
+    kernel_unlock();
+    return -1;  // P_ERRNO set by pgrp_join
+  }
+
+  // the child takes over the caller's reference to a redirected fd; with
+  // the parent's stdin and stdout its table stays shared
+  if (fd_table_set(&child->fd_table, 0, fd0) == -1 ||
+      fd_table_set(&child->fd_table, 1, fd1) == -1) {
+    k_proc_cleanup(child);  // also releases the thread
+    kernel_unlock();
+    return -1;  // P_ERRNO set by fd_table_set
+  }
 
   log_generic_event('C', child->pid, child->priority, child->cmd_str);
 
-  return child->pid;
+  // only now may the scheduler pick the child
+  put_pcb_into_correct_queue(child);
+  pid_t child_pid = child->pid;
+  kernel_unlock();
+  return child_pid;
 }
 
 /**
@@ -202,64 +314,43 @@ pid_t s_waitpid(pid_t pid, int* wstatus, bool nohang) {
     return -1;
   }
 
-  // if no children, return -1
-  bool has_child = false;
-  for (int i = 0; i < vec_len(&current_pcbs); i++) {
-    pcb_t* child = vec_get(&current_pcbs, i);
-    if (child->par_pid == parent->pid) {
-      has_child = true;
-      break;
-    }
-  }
-  if (!has_child) {
-    return -1;
+  kernel_lock();
+
+  // 0 stands for our own group
+  if (pid == 0) {
+    pid = -parent->pgid;
   }
 
-  // Scan the zombie queue first for terminated children.
-  for (int i = 0; i < vec_len(&zombie_queue); i++) {
-    pcb_t* child = vec_get(&zombie_queue, i);
-    if ((pid == -1 || child->pid == pid) && child->par_pid == parent->pid) {
+  while (true) {
+    // if no children (that we could wait for), return -1
+    if (!has_waitable_child(parent, pid)) {
+      kernel_unlock();
+      return -1;
+    }
+
+    // Check our zombie queue first for terminated children.
+    pcb_t* zombie = find_zombie_child(parent, pid);
+    if (zombie != NULL) {
       if (wstatus != NULL) {
-        *wstatus = child->process_status;
+        *wstatus = zombie->process_status;
       }
-      log_generic_event('W', child->pid, child->priority, child->cmd_str);
-      vec_erase_no_deletor(&zombie_queue, i);
-      delete_from_explicit_queue(&parent->child_pcbs, child->pid);
-      k_proc_cleanup(child);
-      return child->pid;
+      log_generic_event('W', zombie->pid, zombie->priority, zombie->cmd_str);
+      pid_t zombie_pid = zombie->pid;
+      k_proc_cleanup(zombie);  // unlinks it from our children and zombies
+      kernel_unlock();
+      return zombie_pid;
     }
-  }
-
-  // If nohang is true, return immediately if no child has exited
-  if (nohang) {
-    return 0;
-  }
-
-  // Block the parent until a child exits
-  delete_from_queue(parent->priority, parent->pid);
-  parent->process_state = 'B';
-  log_generic_event('B', parent->pid, parent->priority, parent->cmd_str);
 
-  while (true) {
-    // Scan the zombie queue first for terminated children.
-    for (int i = 0; i < vec_len(&zombie_queue); i++) {
-      pcb_t* child = vec_get(&zombie_queue, i);
-      if ((pid == -1 || child->pid == pid) && child->par_pid == parent->pid) {
-        if (wstatus != NULL) {
-          *wstatus = child->process_status;
-        }
-        log_generic_event('W', child->pid, child->priority, child->cmd_str);
-        vec_erase_no_deletor(&zombie_queue, i);
-        delete_from_explicit_queue(&parent->child_pcbs, child->pid);
-        k_proc_cleanup(child);
-        return child->pid;
-      }
+    // If nohang is true, return immediately if no child has exited
+    if (nohang) {
+      kernel_unlock();
+      return 0;
     }
 
     // scan children of current running process for non-terminated state changes
-    for (int i = 0; i < vec_len(&parent->child_pcbs); i++) {
-      pcb_t* child = vec_get(&parent->child_pcbs, i);
-      if ((pid == -1 || child->pid == pid) &&
+    for (pcb_t* child = parent->children; child != NULL;
+         child = child->sibling_next) {
+      if (waitpid_matches(pid, child) &&
           (child->process_status == 21 ||
            child->process_status == 23)) {  // signaled
         if (wstatus != NULL) {
@@ -267,12 +358,20 @@ pid_t s_waitpid(pid_t pid, int* wstatus, bool nohang) {
         }
         log_generic_event('W', child->pid, child->priority, child->cmd_str);
         child->process_status = 0;  // reset status
+        kernel_unlock();
         return child->pid;
       }
     }
+
+    // Block the parent until a matching child changes state. The child's
+    // exit/signal path wakes us through wake_waiting_parent.
+    parent->waitpid_target = pid;
+    block_on_wait_queue(&parent->child_wait_queue);
+    parent->waitpid_target = 0;
   }
 
   // If we get here, something went wrong
+  kernel_unlock();
   return -1;
 }
 
@@ -280,20 +379,99 @@ pid_t s_waitpid(pid_t pid, int* wstatus, bool nohang) {
  * @brief Sends a signal to a process with specified pid.
  */
 int s_kill(pid_t pid, int signal) {
-  pcb_t* pcb_with_pid = get_pcb_in_queue(&current_pcbs, pid);
+  if (signal < 0 || signal >= P_NSIG) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  pcb_t* pcb_with_pid = pid_table_get(pid);
   if (pcb_with_pid == NULL) {
+    kernel_unlock();
     return -1;  // pid not found case
   }
 
-  pcb_with_pid->signals[signal] = true;  // signal flagged
-  log_generic_event('S', pid, pcb_with_pid->priority, pcb_with_pid->cmd_str);
+  deliver_signal(pcb_with_pid, signal);
+  if (pcb_with_pid == current_running_pcb && signal != P_SIGCONT) {
+    // stopping or terminating ourselves takes effect right away
+    yield_to_scheduler();
+  }
+  kernel_unlock();
   return 0;
 }
 
+/**
+ * @brief Sends a signal to every process in a process group.
+ */
+int s_killpg(pid_t pgid, int signal) {
+  if (signal < 0 || signal >= P_NSIG) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  pgrp_t* group = pgrp_get(pgid);
+  if (group == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_ESRCH;
+    return -1;
+  }
+
+  bool signalled_self = false;
+  for (pcb_t* member = group->head; member != NULL;
+       member = member->pgrp_next) {
+    if (member->process_state == 'Z') {
+      continue;  // already done, waiting to be reaped
+    }
+    deliver_signal(member, signal);
+    signalled_self |= member == current_running_pcb;
+  }
+
+  if (signalled_self && signal != P_SIGCONT) {
+    yield_to_scheduler();  // only once every member was signalled
+  }
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Moves a process into a process group.
+ */
+int s_setpgid(pid_t pid, pid_t pgid) {
+  if (pid < 0 || pgid < 0) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  pcb_t* pcb = pid == 0 ? current_running_pcb : pid_table_get(pid);
+  if (pcb == NULL || pcb->process_state == 'Z' ||
+      (pcb != current_running_pcb && pcb->parent != current_running_pcb)) {
+    kernel_unlock();
+    P_ERRNO = P_ESRCH;  // only ourselves and our children
+    return -1;
+  }
+
+  if (pgid == 0) {
+    pgid = pcb->pid;
+  }
+  if (pgid != pcb->pid && pgrp_get(pgid) == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EPERM;  // only a process's own pid starts a new group
+    return -1;
+  }
+
+  int ret = pgrp_join(pcb, pgid);
+  kernel_unlock();
+  return ret;
+}
+
 /**
  * @brief Exits the current process and cleans up its resources.
  */
 void s_exit(void) {
+  kernel_lock();
+
   // Set process state to zombie
   current_running_pcb->process_state = 'Z';
   current_running_pcb->process_status = 20;  // EXITED_NORMALLY
@@ -303,11 +481,16 @@ void s_exit(void) {
                     current_running_pcb->priority,
                     current_running_pcb->cmd_str);
 
-  delete_from_queue(current_running_pcb->priority, current_running_pcb->pid);
+  delete_from_queue(current_running_pcb->priority, current_running_pcb);
 
   log_generic_event('Z', current_running_pcb->pid,
                     current_running_pcb->priority,
                     current_running_pcb->cmd_str);
+
+  // the parent is woken once our cpu has suspended us and queued us as a
+  // zombie, so it can't reap us while we are still running
+  yield_to_scheduler();  // a zombie is never scheduled again
+  kernel_unlock();
 }
 
 /**
@@ -318,17 +501,46 @@ int s_nice(pid_t pid, int priority) {
     return -1;
   }
 
-  pcb_t* curr_pcb = get_pcb_in_queue(&current_pcbs, pid);
+  kernel_lock();
+  pcb_t* curr_pcb = pid_table_get(pid);
   if (curr_pcb != NULL) {  // found + exists
-    move_pcb_correct_queue(curr_pcb->priority, priority, curr_pcb);
-    log_nice_event(pid, curr_pcb->priority, priority, curr_pcb->cmd_str);
-    curr_pcb->priority = priority;
+    int prev_priority = curr_pcb->priority;
+    sync_set_base_priority(curr_pcb, priority);  // keeps inherited priority
+    log_nice_event(pid, prev_priority, curr_pcb->priority, curr_pcb->cmd_str);
+    kernel_unlock();
     return 0;
   }
 
+  kernel_unlock();
   return -1;  // pid not found
 }
 
+/**
+ * @brief Sets the number of tickets of a process with specified pid.
+ */
+int s_set_tickets(pid_t pid, int tickets) {
+  if (tickets < 0 || tickets > MAX_TICKETS) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  pcb_t* curr_pcb = pid_table_get(pid);
+  if (curr_pcb == NULL) {
+    kernel_unlock();
+    return -1;  // pid not found
+  }
+
+  // the lottery keeps a running total, so requeue around the change
+  bool was_queued = dequeue_runnable(curr_pcb);
+  curr_pcb->tickets = tickets;
+  if (was_queued) {
+    put_pcb_into_correct_queue(curr_pcb);
+  }
+  kernel_unlock();
+  return 0;
+}
+
 /**
  * @brief Suspends the current process for a specified number of ticks.
  */
@@ -338,6 +550,8 @@ void s_sleep(unsigned int ticks) {
     return;
   }
 
+  kernel_lock();
+
   // block current process, set state to sleep
   current_running_pcb->process_state = 'B';
   current_running_pcb->is_sleeping = true;
@@ -345,10 +559,25 @@ void s_sleep(unsigned int ticks) {
   log_generic_event('B', current_running_pcb->pid,
                     current_running_pcb->priority,
                     current_running_pcb->cmd_str);
-  if (spthread_suspend(current_running_pcb->thread_handle) !=
-      0) {  // give scheduler control
-    perror("Error in spthread_suspend in s_sleep call");
-  }
+  yield_to_scheduler();  // give scheduler control
+  kernel_unlock();
+}
+
+/**
+ * @brief Gives up the rest of the current quantum.
+ */
+void s_yield(void) {
+  yield_to_scheduler();
+}
+
+/**
+ * @brief Gets the ticks since boot, read under the kernel lock.
+ */
+int s_get_ticks(void) {
+  kernel_lock();
+  int ticks = tick_counter;
+  kernel_unlock();
+  return ticks;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -387,19 +616,48 @@ void* s_echo(void* arg) {
  * @brief System-level wrapper for the shell built-in command "ps".
  */
 void* s_ps(void* arg) {
-  char pid_top[] = "PID\tPPID\tPRI\tSTAT\tCMD\n";
-  if (s_write(current_running_pcb->output_fd, pid_top, strlen(pid_top)) == -1) {
-    u_perror("s_write error");
+  const size_t row_size = 100;  // longer rows are cut short
+
+  // format every row under the lock, but write them only once it is dropped:
+  // a write can block on a full pipe, and other cpus may reap pcbs meanwhile
+  kernel_lock();
+  size_t size = (num_current_pcbs + 1) * row_size;
+  char* buffer = malloc(size);
+  if (buffer == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EMALLOC;
+    u_perror("s_ps error");
+    return NULL;
   }
-  for (int i = 0; i < vec_len(&current_pcbs); i++) {
-    pcb_t* curr_pcb = (pcb_t*)vec_get(&current_pcbs, i);
-    char buffer[100];
-    snprintf(buffer, sizeof(buffer), "%d\t%d\t%d\t%c\t%s\n", curr_pcb->pid,
-             curr_pcb->par_pid, curr_pcb->priority, curr_pcb->process_state,
-             curr_pcb->cmd_str);
-    if (s_write(current_running_pcb->output_fd, buffer, strlen(buffer)) == -1) {
-      u_perror("s_write error");
+  size_t len = snprintf(buffer, size, "PID\tPPID\tPRI\tSTAT\tCMD\n");
+  for (pcb_t* curr_pcb = current_pcbs; curr_pcb != NULL;
+       curr_pcb = curr_pcb->all_next) {
+    int row = snprintf(buffer + len, row_size, "%d\t%d\t%d\t%c\t%s\n",
+                       curr_pcb->pid, curr_pcb->par_pid, curr_pcb->priority,
+                       curr_pcb->process_state, curr_pcb->cmd_str);
+    if (row >= (int)row_size) {
+      row = row_size - 1;
+      buffer[len + row - 1] = '\n';
     }
+    len += row;
+  }
+  kernel_unlock();
+
+  if (s_write(current_running_pcb->output_fd, buffer, len) == -1) {
+    u_perror("s_write error");
+  }
+  free(buffer);
+  return NULL;
+}
+
+/**
+ * @brief Prints the scheduler's latency and utilization histograms.
+ */
+void* s_schedstat(void* arg) {
+  char buffer[SCHED_STATS_BUF_SIZE];
+  int len = sched_stats_format(buffer, sizeof(buffer));
+  if (s_write(current_running_pcb->output_fd, buffer, len) == -1) {
+    u_perror("s_write error");
   }
   return NULL;
 }
\ No newline at end of file
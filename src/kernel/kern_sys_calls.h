@@ -11,6 +11,17 @@
 #include <sys/types.h>
 #include "kern_pcb.h"
 
+/**
+ * @brief Optional attributes of a process spawned with s_spawn_attr.
+ */
+typedef struct spawn_attr_st {
+  size_t stack_size;  // bytes of stack, or 0 for the default (--stack-kb)
+  pid_t pgid;  // group to put the child in, 0 for the caller's or
+               // SPAWN_NEW_PGRP for a new one led by the child
+} spawn_attr_t;
+
+#define SPAWN_NEW_PGRP (-1)  // spawn_attr_t pgid starting a new group
+
 ////////////////////////////////////////////////////////////////////////////////
 //                         GENERAL HELPER FUNCTIONS                           //
 ////////////////////////////////////////////////////////////////////////////////
@@ -29,8 +40,11 @@ int determine_index_in_queue(Vec* queue, int pid);
 
 /**
  * @brief Given a thread's previous priority, this helper checks if the
- *        thread is present in that priority's queue, removes it from that
- *        queue if so, and then puts it into the new priority level's queue.
+ *        thread is waiting in its cpu's run queue and, if so, requeues it
+ *        under the new priority (which also sets curr_pcb->priority). A
+ *        thread that isn't runnable (or is currently running) is left alone;
+ *        it will be queued at the new priority the next time it becomes
+ *        runnable.
  *
  * @param prev_priority thread's previous priority
  * @param new_priority  thread's new priority
@@ -43,14 +57,14 @@ void move_pcb_correct_queue(int prev_priority,
                             pcb_t* curr_pcb);
 
 /**
- * @brief Deletes the PCB with the specified PID from one of the priority
- * queues, selected by the provided queue_id (0, 1, or 2).
+ * @brief Deletes the given PCB from its home cpu's run queue if it is queued
+ * there with the priority given by queue_id (0, 1, or 2).
  *
- * @param queue_id An integer representing the queue: 0 for zero_priority_queue,
- *                 1 for one_priority_queue, or 2 for two_priority_queue.
- * @param pid The PID of the PCB to be removed.
+ * @param queue_id An integer representing the priority of the queue: 0, 1,
+ *                 or 2.
+ * @param pcb The PCB to be removed.
  */
-void delete_from_queue(int queue_id, int pid);
+void delete_from_queue(int queue_id, pcb_t* pcb);
 
 /**
  * @brief Helper function that deletes the given PCB from the explicit queue
@@ -103,17 +117,41 @@ void s_cleanup_init_process();
  */
 pid_t s_spawn(void* (*func)(void*), char* argv[], int fd0, int fd1);
 
+/**
+ * @brief Like s_spawn, but with the given attributes. Every process runs on
+ *        a small stack with a guard page below it, so that tens of thousands
+ *        of them fit; a process that needs more asks for it here.
+ *
+ * @param func  Function to be executed by the child process.
+ * @param argv  Null-terminated array of args, including the command name as
+ * argv[0].
+ * @param fd0   Input file descriptor.
+ * @param fd1   Output file descriptor.
+ * @param attr  the attributes, or NULL for the defaults (same as s_spawn)
+ * @return pid_t The process ID of the created child process or -1 on error,
+ *         with P_ERRNO set to P_EINVAL for a stack below 16 KiB, P_EAGAIN
+ *         if no thread could be created for it or P_ESRCH if attr->pgid is
+ *         not an existing group
+ */
+pid_t s_spawn_attr(void* (*func)(void*),
+                   char* argv[],
+                   int fd0,
+                   int fd1,
+                   const spawn_attr_t* attr);
+
 /**
  * @brief Wait on a child of the calling process, until it changes state.
  *        If `nohang` is true, this will not block the calling process and
  *        return immediately.
  *
- * @param pid Process ID of the child to wait for.
+ * @param pid Process ID of the child to wait for, -1 for any child, 0 for any
+ *            child in the caller's process group, or -pgid for any child in
+ *            process group pgid.
  * @param wstatus Pointer to an integer variable where the status will be
  * stored.
  * @param nohang If true, return immediately if no child has exited.
  * @return pid_t The process ID of the child which has changed state on success,
- * -1 on error.
+ * -1 on error, including when no child matches pid.
  */
 pid_t s_waitpid(pid_t pid, int* wstatus, bool nohang);
 
@@ -127,13 +165,42 @@ pid_t s_waitpid(pid_t pid, int* wstatus, bool nohang);
  */
 int s_kill(pid_t pid, int signal);
 
+/**
+ * @brief Send a signal to every process in a process group, e.g. a whole
+ *        job on Ctrl-C, in one pass over the group's members. Zombies are
+ *        skipped. If the caller is in the group and the signal stops or
+ *        terminates it, that takes effect after the others were signalled.
+ *
+ * @param pgid   the process group
+ * @param signal 0 = P_SIGSTOP, 1 = P_SIGCONT, 2 = P_SIGTERM
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL for a bad signal or
+ *         P_ESRCH if the group has no members
+ */
+int s_killpg(pid_t pgid, int signal);
+
+/**
+ * @brief Move a process into a process group. A process can only move itself
+ *        or one of its children, either into an existing group or into a new
+ *        group named after its own pid.
+ *
+ * @param pid  the process to move, 0 for the caller
+ * @param pgid the group to move it to, 0 for a group named after pid
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL for a negative
+ *         argument, P_ESRCH if pid isn't the caller or one of its children,
+ *         P_EPERM if pgid is not an existing group or pid, or P_ENULL if a new
+ *         group couldn't be allocated
+ */
+int s_setpgid(pid_t pid, pid_t pgid);
+
 /**
  * @brief Unconditionally exit the calling process.
  */
 void s_exit(void);
 
 /**
- * @brief Set the priority of the specified thread.
+ * @brief Set the priority of the specified thread. While the thread owns a
+ * kernel mutex another thread with a better priority waits for, it keeps
+ * running at that better priority until it unlocks the mutex (see sync.h).
  *
  * @param pid Process ID of the target thread.
  * @param priority The new priorty value of the thread (0, 1, or 2)
@@ -141,6 +208,18 @@ void s_exit(void);
  */
 int s_nice(pid_t pid, int priority);
 
+/**
+ * @brief Set the number of tickets of the specified thread, which sets its
+ * share of the cpu under the stride and lottery scheduling policies. The
+ * priority policy ignores tickets.
+ *
+ * @param pid Process ID of the target thread.
+ * @param tickets The new number of tickets, from 1 to MAX_TICKETS, or 0 to
+ * derive them from the thread's priority again (the default).
+ * @return 0 on success, -1 on failure.
+ */
+int s_set_tickets(pid_t pid, int tickets);
+
 /**
  * @brief Suspends execution of the calling proces for a specified number of
  * clock ticks.
@@ -155,6 +234,22 @@ int s_nice(pid_t pid, int priority);
  */
 void s_sleep(unsigned int ticks);
 
+/**
+ * @brief Gives up the rest of the calling process's quantum. The process stays
+ * runnable and is requeued on its cpu, so other runnable processes get to run
+ * before it is scheduled again (under the priority policy, it goes to the
+ * back of its priority queue).
+ */
+void s_yield(void);
+
+/**
+ * @brief Gets the number of clock ticks since PennOS booted, as last brought up
+ * to date by the scheduler.
+ *
+ * @return The tick count.
+ */
+int s_get_ticks(void);
+
 ////////////////////////////////////////////////////////////////////////////////
 //              SYSTEM-LEVEl BUILTIN-RELATED KERNEL FUNCTIONS                 //
 ////////////////////////////////////////////////////////////////////////////////
@@ -175,4 +270,12 @@ void* s_echo(void* arg);
  */
 void* s_ps(void* arg);
 
+/**
+ * @brief System-level wrapper for the shell built-in command "schedstat"
+ *
+ * @param arg the pass along arguments to the u_schedstat function
+ * @return NULL, dummy return value
+ */
+void* s_schedstat(void* arg);
+
 #endif
\ No newline at end of file
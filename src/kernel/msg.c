@@ -0,0 +1,184 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements per-process mailboxes over a fixed-size message pool.
+ */
+
+#include "msg.h"
+#include <stddef.h>
+#include "../lib/pennos-errno.h"
+#include "kern_lock.h"
+#include "pid_table.h"
+#include "scheduler.h"
+
+static msg_t pool[MSG_POOL_SIZE];
+static msg_t* free_list = NULL;  // messages nobody owns
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Puts a message nobody owns back on the free list.
+ */
+static void pool_put(msg_t* msg) {
+  msg->next = free_list;
+  free_list = msg;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                           MESSAGE SYSTEM CALLS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Takes a message from the pool for the caller.
+ */
+msg_t* s_msg_alloc() {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return NULL;
+  }
+  msg_t* msg = free_list;
+  if (msg == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EAGAIN;
+    return NULL;
+  }
+
+  free_list = msg->next;
+  msg->next = NULL;
+  msg->owner = self;
+  self->msgs_owned++;
+  msg->sender = self->pid;
+  msg->len = 0;
+  kernel_unlock();
+  return msg;
+}
+
+/**
+ * @brief Gives a message the caller owns back to the pool.
+ */
+int s_msg_free(msg_t* msg) {
+  kernel_lock();
+  if (msg == NULL || msg->owner == NULL ||
+      msg->owner != current_running_pcb) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  msg->owner->msgs_owned--;
+  msg->owner = NULL;
+  pool_put(msg);
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Hands a message the caller owns to another process's mailbox.
+ */
+int s_msg_send(pid_t pid, msg_t* msg) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (msg == NULL || self == NULL || msg->owner != self || msg->len < 0 ||
+      msg->len > MSG_DATA_SIZE) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  pcb_t* receiver = pid_table_get(pid);
+  if (receiver == NULL || receiver->process_state == 'Z') {
+    kernel_unlock();
+    P_ERRNO = P_ESRCH;
+    return -1;
+  }
+
+  // nobody owns it while it waits in the mailbox
+  self->msgs_owned--;
+  msg->owner = NULL;
+  msg->sender = self->pid;
+  msg->next = NULL;
+  if (receiver->mailbox_tail != NULL) {
+    receiver->mailbox_tail->next = msg;
+  } else {
+    receiver->mailbox_head = msg;
+  }
+  receiver->mailbox_tail = msg;
+
+  wake_all(&receiver->mailbox_wait_queue);
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Takes the oldest message from the caller's mailbox, blocking while
+ *        it is empty.
+ */
+msg_t* s_msg_recv(bool nohang) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return NULL;
+  }
+
+  while (self->mailbox_head == NULL) {
+    if (nohang) {
+      kernel_unlock();
+      P_ERRNO = P_EAGAIN;
+      return NULL;
+    }
+    block_on_wait_queue(&self->mailbox_wait_queue);
+  }
+
+  msg_t* msg = self->mailbox_head;
+  self->mailbox_head = msg->next;
+  if (self->mailbox_head == NULL) {
+    self->mailbox_tail = NULL;
+  }
+  msg->next = NULL;
+  msg->owner = self;
+  self->msgs_owned++;
+  kernel_unlock();
+  return msg;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                          KERNEL MESSAGE FUNCTIONS                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Puts every message on the free list.
+ */
+void msg_pool_init() {
+  free_list = NULL;
+  for (int i = MSG_POOL_SIZE - 1; i >= 0; i--) {
+    pool[i].owner = NULL;
+    pool[i].next = free_list;
+    free_list = &pool[i];
+  }
+}
+
+/**
+ * @brief Gives back every message a reaped process owns.
+ */
+void msg_release_all(pcb_t* pcb) {
+  while (pcb->mailbox_head != NULL) {
+    msg_t* msg = pcb->mailbox_head;
+    pcb->mailbox_head = msg->next;
+    pool_put(msg);
+  }
+  pcb->mailbox_tail = NULL;
+
+  // most processes never hold a message, so skip the scan for them
+  for (int i = 0; i < MSG_POOL_SIZE && pcb->msgs_owned > 0; i++) {
+    if (pool[i].owner == pcb) {
+      pool[i].owner = NULL;
+      pcb->msgs_owned--;
+      pool_put(&pool[i]);
+    }
+  }
+}
@@ -0,0 +1,101 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines per-process mailboxes. Messages come from a fixed-size
+ *          kernel pool and are passed by pointer: sending one hands it,
+ *          uncopied, to the receiver, which frees it back to the pool once
+ *          it is done with it. A receiver with an empty mailbox blocks on
+ *          its own wait queue.
+ */
+
+#ifndef MSG_H_
+#define MSG_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "kern_pcb.h"
+
+#define MSG_POOL_SIZE 1024  // messages in the kernel's pool
+#define MSG_DATA_SIZE 232   // payload bytes per message, 256 per message
+
+/**
+ * @brief A message. The owner may read and write sender, len and data; the
+ *        rest belongs to the kernel.
+ */
+typedef struct msg_st {
+  struct pcb_st* owner;  // process holding it, NULL while in the pool or
+                         // waiting in a mailbox
+  struct msg_st* next;   // next message in a mailbox or the free list
+  pid_t sender;          // set by s_msg_send
+  int len;               // payload bytes used, set by the sender
+  char data[MSG_DATA_SIZE];
+} msg_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                           MESSAGE SYSTEM CALLS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Takes a message from the pool. The calling process owns it until
+ *        it sends or frees it.
+ *
+ * @return a ptr to the message, with len set to 0, or NULL with P_ERRNO set
+ *         to P_EAGAIN if the pool is empty, or P_EINVAL if the caller isn't a
+ *         process
+ */
+msg_t* s_msg_alloc();
+
+/**
+ * @brief Gives a message the calling process owns back to the pool.
+ *
+ * @param msg the message
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if the caller
+ *         doesn't own msg
+ */
+int s_msg_free(msg_t* msg);
+
+/**
+ * @brief Sends a message the calling process owns to another process's
+ *        mailbox, without copying it. The caller must not touch it any
+ *        more; the receiver owns it once s_msg_recv returns it. Wakes the
+ *        receiver if it is blocked in s_msg_recv.
+ *
+ * @param pid the receiver's pid
+ * @param msg the message, with len and data filled in
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if the caller doesn't
+ *         own msg or len is out of range, or P_ESRCH if no live process has
+ *         the pid
+ */
+int s_msg_send(pid_t pid, msg_t* msg);
+
+/**
+ * @brief Takes the oldest message from the calling process's mailbox,
+ *        blocking (off every run queue) until one arrives if it is empty.
+ *        The caller owns the message and frees it with s_msg_free.
+ *
+ * @param nohang if true, don't block on an empty mailbox
+ * @return a ptr to the message, or NULL with P_ERRNO set to P_EAGAIN if
+ *         nohang is set and the mailbox is empty, or P_EINVAL if the caller
+ *         isn't a process
+ */
+msg_t* s_msg_recv(bool nohang);
+
+////////////////////////////////////////////////////////////////////////////////
+//                          KERNEL MESSAGE FUNCTIONS                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Puts every message on the pool's free list. Called once at boot,
+ *        before any process runs.
+ */
+void msg_pool_init();
+
+/**
+ * @brief Gives back to the pool every message a process owns, including
+ *        those still in its mailbox. Called by k_proc_cleanup when the
+ *        process is reaped. Called with the kernel lock held.
+ *
+ * @param pcb the process
+ */
+void msg_release_all(pcb_t* pcb);
+
+#endif  // MSG_H_
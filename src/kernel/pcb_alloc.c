@@ -0,0 +1,166 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the pcb slab allocator and the pid bitmap allocator.
+ */
+
+#include "pcb_alloc.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include "../lib/pennos-errno.h"
+
+#define PID_WORDS (PID_MAX / 64)
+
+// bit p is set while pid p is in use or held back. Pid 0 is never handed out
+static uint64_t pid_bitmap[PID_WORDS] = {1};
+static pid_t last_pid = 0;
+
+// the most recently freed pids, oldest first, which stay set in the bitmap
+static pid_t held_pids[MAX_PID_REUSE_DELAY];
+static int held_head = 0;  // index of the oldest held pid
+static int held_len = 0;
+static int pid_reuse_delay = DEFAULT_PID_REUSE_DELAY;
+
+// a block of pcbs allocated at once. Slabs are kept until PennOS shuts down,
+// so memory stays at what the most processes alive at once needed
+typedef struct pcb_slab_st {
+  pcb_t pcbs[PCB_SLAB_SIZE];
+  struct pcb_slab_st* next;
+} pcb_slab_t;
+
+static pcb_slab_t* slabs = NULL;
+static pcb_t* free_pcbs = NULL;  // linked through queue_next
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Returns the lowest pid in [from, to) whose bit is clear, or -1.
+ */
+static pid_t find_free_pid(pid_t from, pid_t to) {
+  for (pid_t pid = from; pid < to;) {
+    // bits below from in the first word count as taken
+    uint64_t taken = pid_bitmap[pid / 64] | ((1ULL << (pid % 64)) - 1);
+    if (~taken != 0) {
+      pid_t found = pid / 64 * 64 + __builtin_ctzll(~taken);
+      return found < to ? found : -1;
+    }
+    pid = (pid / 64 + 1) * 64;
+  }
+  return -1;
+}
+
+/**
+ * @brief Releases the oldest held back pid to pid_alloc.
+ */
+static void release_oldest_held_pid() {
+  pid_t pid = held_pids[held_head];
+  pid_bitmap[pid / 64] &= ~(1ULL << (pid % 64));
+  held_head = (held_head + 1) % MAX_PID_REUSE_DELAY;
+  held_len--;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               PID FUNCTIONS                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Sets how many freed pids are held back before reuse.
+ */
+int set_pid_reuse_delay(int delay) {
+  if (delay < 0 || delay > MAX_PID_REUSE_DELAY) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  pid_reuse_delay = delay;
+  while (held_len > pid_reuse_delay) {
+    release_oldest_held_pid();
+  }
+  return 0;
+}
+
+/**
+ * @brief Hands out the next free pid after the last one.
+ */
+pid_t pid_alloc() {
+  pid_t pid = find_free_pid(last_pid + 1, PID_MAX);
+  if (pid == -1) {
+    pid = find_free_pid(1, last_pid + 1);  // wrap around
+  }
+  if (pid == -1) {
+    P_ERRNO = P_EAGAIN;
+    return -1;
+  }
+
+  pid_bitmap[pid / 64] |= 1ULL << (pid % 64);
+  last_pid = pid;
+  return pid;
+}
+
+/**
+ * @brief Frees a pid of a reaped process.
+ */
+void pid_free(pid_t pid) {
+  if (pid <= 0 || pid >= PID_MAX) {
+    return;
+  }
+  if (pid_reuse_delay == 0) {
+    pid_bitmap[pid / 64] &= ~(1ULL << (pid % 64));
+    return;
+  }
+
+  if (held_len == pid_reuse_delay) {
+    release_oldest_held_pid();
+  }
+  held_pids[(held_head + held_len) % MAX_PID_REUSE_DELAY] = pid;
+  held_len++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                              PCB FUNCTIONS                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Takes a pcb off the free list.
+ */
+pcb_t* pcb_alloc() {
+  if (free_pcbs == NULL) {
+    pcb_slab_t* slab = aligned_alloc(_Alignof(pcb_slab_t), sizeof(pcb_slab_t));
+    if (slab == NULL) {
+      return NULL;
+    }
+    slab->next = slabs;
+    slabs = slab;
+
+    // pushed in reverse, so that pcbs are handed out in address order
+    for (int i = PCB_SLAB_SIZE - 1; i >= 0; i--) {
+      slab->pcbs[i].queue_next = free_pcbs;
+      free_pcbs = &slab->pcbs[i];
+    }
+  }
+
+  pcb_t* pcb = free_pcbs;
+  free_pcbs = pcb->queue_next;
+  pcb->queue_next = NULL;
+  return pcb;
+}
+
+/**
+ * @brief Puts a pcb back on the free list.
+ */
+void pcb_free(pcb_t* pcb) {
+  pcb->queue_next = free_pcbs;
+  free_pcbs = pcb;
+}
+
+/**
+ * @brief Frees every slab.
+ */
+void pcb_alloc_destroy() {
+  while (slabs != NULL) {
+    pcb_slab_t* next = slabs->next;
+    free(slabs);
+    slabs = next;
+  }
+  free_pcbs = NULL;
+}
@@ -0,0 +1,78 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the pcb slab allocator and the pid allocator, which
+ *          recycles the pids of reaped processes after a reuse delay.
+ */
+
+#ifndef PCB_ALLOC_H_
+#define PCB_ALLOC_H_
+
+#include <sys/types.h>
+#include "kern_pcb.h"
+
+#define PID_MAX 32768                      // pids wrap after PID_MAX - 1
+#define DEFAULT_PID_REUSE_DELAY 100        // freed pids held back before reuse
+#define MAX_PID_REUSE_DELAY (PID_MAX / 2)  // largest reuse delay
+#define PCB_SLAB_SIZE 64                   // pcbs allocated at once
+
+////////////////////////////////////////////////////////////////////////////////
+//                               PID FUNCTIONS                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Sets how many freed pids are held back before any of them is handed
+ *        out again, e.g. from the --pid-reuse-delay boot option. Pids are
+ *        handed out in increasing order and wrap at PID_MAX, like on Linux,
+ *        so a pid is normally only reused after the whole range went by; the
+ *        delay keeps a just-freed pid from coming back right away when most
+ *        pids are taken.
+ *
+ * @param delay number of pids, 0 to MAX_PID_REUSE_DELAY
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if out of range
+ */
+int set_pid_reuse_delay(int delay);
+
+/**
+ * @brief Hands out the next free pid after the last one, looking it up in a
+ *        bitmap of the pids in use. The first ones are 1 (init) and 2 (shell).
+ *        Called with the kernel lock held.
+ *
+ * @return the pid, or -1 with P_ERRNO set to P_EAGAIN if every pid is taken
+ */
+pid_t pid_alloc();
+
+/**
+ * @brief Frees a pid of a reaped process. It becomes free for pid_alloc
+ *        once the reuse delay's worth of later pids were freed.
+ *
+ * @param pid the pid to free
+ */
+void pid_free(pid_t pid);
+
+////////////////////////////////////////////////////////////////////////////////
+//                              PCB FUNCTIONS                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Takes a pcb off the free list, carving a new slab of PCB_SLAB_SIZE
+ *        cache line aligned pcbs when it is empty. The caller initializes
+ *        every field. Called with the kernel lock held.
+ *
+ * @return a ptr to the pcb, or NULL if a slab couldn't be allocated
+ */
+pcb_t* pcb_alloc();
+
+/**
+ * @brief Puts a pcb back on the free list. The caller already freed what the
+ *        pcb points to.
+ *
+ * @param pcb a ptr to the pcb to free
+ */
+void pcb_free(pcb_t* pcb);
+
+/**
+ * @brief Frees every slab. All pcbs must have been freed already.
+ */
+void pcb_alloc_destroy();
+
+#endif  // PCB_ALLOC_H_
@@ -0,0 +1,121 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements process groups, kept in a small chained hash table
+ *          keyed by pgid.
+ */
+
+#include "pgrp.h"
+#include <stdlib.h>
+#include "../lib/pennos-errno.h"
+#include "pcb_alloc.h"
+#include "pid_table.h"
+
+static pgrp_t* pgrp_table[PGRP_TABLE_BUCKETS];
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Returns the link pointing at the group with the pgid, or at the
+ *        NULL ending its bucket if there is none.
+ */
+static pgrp_t** pgrp_link(pid_t pgid) {
+  pgrp_t** link = &pgrp_table[(size_t)pgid % PGRP_TABLE_BUCKETS];
+  while (*link != NULL && (*link)->pgid != pgid) {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                          PROCESS GROUP FUNCTIONS                           //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Finds a process group by its pgid.
+ */
+pgrp_t* pgrp_get(pid_t pgid) {
+  return *pgrp_link(pgid);
+}
+
+/**
+ * @brief Moves a pcb into the group with the given pgid.
+ */
+int pgrp_join(pcb_t* pcb, pid_t pgid) {
+  if (pcb->pgrp != NULL && pcb->pgrp->pgid == pgid) {
+    return 0;
+  }
+
+  pgrp_t** link = pgrp_link(pgid);
+  if (*link == NULL) {
+    pgrp_t* group = malloc(sizeof(pgrp_t));
+    if (group == NULL) {
+      P_ERRNO = P_ENULL;
+      return -1;
+    }
+    group->pgid = pgid;
+    group->head = NULL;
+    group->size = 0;
+    group->next = NULL;
+    *link = group;
+  }
+  pgrp_t* group = *link;
+
+  pgrp_leave(pcb);
+  pcb->pgrp_prev = NULL;
+  pcb->pgrp_next = group->head;
+  if (group->head != NULL) {
+    group->head->pgrp_prev = pcb;
+  }
+  group->head = pcb;
+  group->size++;
+  pcb->pgrp = group;
+  pcb->pgid = pgid;
+  return 0;
+}
+
+/**
+ * @brief Removes a pcb from its group.
+ */
+void pgrp_leave(pcb_t* pcb) {
+  pgrp_t* group = pcb->pgrp;
+  if (group == NULL) {
+    return;
+  }
+
+  if (pcb->pgrp_prev != NULL) {
+    pcb->pgrp_prev->pgrp_next = pcb->pgrp_next;
+  } else {
+    group->head = pcb->pgrp_next;
+  }
+  if (pcb->pgrp_next != NULL) {
+    pcb->pgrp_next->pgrp_prev = pcb->pgrp_prev;
+  }
+  pcb->pgrp_prev = NULL;
+  pcb->pgrp_next = NULL;
+  pcb->pgrp = NULL;
+  group->size--;
+  if (group->size > 0) {
+    return;
+  }
+
+  pgrp_t** link = pgrp_link(group->pgid);
+  *link = group->next;
+
+  // the leader's pid was held back for the group if the leader is already
+  // gone. A leader that is still around frees its pid itself
+  if (group->pgid != pcb->pid && pid_table_get(group->pgid) == NULL) {
+    pid_free(group->pgid);
+  }
+  free(group);
+}
+
+/**
+ * @brief Frees the pid of a reaped process, unless a group still goes by it.
+ */
+void pgrp_pid_free(pid_t pid) {
+  if (pgrp_get(pid) == NULL) {
+    pid_free(pid);
+  }
+}
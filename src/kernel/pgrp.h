@@ -0,0 +1,71 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines process groups, which let a whole job be signalled or
+ *          waited on at once.
+ */
+
+#ifndef PGRP_H_
+#define PGRP_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "kern_pcb.h"
+
+#define PGRP_TABLE_BUCKETS 64  // there are about as many groups as jobs
+
+/**
+ * @brief A process group. Its members are linked through their pcbs, so
+ *        joining and leaving are O(1) and signalling the group only visits
+ *        its members. A group lives as long as it has members, and its pgid
+ *        (the pid of the process that created it) isn't handed out to a new
+ *        process until then.
+ */
+typedef struct pgrp_st {
+  pid_t pgid;
+  pcb_t* head;  // first member, linked through pgrp_next
+  size_t size;  // number of members
+  struct pgrp_st* next;  // next group in its pgrp table bucket
+} pgrp_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                          PROCESS GROUP FUNCTIONS                           //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Finds a process group by its pgid.
+ *
+ * @param pgid the pgid to look up
+ * @return a ptr to the group, or NULL if it has no members
+ */
+pgrp_t* pgrp_get(pid_t pgid);
+
+/**
+ * @brief Moves a pcb into the group with the given pgid, creating the group
+ *        if it doesn't exist, and sets pcb->pgid. Leaves the pcb's current
+ *        group first. Called with the kernel lock held.
+ *
+ * @param pcb  a ptr to the pcb
+ * @param pgid the group to join
+ * @return 0 on success, -1 with P_ERRNO set to P_ENULL if a new group
+ *         couldn't be allocated (the pcb stays in its current group)
+ */
+int pgrp_join(pcb_t* pcb, pid_t pgid);
+
+/**
+ * @brief Removes a pcb from its group, freeing the group when it was the
+ *        last member. Called by free_pcb and pgrp_join.
+ *
+ * @param pcb a ptr to the pcb, which may be in no group
+ */
+void pgrp_leave(pcb_t* pcb);
+
+/**
+ * @brief Frees the pid of a reaped process, unless a group still goes by it;
+ *        the pid is then freed once that group's last member leaves. Called
+ *        by free_pcb after pgrp_leave.
+ *
+ * @param pid the reaped process's pid
+ */
+void pgrp_pid_free(pid_t pid);
+
+#endif  // PGRP_H_
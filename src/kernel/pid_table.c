@@ -0,0 +1,127 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the pid table, a chained hash table whose chains are
+ *          linked through the pcbs themselves.
+ */
+
+#include "pid_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the table starts out in the static buckets, so it never has to allocate
+// until it holds more than PID_TABLE_MIN_BUCKETS pcbs
+static pcb_t* initial_buckets[PID_TABLE_MIN_BUCKETS];
+static pcb_t** buckets = initial_buckets;
+static size_t num_buckets = PID_TABLE_MIN_BUCKETS;  // always a power of two
+static size_t num_pcbs = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Returns the bucket the pid goes in. Pids are handed out in order, so
+ *        their low bits already spread them evenly.
+ */
+static size_t pid_bucket(pid_t pid, size_t count) {
+  return (size_t)pid & (count - 1);
+}
+
+/**
+ * @brief Moves every pcb into a table with the given number of buckets. Keeps
+ *        the current table if the new one can't be allocated.
+ */
+static void pid_table_resize(size_t count) {
+  pcb_t** resized = count == PID_TABLE_MIN_BUCKETS
+                        ? initial_buckets
+                        : malloc(count * sizeof(pcb_t*));
+  if (resized == NULL) {
+    return;
+  }
+  if (resized == initial_buckets) {
+    memset(initial_buckets, 0, sizeof(initial_buckets));
+  } else {
+    memset(resized, 0, count * sizeof(pcb_t*));
+  }
+
+  for (size_t i = 0; i < num_buckets; i++) {
+    pcb_t* pcb = buckets[i];
+    while (pcb != NULL) {
+      pcb_t* next = pcb->pid_next;
+      size_t bucket = pid_bucket(pcb->pid, count);
+      pcb->pid_next = resized[bucket];
+      resized[bucket] = pcb;
+      pcb = next;
+    }
+  }
+
+  if (buckets != initial_buckets) {
+    free(buckets);
+  }
+  buckets = resized;
+  num_buckets = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                            PID TABLE FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Adds the pcb to the pid table.
+ */
+void pid_table_insert(pcb_t* pcb) {
+  if (num_pcbs >= num_buckets) {
+    pid_table_resize(num_buckets * 2);
+  }
+
+  size_t bucket = pid_bucket(pcb->pid, num_buckets);
+  pcb->pid_next = buckets[bucket];
+  buckets[bucket] = pcb;
+  num_pcbs++;
+}
+
+/**
+ * @brief Removes the pcb from the pid table.
+ */
+void pid_table_remove(pcb_t* pcb) {
+  pcb_t** link = &buckets[pid_bucket(pcb->pid, num_buckets)];
+  while (*link != NULL && *link != pcb) {
+    link = &(*link)->pid_next;
+  }
+  if (*link == NULL) {
+    return;
+  }
+  *link = pcb->pid_next;
+  pcb->pid_next = NULL;
+  num_pcbs--;
+
+  // shrink again after a burst of processes, with some slack so that a
+  // table right at the limit doesn't resize back and forth
+  if (num_buckets > PID_TABLE_MIN_BUCKETS && num_pcbs < num_buckets / 4) {
+    pid_table_resize(num_buckets / 2);
+  }
+}
+
+/**
+ * @brief Finds the pcb of a current process by its pid.
+ */
+pcb_t* pid_table_get(pid_t pid) {
+  pcb_t* pcb = buckets[pid_bucket(pid, num_buckets)];
+  while (pcb != NULL && pcb->pid != pid) {
+    pcb = pcb->pid_next;
+  }
+  return pcb;
+}
+
+/**
+ * @brief Empties the pid table and frees its buckets.
+ */
+void pid_table_clear() {
+  if (buckets != initial_buckets) {
+    free(buckets);
+  }
+  memset(initial_buckets, 0, sizeof(initial_buckets));
+  buckets = initial_buckets;
+  num_buckets = PID_TABLE_MIN_BUCKETS;
+  num_pcbs = 0;
+}
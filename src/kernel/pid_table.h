@@ -0,0 +1,53 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the pid table, a hash index from pids to the pcbs of
+ *          current processes.
+ */
+
+#ifndef PID_TABLE_H_
+#define PID_TABLE_H_
+
+#include <sys/types.h>
+#include "kern_pcb.h"
+
+#define PID_TABLE_MIN_BUCKETS 64  // buckets of the table while it is small
+
+////////////////////////////////////////////////////////////////////////////////
+//                            PID TABLE FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Adds the pcb to the pid table. Called by k_proc_create next to
+ *        adding it to current_pcbs. The pcb's pid must not be in the table.
+ *        Grows the table once there are more pcbs than buckets; if that
+ *        fails the buckets just get longer, so adding never fails.
+ *
+ * @param pcb a ptr to the pcb to add
+ */
+void pid_table_insert(pcb_t* pcb);
+
+/**
+ * @brief Removes the pcb from the pid table. Does nothing if it is not in
+ *        the table. Called next to removing it from current_pcbs.
+ *
+ * @param pcb a ptr to the pcb to remove
+ */
+void pid_table_remove(pcb_t* pcb);
+
+/**
+ * @brief Finds the pcb of a current process (including zombies) by its pid,
+ *        in O(1) expected time. Takes the place of scanning current_pcbs,
+ *        which is kept only for iterating over every process (e.g. in ps).
+ *
+ * @param pid the pid to look up
+ * @return a ptr to the pcb with the pid, or NULL if there is none
+ */
+pcb_t* pid_table_get(pid_t pid);
+
+/**
+ * @brief Empties the pid table and frees its buckets. The pcbs themselves
+ *        are owned by current_pcbs.
+ */
+void pid_table_clear();
+
+#endif  // PID_TABLE_H_
@@ -0,0 +1,110 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements kernel pipes.
+ */
+
+#include "pipe.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/pennos-errno.h"
+#include "scheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                              PIPE FUNCTIONS                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Creates an empty pipe with one read end and one write end.
+ */
+pipe_t* pipe_new() {
+  pipe_t* pipe = malloc(sizeof(pipe_t));
+  if (pipe == NULL) {
+    P_ERRNO = P_EMALLOC;
+    return NULL;
+  }
+  pipe->head = 0;
+  pipe->tail = 0;
+  pipe->read_ends = 1;
+  pipe->write_ends = 1;
+  pcb_queue_init(&pipe->read_waiters);
+  pcb_queue_init(&pipe->write_waiters);
+  return pipe;
+}
+
+/**
+ * @brief Reads up to n bytes, blocking while the pipe is empty.
+ */
+int pipe_read(pipe_t* pipe, char* buf, int n) {
+  while (pipe->tail == pipe->head && pipe->write_ends > 0) {
+    block_on_wait_queue(&pipe->read_waiters);
+  }
+
+  unsigned int count = pipe->tail - pipe->head;
+  if (count > (unsigned int)n) {
+    count = n;
+  }
+
+  // copy out in at most two pieces, up to the end of buf and from its start
+  unsigned int start = pipe->head & (PIPE_CAPACITY - 1);
+  unsigned int first = PIPE_CAPACITY - start < count ? PIPE_CAPACITY - start
+                                                      : count;
+  memcpy(buf, pipe->buf + start, first);
+  memcpy(buf + first, pipe->buf, count - first);
+  pipe->head += count;
+
+  if (count > 0) {
+    wake_all(&pipe->write_waiters);
+  }
+  return count;
+}
+
+/**
+ * @brief Writes n bytes, blocking whenever the pipe is full.
+ */
+int pipe_write(pipe_t* pipe, const char* buf, int n) {
+  int written = 0;
+  while (written < n) {
+    if (pipe->read_ends == 0) {
+      P_ERRNO = P_EPIPE;
+      return written > 0 ? written : -1;
+    }
+
+    unsigned int room = PIPE_CAPACITY - (pipe->tail - pipe->head);
+    if (room == 0) {
+      block_on_wait_queue(&pipe->write_waiters);
+      continue;
+    }
+
+    unsigned int count = (unsigned int)(n - written);
+    if (count > room) {
+      count = room;
+    }
+    unsigned int start = pipe->tail & (PIPE_CAPACITY - 1);
+    unsigned int first = PIPE_CAPACITY - start < count ? PIPE_CAPACITY - start
+                                                        : count;
+    memcpy(pipe->buf + start, buf + written, first);
+    memcpy(pipe->buf, buf + written + first, count - first);
+    pipe->tail += count;
+    written += count;
+
+    wake_all(&pipe->read_waiters);
+  }
+  return written;
+}
+
+/**
+ * @brief Closes one end of the pipe, freeing it once both sides are closed.
+ */
+void pipe_close_end(pipe_t* pipe, bool write_end) {
+  if (write_end) {
+    pipe->write_ends--;
+    wake_all(&pipe->read_waiters);  // they may now see end of file
+  } else {
+    pipe->read_ends--;
+    wake_all(&pipe->write_waiters);  // they may now fail with P_EPIPE
+  }
+
+  if (pipe->read_ends == 0 && pipe->write_ends == 0) {
+    free(pipe);
+  }
+}
@@ -0,0 +1,77 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines kernel pipes: a fixed-capacity ring buffer between the
+ *          processes holding its read and write ends, which block on the
+ *          pipe's wait queues while it is empty or full.
+ */
+
+#ifndef PIPE_H_
+#define PIPE_H_
+
+#include "kern_pcb.h"
+
+#define PIPE_CAPACITY 4096  // bytes a pipe holds, must be a power of two
+
+/**
+ * @brief A pipe. head and tail run freely and are masked into buf, so the
+ *        pipe holds tail - head bytes: readers only move head and writers
+ *        only move tail. Every access is made with the kernel lock held,
+ *        which also covers the wait queues and end counts.
+ */
+typedef struct pipe_st {
+  char buf[PIPE_CAPACITY];
+  unsigned int head;           // next byte to read
+  unsigned int tail;           // next byte to write
+  int read_ends;               // open system-wide fds on the read end
+  int write_ends;              // open system-wide fds on the write end
+  pcb_queue_t read_waiters;    // processes waiting for data
+  pcb_queue_t write_waiters;   // processes waiting for room
+} pipe_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                              PIPE FUNCTIONS                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Creates an empty pipe with one open read end and one open write end.
+ *
+ * @return a ptr to the pipe, or NULL with P_ERRNO set to P_EMALLOC
+ */
+pipe_t* pipe_new();
+
+/**
+ * @brief Reads up to n bytes, blocking the calling process on the pipe while
+ *        it is empty and still has a writer. Returns as soon as some bytes
+ *        are read. Called with the kernel lock held.
+ *
+ * @param pipe the pipe
+ * @param buf  the buffer to read into
+ * @param n    the most bytes to read
+ * @return the number of bytes read, or 0 once the pipe is empty and every
+ *         write end is closed
+ */
+int pipe_read(pipe_t* pipe, char* buf, int n);
+
+/**
+ * @brief Writes n bytes, blocking the calling process on the pipe whenever
+ *        it is full. Called with the kernel lock held.
+ *
+ * @param pipe the pipe
+ * @param buf  the bytes to write
+ * @param n    the number of bytes to write
+ * @return n, or the bytes written before every read end was closed with
+ *         P_ERRNO set to P_EPIPE, which is -1 if no byte was written
+ */
+int pipe_write(pipe_t* pipe, const char* buf, int n);
+
+/**
+ * @brief Closes one read or write end, waking the processes blocked on the
+ *        other side so they see end of file or P_EPIPE. The pipe is freed
+ *        once both sides are closed. Called with the kernel lock held.
+ *
+ * @param pipe      the pipe
+ * @param write_end true to close a write end, false for a read end
+ */
+void pipe_close_end(pipe_t* pipe, bool write_end);
+
+#endif  // PIPE_H_
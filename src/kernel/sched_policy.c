@@ -0,0 +1,490 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the scheduling policies: the deterministic priority
+ *          policy, stride scheduling, cfs-style fair scheduling and lottery
+ *          scheduling.
+ */
+
+#include "sched_policy.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/Vec.h"
+#include "../lib/pennos-errno.h"
+
+extern cpu_t cpus[MAX_CPUS];
+
+// default tickets per priority level, 1.5x apart like det_priorities_arr
+static const int priority_tickets[3] = {900, 600, 400};
+
+/**
+ * @brief Returns the number of tickets the pcb holds.
+ */
+int pcb_tickets(pcb_t* pcb) {
+  if (pcb->tickets > 0) {
+    return pcb->tickets;
+  }
+  return priority_tickets[pcb->priority];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                              PRIORITY POLICY                               //
+////////////////////////////////////////////////////////////////////////////////
+
+int det_priorities_arr[19] = {0, 1, 2, 0, 0, 1, 0, 1, 2, 0,
+                              0, 1, 2, 0, 1, 0, 0, 1, 2};
+
+/**
+ * @brief Generates the next priority for scheduling based on the defined
+ * probabilities.
+ */
+int generate_next_priority(cpu_t* cpu) {
+  // check if all queues are empty
+  if (pcb_queue_is_empty(&cpu->run_queues[0]) &&
+      pcb_queue_is_empty(&cpu->run_queues[1]) &&
+      pcb_queue_is_empty(&cpu->run_queues[2])) {
+    return -1;
+  }
+
+  int priorities_attempted = 0;
+  while (priorities_attempted < 19) {
+    int curr_pri = det_priorities_arr[cpu->priority_arr_index];
+    cpu->priority_arr_index = (cpu->priority_arr_index + 1) % 19;
+    if (!pcb_queue_is_empty(&cpu->run_queues[curr_pri])) {
+      priorities_attempted++;
+      return curr_pri;
+    }
+  }
+
+  return -1;  // should never reach
+}
+
+/**
+ * @brief Returns the run queue for the given cpu and priority level.
+ */
+pcb_queue_t* get_priority_queue(int cpu, int priority) {
+  if (cpu < 0 || cpu >= MAX_CPUS || priority < 0 || priority > 2) {
+    return NULL;
+  }
+  return &cpus[cpu].run_queues[priority];
+}
+
+/**
+ * @brief Gets the next PCB from the specified priority queue.
+ */
+pcb_t* get_next_pcb(cpu_t* cpu, int priority) {
+  pcb_queue_t* queue = get_priority_queue(cpu->id, priority);
+  if (queue == NULL) {  // all queues empty
+    return NULL;
+  }
+
+  return pcb_queue_pop_front(queue);
+}
+
+/**
+ * @brief Initializes the cpu's priority queues.
+ */
+static void priority_init_cpu(cpu_t* cpu) {
+  for (int priority = 0; priority < 3; priority++) {
+    pcb_queue_init(&cpu->run_queues[priority]);
+  }
+  cpu->priority_arr_index = 0;
+}
+
+/**
+ * @brief Empties the cpu's priority queues.
+ */
+static void priority_destroy_cpu(cpu_t* cpu) {
+  priority_init_cpu(cpu);
+}
+
+/**
+ * @brief Appends the pcb to the queue of its priority.
+ */
+static void priority_enqueue(cpu_t* cpu, pcb_t* pcb) {
+  pcb_queue_push_back(get_priority_queue(cpu->id, pcb->priority), pcb);
+}
+
+/**
+ * @brief Unlinks the pcb if it is on one of the cpu's priority queues.
+ */
+static bool priority_dequeue(cpu_t* cpu, pcb_t* pcb) {
+  for (int priority = 0; priority < 3; priority++) {
+    if (pcb->queue == &cpu->run_queues[priority]) {
+      pcb_queue_remove(pcb);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Pops the next pcb of the next priority level in the cycle.
+ */
+static pcb_t* priority_pick_next(cpu_t* cpu) {
+  return get_next_pcb(cpu, generate_next_priority(cpu));
+}
+
+/**
+ * @brief Counts the pcbs on the cpu's priority queues.
+ */
+static size_t priority_queued(cpu_t* cpu) {
+  return pcb_queue_len(&cpu->run_queues[0]) +
+         pcb_queue_len(&cpu->run_queues[1]) +
+         pcb_queue_len(&cpu->run_queues[2]);
+}
+
+static const sched_policy_t priority_policy = {
+    .name = "priority",
+    .init_cpu = priority_init_cpu,
+    .destroy_cpu = priority_destroy_cpu,
+    .enqueue = priority_enqueue,
+    .dequeue = priority_dequeue,
+    .pick_next = priority_pick_next,
+    .ran = NULL,
+    .queued = priority_queued,
+    .migrate = NULL,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                             VIRTUAL TIME HEAP                              //
+////////////////////////////////////////////////////////////////////////////////
+
+// Shared by the stride and cfs policies: each cpu keeps its runnable pcbs in
+// a min-heap on vtime, the virtual time they have been charged for so far.
+
+/**
+ * @brief Stores the pcb at the given heap index and records that index in
+ * the pcb so it can be removed later without searching.
+ */
+static void vtime_heap_place(cpu_t* cpu, size_t index, pcb_t* pcb) {
+  vec_set(&cpu->vtime_heap, index, pcb);  // NULL deconstructor, not freed
+  pcb->heap_index = index;
+}
+
+/**
+ * @brief Moves the pcb at the given index up until its parent has a smaller
+ * vtime.
+ */
+static void vtime_heap_sift_up(cpu_t* cpu, size_t index) {
+  pcb_t* pcb = vec_get(&cpu->vtime_heap, index);
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    pcb_t* parent_pcb = vec_get(&cpu->vtime_heap, parent);
+    if (parent_pcb->vtime <= pcb->vtime) {
+      break;
+    }
+    vtime_heap_place(cpu, index, parent_pcb);
+    index = parent;
+  }
+  vtime_heap_place(cpu, index, pcb);
+}
+
+/**
+ * @brief Moves the pcb at the given index down until both children have a
+ * larger vtime.
+ */
+static void vtime_heap_sift_down(cpu_t* cpu, size_t index) {
+  size_t len = vec_len(&cpu->vtime_heap);
+  pcb_t* pcb = vec_get(&cpu->vtime_heap, index);
+  while (true) {
+    size_t smallest = 2 * index + 1;
+    if (smallest >= len) {
+      break;
+    }
+    pcb_t* child = vec_get(&cpu->vtime_heap, smallest);
+    if (smallest + 1 < len) {
+      pcb_t* right = vec_get(&cpu->vtime_heap, smallest + 1);
+      if (right->vtime < child->vtime) {
+        smallest++;
+        child = right;
+      }
+    }
+    if (pcb->vtime <= child->vtime) {
+      break;
+    }
+    vtime_heap_place(cpu, index, child);
+    index = smallest;
+  }
+  vtime_heap_place(cpu, index, pcb);
+}
+
+/**
+ * @brief Initializes the cpu's vtime heap.
+ */
+static void vtime_init_cpu(cpu_t* cpu) {
+  cpu->vtime_heap = vec_new(0, NULL);
+  cpu->min_vtime = 0;
+}
+
+/**
+ * @brief Frees the cpu's vtime heap.
+ */
+static void vtime_destroy_cpu(cpu_t* cpu) {
+  vec_destroy(&cpu->vtime_heap);
+}
+
+/**
+ * @brief Inserts the pcb into the vtime heap. O(log n).
+ */
+static void vtime_heap_insert(cpu_t* cpu, pcb_t* pcb) {
+  vec_push_back(&cpu->vtime_heap, pcb);
+  vtime_heap_sift_up(cpu, vec_len(&cpu->vtime_heap) - 1);
+}
+
+/**
+ * @brief Removes the pcb from the vtime heap if it is on it. O(log n).
+ */
+static bool vtime_dequeue(cpu_t* cpu, pcb_t* pcb) {
+  if (pcb->heap_index == -1 || pcb->heap_index >= vec_len(&cpu->vtime_heap) ||
+      vec_get(&cpu->vtime_heap, pcb->heap_index) != pcb) {
+    return false;
+  }
+
+  size_t index = pcb->heap_index;
+  size_t last = vec_len(&cpu->vtime_heap) - 1;
+  pcb_t* last_pcb = vec_get(&cpu->vtime_heap, last);
+  vec_pop_back(&cpu->vtime_heap);  // NULL deconstructor, pcb isn't freed
+  pcb->heap_index = -1;
+
+  if (index != last) {
+    // fill the hole with the last element and restore the heap property
+    vtime_heap_place(cpu, index, last_pcb);
+    vtime_heap_sift_up(cpu, index);
+    vtime_heap_sift_down(cpu, last_pcb->heap_index);
+  }
+  return true;
+}
+
+/**
+ * @brief Pops the pcb with the smallest vtime and moves the cpu's min_vtime
+ * forward to it. O(log n).
+ */
+static pcb_t* vtime_pick_next(cpu_t* cpu) {
+  if (vec_is_empty(&cpu->vtime_heap)) {
+    return NULL;
+  }
+
+  pcb_t* next = vec_get(&cpu->vtime_heap, 0);
+  vtime_dequeue(cpu, next);
+  if (next->vtime > cpu->min_vtime) {
+    cpu->min_vtime = next->vtime;
+  }
+  return next;
+}
+
+/**
+ * @brief Counts the pcbs on the cpu's vtime heap.
+ */
+static size_t vtime_queued(cpu_t* cpu) {
+  return vec_len(&cpu->vtime_heap);
+}
+
+/**
+ * @brief Rebases the pcb's vtime from one cpu's min_vtime to the other's, so
+ * it keeps its lead or lag relative to the processes it now competes with.
+ */
+static void vtime_migrate(cpu_t* from, cpu_t* to, pcb_t* pcb) {
+  unsigned long long lag =
+      pcb->vtime > from->min_vtime ? pcb->vtime - from->min_vtime : 0;
+  pcb->vtime = to->min_vtime + lag;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               STRIDE POLICY                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Inserts the pcb into the vtime heap, keyed on its pass. O(log n).
+ */
+static void stride_enqueue(cpu_t* cpu, pcb_t* pcb) {
+  // a pcb that was blocked (or is new) starts at the cpu's current pass, so
+  // it can't build up credit while it isn't runnable
+  if (pcb->vtime < cpu->min_vtime) {
+    pcb->vtime = cpu->min_vtime;
+  }
+  vtime_heap_insert(cpu, pcb);
+}
+
+/**
+ * @brief Advances the pcb's pass by its stride, scaled by the part of the
+ * quantum it actually used.
+ */
+static void stride_ran(cpu_t* cpu, pcb_t* pcb, long long usec) {
+  unsigned long long stride = STRIDE_ONE / pcb_tickets(pcb);
+  unsigned long long advance =
+      stride * (unsigned long long)usec / get_scheduler_quantum();
+  pcb->vtime += advance > 0 ? advance : 1;
+}
+
+static const sched_policy_t stride_policy = {
+    .name = "stride",
+    .init_cpu = vtime_init_cpu,
+    .destroy_cpu = vtime_destroy_cpu,
+    .enqueue = stride_enqueue,
+    .dequeue = vtime_dequeue,
+    .pick_next = vtime_pick_next,
+    .ran = stride_ran,
+    .queued = vtime_queued,
+    .migrate = vtime_migrate,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 CFS POLICY                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+// load weight per priority level, 1.5x apart like det_priorities_arr; a
+// priority 1 process is charged one usec of vruntime per usec it runs
+static const int cfs_weights[3] = {1536, CFS_WEIGHT_ONE, 683};
+
+/**
+ * @brief Returns the load weight of the pcb's priority.
+ */
+int cfs_weight(pcb_t* pcb) {
+  return cfs_weights[pcb->priority];
+}
+
+/**
+ * @brief Inserts the pcb into the vtime heap, keyed on its vruntime.
+ * O(log n).
+ */
+static void cfs_enqueue(cpu_t* cpu, pcb_t* pcb) {
+  // a pcb that slept (or is new) gets at most half a quantum of credit over
+  // the cpu's min_vtime: enough to run soon after waking, without being able
+  // to monopolize the cpu to catch up on the time it spent blocked
+  unsigned long long credit = get_scheduler_quantum() / 2;
+  unsigned long long floor =
+      cpu->min_vtime > credit ? cpu->min_vtime - credit : 0;
+  if (pcb->vtime < floor) {
+    pcb->vtime = floor;
+  }
+  vtime_heap_insert(cpu, pcb);
+}
+
+/**
+ * @brief Charges the pcb for the usecs it actually ran, weighted by its
+ * priority.
+ */
+static void cfs_ran(cpu_t* cpu, pcb_t* pcb, long long usec) {
+  unsigned long long delta =
+      (unsigned long long)usec * CFS_WEIGHT_ONE / cfs_weight(pcb);
+  pcb->vtime += delta > 0 ? delta : 1;
+}
+
+static const sched_policy_t cfs_policy = {
+    .name = "cfs",
+    .init_cpu = vtime_init_cpu,
+    .destroy_cpu = vtime_destroy_cpu,
+    .enqueue = cfs_enqueue,
+    .dequeue = vtime_dequeue,
+    .pick_next = vtime_pick_next,
+    .ran = cfs_ran,
+    .queued = vtime_queued,
+    .migrate = vtime_migrate,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                              LOTTERY POLICY                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes the cpu's lottery list, which reuses run_queues[0].
+ */
+static void lottery_init_cpu(cpu_t* cpu) {
+  pcb_queue_init(&cpu->run_queues[0]);
+  cpu->total_tickets = 0;
+  cpu->lottery_seed = (unsigned int)cpu->id + 1;
+}
+
+/**
+ * @brief Empties the cpu's lottery list.
+ */
+static void lottery_destroy_cpu(cpu_t* cpu) {
+  lottery_init_cpu(cpu);
+}
+
+/**
+ * @brief Adds the pcb and its tickets to the lottery. O(1).
+ */
+static void lottery_enqueue(cpu_t* cpu, pcb_t* pcb) {
+  pcb_queue_push_back(&cpu->run_queues[0], pcb);
+  cpu->total_tickets += pcb_tickets(pcb);
+}
+
+/**
+ * @brief Removes the pcb and its tickets from the lottery. O(1).
+ */
+static bool lottery_dequeue(cpu_t* cpu, pcb_t* pcb) {
+  if (pcb->queue != &cpu->run_queues[0]) {
+    return false;
+  }
+  pcb_queue_remove(pcb);
+  cpu->total_tickets -= pcb_tickets(pcb);
+  return true;
+}
+
+/**
+ * @brief Draws a winning ticket and pops the pcb holding it. O(n).
+ */
+static pcb_t* lottery_pick_next(cpu_t* cpu) {
+  if (pcb_queue_is_empty(&cpu->run_queues[0])) {
+    return NULL;
+  }
+
+  long winner = rand_r(&cpu->lottery_seed) % cpu->total_tickets;
+  pcb_t* pcb = cpu->run_queues[0].head;
+  while (winner >= pcb_tickets(pcb) && pcb->queue_next != NULL) {
+    winner -= pcb_tickets(pcb);
+    pcb = pcb->queue_next;
+  }
+
+  lottery_dequeue(cpu, pcb);
+  return pcb;
+}
+
+/**
+ * @brief Counts the pcbs in the cpu's lottery.
+ */
+static size_t lottery_queued(cpu_t* cpu) {
+  return pcb_queue_len(&cpu->run_queues[0]);
+}
+
+static const sched_policy_t lottery_policy = {
+    .name = "lottery",
+    .init_cpu = lottery_init_cpu,
+    .destroy_cpu = lottery_destroy_cpu,
+    .enqueue = lottery_enqueue,
+    .dequeue = lottery_dequeue,
+    .pick_next = lottery_pick_next,
+    .ran = NULL,
+    .queued = lottery_queued,
+    .migrate = NULL,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                         POLICY SELECTION FUNCTIONS                         //
+////////////////////////////////////////////////////////////////////////////////
+
+static const sched_policy_t* policies[] = {&priority_policy, &stride_policy,
+                                           &cfs_policy, &lottery_policy};
+static const sched_policy_t* sched_policy = &priority_policy;
+
+/**
+ * @brief Selects the scheduling policy by name.
+ */
+int set_sched_policy(const char* name) {
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    if (strcmp(policies[i]->name, name) == 0) {
+      sched_policy = policies[i];
+      return 0;
+    }
+  }
+  P_ERRNO = P_EINVAL;
+  return -1;
+}
+
+/**
+ * @brief Returns the selected scheduling policy.
+ */
+const sched_policy_t* get_sched_policy() {
+  return sched_policy;
+}
@@ -0,0 +1,153 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the scheduling policy interface and the policies that can
+ *          be selected at boot (priority, stride, cfs, lottery).
+ */
+
+#ifndef SCHED_POLICY_H_
+#define SCHED_POLICY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "kern_pcb.h"
+#include "scheduler.h"
+
+#define STRIDE_ONE (1 << 20)  // stride of a process holding a single ticket
+#define MAX_TICKETS 10000     // upper bound accepted by s_set_tickets
+#define CFS_WEIGHT_ONE 1024   // cfs load weight of a priority 1 process
+
+/**
+ * @brief A scheduling policy. It owns the order of the runnable pcbs queued on
+ *        each cpu; everything else (blocking, sleeping, signals, zombies) is
+ *        handled by the scheduler the same way for every policy. All hooks
+ *        are called with the kernel lock held.
+ */
+typedef struct sched_policy_st {
+  const char* name;  // name used by the --sched boot option
+
+  /**
+   * @brief Sets up the policy's per-cpu run queue state.
+   */
+  void (*init_cpu)(cpu_t* cpu);
+
+  /**
+   * @brief Frees the policy's per-cpu run queue state.
+   */
+  void (*destroy_cpu)(cpu_t* cpu);
+
+  /**
+   * @brief Queues a runnable pcb on the cpu. The pcb is on no other queue.
+   */
+  void (*enqueue)(cpu_t* cpu, pcb_t* pcb);
+
+  /**
+   * @brief Unlinks the pcb from the cpu's run queue.
+   * @return true if it was queued there, false otherwise
+   */
+  bool (*dequeue)(cpu_t* cpu, pcb_t* pcb);
+
+  /**
+   * @brief Removes and returns the pcb the cpu should run next.
+   * @return a ptr to the next pcb, or NULL if nothing is queued
+   */
+  pcb_t* (*pick_next)(cpu_t* cpu);
+
+  /**
+   * @brief Charges the pcb for the time it just ran. May be NULL.
+   */
+  void (*ran)(cpu_t* cpu, pcb_t* pcb, long long usec);
+
+  /**
+   * @brief Returns the number of pcbs queued on the cpu, used to find the
+   *        cpu to steal work from.
+   */
+  size_t (*queued)(cpu_t* cpu);
+
+  /**
+   * @brief Adjusts a pcb that was just taken off one cpu to run on another
+   *        (work stealing). May be NULL.
+   */
+  void (*migrate)(cpu_t* from, cpu_t* to, pcb_t* pcb);
+} sched_policy_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                         POLICY SELECTION FUNCTIONS                         //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Selects the scheduling policy by name. Must be called before the
+ *        scheduler queues are initialized, e.g. from the --sched boot option.
+ *
+ * @param name "priority" (the default), "stride", "cfs" or "lottery"
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL for an unknown name
+ */
+int set_sched_policy(const char* name);
+
+/**
+ * @brief Returns the selected scheduling policy.
+ *
+ * @return a ptr to the policy's vtable
+ */
+const sched_policy_t* get_sched_policy();
+
+/**
+ * @brief Returns the number of tickets the pcb holds under the proportional
+ *        share policies (stride, lottery). Unless set with s_set_tickets, this
+ *        follows the pcb's priority so that, like the priority policy, a
+ *        level gets 1.5x the cpu of the level below it.
+ *
+ * @param pcb a ptr to the pcb
+ * @return the pcb's tickets, always positive
+ */
+int pcb_tickets(pcb_t* pcb);
+
+/**
+ * @brief Returns the pcb's load weight under the cfs policy, which follows
+ *        its priority (1536, 1024, 683). A process's vruntime advances by the
+ *        usecs it ran times CFS_WEIGHT_ONE / weight.
+ *
+ * @param pcb a ptr to the pcb
+ * @return the pcb's weight, always positive
+ */
+int cfs_weight(pcb_t* pcb);
+
+////////////////////////////////////////////////////////////////////////////////
+//                       PRIORITY POLICY HELPER FUNCTIONS                     //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Deterministically chooses an integer from 0, 1, 2 at the prescribed
+ *        probabilites. In particular, 0 is output 1.5x more than
+ *        1, which is output 1.5x more than 2. Notably, it accounts
+ *        for cases where some of the queues are empty. If all queues are empty,
+ *        it'll return -1.
+ *
+ * @param cpu the cpu whose run queues to choose from
+ * @return int 0, 1, or 2 for priority or -1 to signify that all queues
+ *         are empty
+ */
+int generate_next_priority(cpu_t* cpu);
+
+/**
+ * @brief Returns the next PCB in the cpu's queue of the specified priority.
+ *        or NULL if that queue is empty. Notably, it removes the PCB
+ *        from the queue.
+ *
+ * @param cpu      the cpu whose run queue to pop from
+ * @param priority queue priority to get next PCB from, or -1 if none
+ * @return         a ptr to the next pcb struct in queue or NULL
+ *                 if the queue is empty
+ */
+pcb_t* get_next_pcb(cpu_t* cpu, int priority);
+
+/**
+ * @brief Returns the priority policy's run queue for the given cpu and
+ *        priority level.
+ *
+ * @param cpu      the cpu id
+ * @param priority the priority level (0, 1, 2)
+ * @return ptr to the matching run queue, or NULL if an argument is invalid
+ */
+pcb_queue_t* get_priority_queue(int cpu, int priority);
+
+#endif  // SCHED_POLICY_H_
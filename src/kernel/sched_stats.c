@@ -0,0 +1,164 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the scheduler instrumentation histograms.
+ */
+
+#include "sched_stats.h"
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "kern_lock.h"
+
+static histogram_t sched_stats[NUM_SCHED_STATS];
+
+static const struct {
+  const char* name;
+  long long scale;  // divisor to the displayed unit
+} sched_stat_info[NUM_SCHED_STATS] = {
+    [STAT_DISPATCH_LATENCY] = {"dispatch latency (us)", 1000},
+    [STAT_QUANTUM_USED] = {"quantum used (us)", 1000},
+    [STAT_SCHED_PASS] = {"scheduler pass (us)", 1000},
+    [STAT_QUEUE_DEPTH_0] = {"queue depth, priority 0", 1},
+    [STAT_QUEUE_DEPTH_1] = {"queue depth, priority 1", 1},
+    [STAT_QUEUE_DEPTH_2] = {"queue depth, priority 2", 1},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                            HISTOGRAM FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Returns the index of the bucket holding the value.
+ */
+static int hist_bucket(long long value) {
+  if (value < (1 << HIST_SUB_BITS)) {
+    return (int)value;  // small values get a bucket each
+  }
+
+  // keep the top HIST_SUB_BITS bits of the value; the shift says which power
+  // of two it is in, the remaining bits which linear bucket within it
+  int msb = 63 - __builtin_clzll((unsigned long long)value);
+  int shift = msb - HIST_SUB_BITS + 1;
+  return shift * HIST_SUB_HALF + (int)(value >> shift);
+}
+
+/**
+ * @brief Returns the highest value that falls in the bucket.
+ */
+static long long hist_bucket_max(int bucket) {
+  if (bucket < (1 << HIST_SUB_BITS)) {
+    return bucket;
+  }
+
+  int shift = bucket / HIST_SUB_HALF - 1;
+  long long sub = bucket % HIST_SUB_HALF + HIST_SUB_HALF;
+  return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Records a value in the histogram.
+ */
+void hist_record(histogram_t* hist, long long value) {
+  if (value < 0) {
+    value = 0;
+  }
+  if (hist->count == 0 || value < hist->min) {
+    hist->min = value;
+  }
+  if (value > hist->max) {
+    hist->max = value;
+  }
+  hist->count++;
+  hist->sum += value;
+  hist->buckets[hist_bucket(value)]++;
+}
+
+/**
+ * @brief Returns the value at the given percentile.
+ */
+long long hist_percentile(const histogram_t* hist, double percentile) {
+  if (hist->count == 0) {
+    return 0;
+  }
+
+  // rank of the sample, rounded up, at least the first one
+  long long rank = (long long)(percentile / 100.0 * hist->count + 0.999999);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  long long seen = 0;
+  for (int bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+    seen += hist->buckets[bucket];
+    if (seen >= rank) {
+      long long value = hist_bucket_max(bucket);
+      return value < hist->max ? value : hist->max;
+    }
+  }
+  return hist->max;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                         SCHEDULER STATS FUNCTIONS                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds.
+ */
+long long sched_stats_now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * @brief Records a value in one of the scheduler's histograms.
+ */
+void sched_stats_record(sched_stat_t stat, long long value) {
+  hist_record(&sched_stats[stat], value);
+}
+
+/**
+ * @brief Formats a table of the scheduler's histograms.
+ */
+int sched_stats_format(char* buf, size_t size) {
+  static const double percentiles[] = {50, 90, 99, 99.9};
+
+  int len = snprintf(buf, size, "%-24s %8s %9s %9s %9s %9s %9s %9s %9s\n",
+                     "STAT", "COUNT", "MIN", "P50", "P90", "P99", "P99.9",
+                     "MAX", "MEAN");
+
+  kernel_lock();
+  for (int stat = 0; stat < NUM_SCHED_STATS; stat++) {
+    const histogram_t* hist = &sched_stats[stat];
+    double scale = (double)sched_stat_info[stat].scale;
+    if (len >= size) {
+      break;
+    }
+    len += snprintf(buf + len, size - len, "%-24s %8lld %9.1f",
+                    sched_stat_info[stat].name, hist->count, hist->min / scale);
+    for (int i = 0; i < 4 && len < size; i++) {
+      len += snprintf(buf + len, size - len, " %9.1f",
+                      hist_percentile(hist, percentiles[i]) / scale);
+    }
+    if (len < size) {
+      double mean = hist->count > 0 ? (double)hist->sum / hist->count : 0;
+      len += snprintf(buf + len, size - len, " %9.1f %9.1f\n",
+                      hist->max / scale, mean / scale);
+    }
+  }
+  kernel_unlock();
+
+  return len < size ? len : (int)size - 1;
+}
+
+/**
+ * @brief Writes the scheduler's histograms to a host file descriptor.
+ */
+void sched_stats_dump(int host_fd) {
+  char buf[SCHED_STATS_BUF_SIZE];
+  int len = sched_stats_format(buf, sizeof(buf));
+  if (write(host_fd, buf, len) == -1) {
+    perror("error in writing the scheduler stats");
+  }
+}
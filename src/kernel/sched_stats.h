@@ -0,0 +1,107 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the scheduler instrumentation: HDR-style histograms of
+ *          dispatch latency, quantum use, scheduler pass time and run queue
+ *          depth.
+ */
+
+#ifndef SCHED_STATS_H_
+#define SCHED_STATS_H_
+
+#include <stddef.h>
+
+// each power of two is split into HIST_SUB_HALF linear buckets, so a recorded
+// value is off by at most 1/HIST_SUB_HALF (1.6%) of itself
+#define HIST_SUB_BITS 7
+#define HIST_SUB_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_HALF)
+
+#define SCHED_STATS_BUF_SIZE 2048  // fits the output of sched_stats_format
+
+/**
+ * @brief A log-linear histogram of non-negative values, in the style of
+ *        HdrHistogram: constant relative precision over the whole range with
+ *        a fixed number of buckets, O(1) to record.
+ */
+typedef struct histogram_st {
+  long long count;  // number of recorded values
+  long long sum;    // sum of recorded values, for the mean
+  long long min;    // smallest recorded value
+  long long max;    // largest recorded value
+  long long buckets[HIST_BUCKETS];
+} histogram_t;
+
+/**
+ * @brief The histograms kept by the scheduler.
+ */
+typedef enum {
+  STAT_DISPATCH_LATENCY,  // ns from spthread_continue until the thread runs
+  STAT_QUANTUM_USED,      // ns a process ran before blocking or preemption
+  STAT_SCHED_PASS,        // ns of one pass: signals, sleepers and the pick
+  STAT_QUEUE_DEPTH_0,     // runnable priority 0 pcbs queued at each pick
+  STAT_QUEUE_DEPTH_1,     // runnable priority 1 pcbs queued at each pick
+  STAT_QUEUE_DEPTH_2,     // runnable priority 2 pcbs queued at each pick
+  NUM_SCHED_STATS
+} sched_stat_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                            HISTOGRAM FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Records a value in the histogram. Negative values count as 0.
+ *
+ * @param hist  a ptr to the histogram
+ * @param value the value to record
+ */
+void hist_record(histogram_t* hist, long long value);
+
+/**
+ * @brief Returns the value at the given percentile, i.e. the highest value
+ *        that falls in the same bucket as the percentile's sample.
+ *
+ * @param hist       a ptr to the histogram
+ * @param percentile the percentile, from 0 to 100
+ * @return the value, or 0 if the histogram is empty
+ */
+long long hist_percentile(const histogram_t* hist, double percentile);
+
+////////////////////////////////////////////////////////////////////////////////
+//                         SCHEDULER STATS FUNCTIONS                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds, for the timing stats.
+ *
+ * @return the current time in ns
+ */
+long long sched_stats_now_ns();
+
+/**
+ * @brief Records a value in one of the scheduler's histograms. Must be called
+ *        with the kernel lock held.
+ *
+ * @param stat  the histogram to record in
+ * @param value the value, in ns for timings
+ */
+void sched_stats_record(sched_stat_t stat, long long value);
+
+/**
+ * @brief Formats a table of every histogram's count, min, percentiles, max
+ *        and mean. Timings are shown in microseconds. Takes the kernel lock.
+ *
+ * @param buf  the buffer to fill, SCHED_STATS_BUF_SIZE bytes is enough
+ * @param size the size of buf
+ * @return the length of the formatted text
+ */
+int sched_stats_format(char* buf, size_t size);
+
+/**
+ * @brief Writes the table of sched_stats_format to a host file descriptor,
+ *        e.g. the log file at shutdown.
+ *
+ * @param host_fd the host file descriptor to write to
+ */
+void sched_stats_dump(int host_fd);
+
+#endif  // SCHED_STATS_H_
@@ -5,41 +5,51 @@
  */
 
 #include "scheduler.h"
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include "../lib/Vec.h"
+#include "../lib/pennos-errno.h"
 #include "../lib/spthread.h"
 #include "errno.h"
+#include "kern_lock.h"
 #include "kern_pcb.h"
 #include "logger.h"
+#include "pcb_alloc.h"
+#include "pid_table.h"
+#include "sched_policy.h"
+#include "sched_stats.h"
+#include "signal.h"
 #include "stdlib.h"
+#include "sync.h"
 
 /////////////////////////////////////////////////////////////////////////////////
 //                       QUEUES AND SCHEDULER DATA //
 /////////////////////////////////////////////////////////////////////////////////
 
-Vec zero_priority_queue;  // lower index = more recent
-Vec one_priority_queue;
-Vec two_priority_queue;
-Vec zombie_queue;
-Vec sleep_blocked_queue;
+cpu_t cpus[MAX_CPUS];  // per-cpu run queues and state
+int num_cpus = 1;      // cpus in use, set before scheduler() starts
 
-Vec current_pcbs;  // holds all currently running processes, for logging
+Vec sleep_heap;  // min-heap of sleeping pcbs keyed on time_to_wake
 
-static const int hundred_millisec = 100000;  // 100 milliseconds
-static bool scheduling_done = false;         // true if the scheduler is done
+// every process, oldest first, linked through all_prev/all_next
+pcb_t* current_pcbs = NULL;
+static pcb_t* current_pcbs_tail = NULL;
+int num_current_pcbs = 0;
+// pcbs with a non-zero pending_signals mask, in the order they were
+// signalled, linked through signal_prev/signal_next
+static pcb_t* signal_pending_head = NULL;
+static pcb_t* signal_pending_tail = NULL;
 
-int tick_counter = 0;
-int log_fd;  // file descriptor for the log file, set in pennos.c
-
-pcb_t* current_running_pcb;  // currently running process
+static long quantum_usec = 100000;  // length of one tick, 100 ms default
+static volatile bool scheduling_done = false;  // true once shutting down
+static struct timespec boot_time;  // tick 0, set when scheduler() starts
 
-int curr_priority_arr_index = 0;
-int det_priorities_arr[19] = {0, 1, 2, 0, 0, 1, 0, 1, 2, 0,
-                              0, 1, 2, 0, 1, 0, 0, 1, 2};
+int tick_counter = 0;  // ticks elapsed since boot_time, see update_ticks()
+int log_fd;  // file descriptor for the log file, set in pennos.c
 
 /////////////////////////////////////////////////////////////////////////////////
 //                         QUEUE MAINTENANCE FUNCTIONS //
@@ -48,85 +58,426 @@ int det_priorities_arr[19] = {0, 1, 2, 0, 0, 1, 0, 1, 2, 0,
 /**
  * @brief Initializes the scheduler queues.
  *
- * @note The deconstructors for the queues are set to NULL to prevent double
- *       freeing when exiting PennOS.
+ * @note Only current_pcbs owns the PCBs. The other queues never free what is
+ *       linked into them.
  */
 void initialize_scheduler_queues() {
-  zero_priority_queue = vec_new(0, NULL);
-  one_priority_queue = vec_new(0, NULL);
-  two_priority_queue = vec_new(0, NULL);
-  zombie_queue = vec_new(0, NULL);
-  sleep_blocked_queue = vec_new(0, NULL);
-  current_pcbs = vec_new(0, free_pcb);
+  for (int i = 0; i < MAX_CPUS; i++) {
+    cpus[i].id = i;
+    get_sched_policy()->init_cpu(&cpus[i]);
+    cpus[i].current = NULL;
+    cpus[i].idle = false;
+    memset(cpus[i].queued_by_priority, 0, sizeof(cpus[i].queued_by_priority));
+  }
+  sleep_heap = vec_new(0, NULL);
+  current_pcbs = NULL;
+  current_pcbs_tail = NULL;
+  num_current_pcbs = 0;
+  signal_pending_head = NULL;
+  signal_pending_tail = NULL;
 }
 
 /**
  * @brief Frees the scheduler queues.
  */
 void free_scheduler_queues() {
-  vec_destroy(&zero_priority_queue);
-  vec_destroy(&one_priority_queue);
-  vec_destroy(&two_priority_queue);
-  vec_destroy(&zombie_queue);
-  vec_destroy(&sleep_blocked_queue);
-  vec_destroy(&current_pcbs);
+  signal_pending_head = NULL;  // the pcbs are freed with current_pcbs
+  signal_pending_tail = NULL;
+  while (current_pcbs != NULL) {  // freeing a group leader looks it up
+    pcb_t* pcb = current_pcbs;
+    current_pcbs = pcb->all_next;
+    free_pcb(pcb);
+  }
+  current_pcbs_tail = NULL;
+  num_current_pcbs = 0;
+  pid_table_clear();
+  pcb_alloc_destroy();
+  for (int i = 0; i < MAX_CPUS; i++) {
+    get_sched_policy()->destroy_cpu(&cpus[i]);
+  }
+  vec_destroy(&sleep_heap);
+}
+
+/**
+ * @brief Sets the number of virtual cpus.
+ */
+int set_num_cpus(int n) {
+#ifdef SPTHREAD_GREEN
+  int max_cpus = 1;  // every process runs on the thread of cpu 0
+#else
+  int max_cpus = MAX_CPUS;
+#endif
+  if (n < 1 || n > max_cpus) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  num_cpus = n;
+  return 0;
+}
+
+/**
+ * @brief Returns the pcb of the process running on the calling thread.
+ */
+pcb_t* get_current_running_pcb() {
+  // a process thread belongs to the same pcb until it is released to the
+  // thread pool, and green threads all share one host thread, so the
+  // cached pcb is only used while the caller is still the same spthread
+  static _Thread_local pcb_t* self = NULL;
+  static _Thread_local spthread_t self_thread;
+
+  spthread_t me;
+  if (!spthread_self(&me)) {
+    return NULL;  // a cpu's scheduler thread, or main
+  }
+  if (self != NULL && spthread_equal(self_thread, me)) {
+    return self;
+  }
+  self = NULL;
+
+  kernel_lock();
+  for (int i = 0; i < num_cpus; i++) {
+    pcb_t* running = cpus[i].current;
+    if (running != NULL && spthread_equal(running->thread_handle, me)) {
+      self = running;
+      self_thread = me;
+      break;
+    }
+  }
+  kernel_unlock();
+  return self;
 }
 
 /////////////////////////////////////////////////////////////////////////////////
-//                          SCHEDULING FUNCTIONS //
+//                          SLEEP QUEUE FUNCTIONS //
 /////////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief Generates the next priority for scheduling based on the defined
- * probabilities.
+ * @brief Stores the pcb at the given heap index and records that index in
+ * the pcb so it can be removed later without searching.
+ */
+static void sleep_heap_place(size_t index, pcb_t* pcb) {
+  vec_set(&sleep_heap, index, pcb);  // NULL deconstructor, nothing freed
+  pcb->sleep_heap_index = index;
+}
+
+/**
+ * @brief Moves the pcb at the given index up until its parent wakes earlier.
+ */
+static void sleep_heap_sift_up(size_t index) {
+  pcb_t* pcb = vec_get(&sleep_heap, index);
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    pcb_t* parent_pcb = vec_get(&sleep_heap, parent);
+    if (parent_pcb->time_to_wake <= pcb->time_to_wake) {
+      break;
+    }
+    sleep_heap_place(index, parent_pcb);
+    index = parent;
+  }
+  sleep_heap_place(index, pcb);
+}
+
+/**
+ * @brief Moves the pcb at the given index down until both children wake
+ * later.
+ */
+static void sleep_heap_sift_down(size_t index) {
+  size_t len = vec_len(&sleep_heap);
+  pcb_t* pcb = vec_get(&sleep_heap, index);
+  while (true) {
+    size_t smallest = 2 * index + 1;
+    if (smallest >= len) {
+      break;
+    }
+    pcb_t* child = vec_get(&sleep_heap, smallest);
+    if (smallest + 1 < len) {
+      pcb_t* right = vec_get(&sleep_heap, smallest + 1);
+      if (right->time_to_wake < child->time_to_wake) {
+        smallest++;
+        child = right;
+      }
+    }
+    if (pcb->time_to_wake <= child->time_to_wake) {
+      break;
+    }
+    sleep_heap_place(index, child);
+    index = smallest;
+  }
+  sleep_heap_place(index, pcb);
+}
+
+/**
+ * @brief Inserts a sleeping PCB into the sleep heap.
+ */
+void sleep_queue_insert(pcb_t* pcb) {
+  if (pcb->sleep_heap_index != -1) {
+    return;
+  }
+  vec_push_back(&sleep_heap, pcb);
+  sleep_heap_sift_up(vec_len(&sleep_heap) - 1);
+}
+
+/**
+ * @brief Removes a PCB from the sleep heap.
+ */
+void sleep_queue_remove(pcb_t* pcb) {
+  if (pcb->sleep_heap_index == -1) {
+    return;
+  }
+
+  size_t index = pcb->sleep_heap_index;
+  size_t last = vec_len(&sleep_heap) - 1;
+  pcb_t* last_pcb = vec_get(&sleep_heap, last);
+  vec_pop_back(&sleep_heap);  // NULL deconstructor, pcb isn't freed
+  pcb->sleep_heap_index = -1;
+
+  if (index != last) {
+    // fill the hole with the last element and restore the heap property
+    sleep_heap_place(index, last_pcb);
+    sleep_heap_sift_up(index);
+    sleep_heap_sift_down(last_pcb->sleep_heap_index);
+  }
+}
+
+/**
+ * @brief Pops the earliest sleeper if its deadline has passed.
+ */
+pcb_t* sleep_queue_pop_expired(int now) {
+  if (vec_is_empty(&sleep_heap)) {
+    return NULL;
+  }
+
+  pcb_t* earliest = vec_get(&sleep_heap, 0);
+  if (earliest->time_to_wake > now) {
+    return NULL;
+  }
+
+  sleep_queue_remove(earliest);
+  return earliest;
+}
+
+/**
+ * @brief Returns the earliest sleeper deadline, or -1 if nobody is asleep.
  */
-int generate_next_priority() {
-  // check if all queues are empty
-  if (vec_is_empty(&zero_priority_queue) && vec_is_empty(&one_priority_queue) &&
-      vec_is_empty(&two_priority_queue)) {
+int sleep_queue_next_deadline() {
+  if (vec_is_empty(&sleep_heap)) {
     return -1;
   }
+  pcb_t* earliest = vec_get(&sleep_heap, 0);
+  return earliest->time_to_wake;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//                          WAIT QUEUE FUNCTIONS //
+/////////////////////////////////////////////////////////////////////////////////
 
-  int priorities_attempted = 0;
-  while (priorities_attempted < 19) {
-    int curr_pri = det_priorities_arr[curr_priority_arr_index];
-    curr_priority_arr_index = (curr_priority_arr_index + 1) % 19;
-    if (curr_pri == 0 && !vec_is_empty(&zero_priority_queue)) {
-      priorities_attempted++;
-      return 0;
-    } else if (curr_pri == 1 && !vec_is_empty(&one_priority_queue)) {
-      priorities_attempted++;
-      return 1;
-    } else if (curr_pri == 2 && !vec_is_empty(&two_priority_queue)) {
-      priorities_attempted++;
-      return 2;
+/**
+ * @brief Blocks the current process on the wait queue until it is woken.
+ */
+void block_on_wait_queue(pcb_queue_t* wait_queue) {
+  pcb_t* self = current_running_pcb;
+  self->process_state = 'B';
+  pcb_queue_push_back(wait_queue, self);
+  log_generic_event('B', self->pid, self->priority, self->cmd_str);
+
+  yield_to_scheduler();  // give scheduler control
+}
+
+/**
+ * @brief Makes a process blocked on a wait queue runnable again.
+ */
+void wake_process(pcb_t* pcb) {
+  if (pcb->process_state != 'B' || pcb->is_sleeping) {
+    return;
+  }
+
+  pcb->process_state = 'R';
+  put_pcb_into_correct_queue(pcb);  // unlinks it from the wait queue
+  log_generic_event('U', pcb->pid, pcb->priority, pcb->cmd_str);
+}
+
+/**
+ * @brief Wakes every process blocked on the wait queue.
+ */
+void wake_all(pcb_queue_t* wait_queue) {
+  pcb_t* waiter;
+  while ((waiter = pcb_queue_pop_front(wait_queue)) != NULL) {
+    wake_process(waiter);
+  }
+}
+
+/**
+ * @brief Wakes the parent of a child that changed state if the parent is
+ * waiting on it.
+ */
+void wake_waiting_parent(pcb_t* child) {
+  pcb_t* parent = child->parent;
+  if (parent == NULL) {
+    return;
+  }
+
+  if (parent->waitpid_target != 0 &&
+      waitpid_matches(parent->waitpid_target, child)) {
+    wake_all(&parent->child_wait_queue);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//                        PENDING SIGNAL FUNCTIONS //
+/////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Tells whether the PCB is on the pending list.
+ */
+static bool on_pending_list(pcb_t* pcb) {
+  return pcb->signal_prev != NULL || signal_pending_head == pcb;
+}
+
+/**
+ * @brief Unlinks a PCB that is on the pending list.
+ */
+static void unlink_pending(pcb_t* pcb) {
+  if (pcb->signal_prev != NULL) {
+    pcb->signal_prev->signal_next = pcb->signal_next;
+  } else {
+    signal_pending_head = pcb->signal_next;
+  }
+  if (pcb->signal_next != NULL) {
+    pcb->signal_next->signal_prev = pcb->signal_prev;
+  } else {
+    signal_pending_tail = pcb->signal_prev;
+  }
+  pcb->signal_prev = NULL;
+  pcb->signal_next = NULL;
+}
+
+/**
+ * @brief Flags a signal as pending and queues the PCB for the scheduler.
+ */
+void add_pending_signal(pcb_t* pcb, int signal) {
+  if (!on_pending_list(pcb)) {
+    pcb->signal_prev = signal_pending_tail;
+    pcb->signal_next = NULL;
+    if (signal_pending_tail != NULL) {
+      signal_pending_tail->signal_next = pcb;
+    } else {
+      signal_pending_head = pcb;
+    }
+    signal_pending_tail = pcb;
+  }
+  pcb->pending_signals |= P_SIGMASK(signal);
+}
+
+/**
+ * @brief Removes the PCB from the pending list.
+ */
+void remove_from_pending_signals(pcb_t* pcb) {
+  pcb->pending_signals = 0;
+  if (on_pending_list(pcb)) {
+    unlink_pending(pcb);
+  }
+}
+
+/**
+ * @brief Handles all pending signals, in the order the PCBs were signalled.
+ */
+void drain_pending_signals() {
+  pcb_t* pcb = signal_pending_head;
+  while (pcb != NULL) {
+    if (pcb->on_cpu != -1) {
+      // its cpu handles the signals once the process is suspended
+      pcb = pcb->signal_next;
+      continue;
+    }
+    for (int sig = 0; sig < P_NSIG; sig++) {
+      if (pcb->pending_signals & P_SIGMASK(sig)) {
+        handle_signal(pcb, sig);
+      }
     }
+
+    // read after handling, which may signal more pcbs
+    pcb_t* next = pcb->signal_next;
+    if (pcb->pending_signals == 0) {
+      unlink_pending(pcb);
+    }
+    pcb = next;
   }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//                          SCHEDULING FUNCTIONS //
+/////////////////////////////////////////////////////////////////////////////////
 
-  return -1;  // should never reach
+/**
+ * @brief Pops the next PCB to run from the cpu's run queue.
+ */
+static pcb_t* pick_runnable(cpu_t* cpu) {
+  pcb_t* pcb = get_sched_policy()->pick_next(cpu);
+  if (pcb != NULL) {
+    cpu->queued_by_priority[pcb->priority]--;
+  }
+  return pcb;
 }
 
 /**
- * @brief Gets the next PCB from the specified priority queue.
+ * @brief Takes a runnable PCB from the cpu with the most queued work.
  */
-pcb_t* get_next_pcb(int priority) {
-  if (priority == -1) {  // all queues empty
+pcb_t* steal_pcb(cpu_t* thief) {
+  cpu_t* victim = NULL;
+  size_t most_queued = 0;
+  for (int i = 0; i < num_cpus; i++) {
+    size_t queued = get_sched_policy()->queued(&cpus[i]);
+    if (&cpus[i] != thief && queued > most_queued) {
+      victim = &cpus[i];
+      most_queued = queued;
+    }
+  }
+  if (victim == NULL) {
     return NULL;
   }
 
-  pcb_t* next_pcb = NULL;
-  if (priority == 0) {
-    next_pcb = vec_get(&zero_priority_queue, 0);
-    vec_erase_no_deletor(&zero_priority_queue, 0);
-  } else if (priority == 1) {
-    next_pcb = vec_get(&one_priority_queue, 0);
-    vec_erase_no_deletor(&one_priority_queue, 0);
-  } else if (priority == 2) {
-    next_pcb = vec_get(&two_priority_queue, 0);
-    vec_erase_no_deletor(&two_priority_queue, 0);
+  pcb_t* pcb = pick_runnable(victim);
+  if (pcb != NULL) {
+    if (get_sched_policy()->migrate != NULL) {
+      get_sched_policy()->migrate(victim, thief, pcb);
+    }
+    pcb->cpu = thief->id;  // it is queued on the thief from now on
   }
+  return pcb;
+}
 
-  return next_pcb;
+/**
+ * @brief Interrupts the given cpu's wait.
+ */
+void kick_cpu(int cpu) {
+  pthread_kill(cpus[cpu].thread, SIGALRM);
+}
+
+/**
+ * @brief Wakes an idle cpu so it picks up newly runnable work.
+ */
+void kick_idle_cpu(int home) {
+  if (cpus[home].idle) {
+    kick_cpu(home);
+    return;
+  }
+  for (int i = 0; i < num_cpus; i++) {
+    if (cpus[i].idle) {
+      kick_cpu(i);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Unlinks a runnable PCB from its home cpu's run queue.
+ */
+bool dequeue_runnable(pcb_t* pcb) {
+  if (!get_sched_policy()->dequeue(&cpus[pcb->cpu], pcb)) {
+    return false;
+  }
+  cpus[pcb->cpu].queued_by_priority[pcb->priority]--;
+  return true;
 }
 
 /**
@@ -134,31 +485,39 @@ pcb_t* get_next_pcb(int priority) {
  * state.
  */
 void put_pcb_into_correct_queue(pcb_t* pcb) {
-  if (pcb->process_state == 'R') {
-    if (pcb->priority == 0) {
-      vec_push_back(&zero_priority_queue, pcb);
-    } else if (pcb->priority == 1) {
-      vec_push_back(&one_priority_queue, pcb);
-    } else if (pcb->priority == 2) {
-      vec_push_back(&two_priority_queue, pcb);
+  if (pcb->on_cpu != -1) {
+    // still running: its cpu requeues it once it has been suspended
+    if (pcb->process_state == 'R') {
+      pcb_queue_remove(pcb);  // e.g. woken before it finished blocking
     }
+    return;
+  }
+
+  if (pcb->process_state == 'R') {
+    dequeue_runnable(pcb);  // never queued twice
+    pcb_queue_remove(pcb);  // e.g. from a wait queue
+    get_sched_policy()->enqueue(&cpus[pcb->cpu], pcb);
+    cpus[pcb->cpu].queued_by_priority[pcb->priority]++;
+    kick_idle_cpu(pcb->cpu);
   } else if (pcb->process_state == 'Z') {
-    vec_push_back(&zombie_queue, pcb);
-  } else if (pcb->process_state == 'B' || pcb->is_sleeping) {
-    vec_push_back(&sleep_blocked_queue, pcb);
+    sync_release_all(pcb);  // its mutexes go to their next waiters
+    if (pcb->parent != NULL) {  // init is never reaped
+      pcb_queue_push_back(&pcb->parent->zombies, pcb);
+      wake_waiting_parent(pcb);  // only now may the parent reap it
+    }
+  } else if (pcb->process_state == 'B' && pcb->is_sleeping) {
+    pcb_queue_remove(pcb);
+    sleep_queue_insert(pcb);
   }
+  // otherwise the pcb is blocked on a wait queue (or stopped) and stays put
 }
 
 /**
  * @brief Deletes the given PCB from the specified queue.
  */
-void delete_process_from_particular_queue(pcb_t* pcb, Vec* queue) {
-  for (int i = 0; i < vec_len(queue); i++) {
-    pcb_t* curr_pcb = vec_get(queue, i);
-    if (curr_pcb->pid == pcb->pid) {
-      vec_erase_no_deletor(queue, i);
-      return;
-    }
+void delete_process_from_particular_queue(pcb_t* pcb, pcb_queue_t* queue) {
+  if (pcb->queue == queue) {
+    pcb_queue_remove(pcb);
   }
 }
 
@@ -166,11 +525,9 @@ void delete_process_from_particular_queue(pcb_t* pcb, Vec* queue) {
  * @brief Deletes the given PCB from all queues except the current one.
  */
 void delete_process_from_all_queues_except_current(pcb_t* pcb) {
-  delete_process_from_particular_queue(pcb, &zero_priority_queue);
-  delete_process_from_particular_queue(pcb, &one_priority_queue);
-  delete_process_from_particular_queue(pcb, &two_priority_queue);
-  delete_process_from_particular_queue(pcb, &zombie_queue);
-  delete_process_from_particular_queue(pcb, &sleep_blocked_queue);
+  dequeue_runnable(pcb);
+  pcb_queue_remove(pcb);
+  sleep_queue_remove(pcb);
 }
 
 /**
@@ -178,7 +535,37 @@ void delete_process_from_all_queues_except_current(pcb_t* pcb) {
  */
 void delete_process_from_all_queues(pcb_t* pcb) {
   delete_process_from_all_queues_except_current(pcb);
-  delete_process_from_particular_queue(pcb, &current_pcbs);
+  remove_from_pending_signals(pcb);
+  pid_table_remove(pcb);
+
+  if (pcb->all_prev != NULL) {
+    pcb->all_prev->all_next = pcb->all_next;
+  } else {
+    current_pcbs = pcb->all_next;
+  }
+  if (pcb->all_next != NULL) {
+    pcb->all_next->all_prev = pcb->all_prev;
+  } else {
+    current_pcbs_tail = pcb->all_prev;
+  }
+  pcb->all_prev = NULL;
+  pcb->all_next = NULL;
+  num_current_pcbs--;
+}
+
+/**
+ * @brief Appends a new PCB to the list of current processes.
+ */
+void add_to_current_pcbs(pcb_t* pcb) {
+  pcb->all_prev = current_pcbs_tail;
+  pcb->all_next = NULL;
+  if (current_pcbs_tail != NULL) {
+    current_pcbs_tail->all_next = pcb;
+  } else {
+    current_pcbs = pcb;
+  }
+  current_pcbs_tail = pcb;
+  num_current_pcbs++;
 }
 
 /**
@@ -195,55 +582,27 @@ pcb_t* get_pcb_in_queue(Vec* queue, pid_t pid) {
   return NULL;
 }
 
-/**
- * @brief Checks if the given parent PCB has any children in the zombie queue.
- */
-bool child_in_zombie_queue(pcb_t* parent) {
-  for (int i = 0; i < vec_len(&zombie_queue); i++) {
-    pcb_t* child = vec_get(&zombie_queue, i);
-    if (child->par_pid == parent->pid) {
-      return true;
-    }
-  }
-  return false;
-}
-
-/**
- * @brief Checks if the given parent PCB has any children with a changed process
- * status.
- */
-bool child_with_changed_process_status(pcb_t* parent) {
-  for (int i = 0; i < vec_len(&current_pcbs); i++) {
-    pcb_t* child = vec_get(&current_pcbs, i);
-    if (child->par_pid == parent->pid && child->process_status != 0) {
-      return true;
-    }
-  }
-  return false;
-}
-
 /**
  * @brief Signal handler for SIGALRM.
  */
-void alarm_handler(int signum) {
-  tick_counter++;
-}
+void alarm_handler(int signum) {}
 
 /**
  * @brief Handles the specified signal for the given PCB.
  */
 void handle_signal(pcb_t* pcb, int signal) {
   switch (signal) {
-    case 0:  // P_SIGSTOP
+    case P_SIGSTOP:
       if (pcb->process_state == 'R' || pcb->process_state == 'B') {
         pcb->process_state = 'S';
         log_generic_event('s', pcb->pid, pcb->priority, pcb->cmd_str);
         delete_process_from_all_queues_except_current(pcb);
         pcb->process_status = 21;  // STOPPED_BY_SIG
+        wake_waiting_parent(pcb);
       }
-      pcb->signals[0] = false;
+      pcb->pending_signals &= ~P_SIGMASK(P_SIGSTOP);
       break;
-    case 1:                             // P_SIGCONT
+    case P_SIGCONT:
       if (pcb->process_state == 'S') {  // Only continue if stopped
         if (pcb->is_sleeping) {
           pcb->process_state = 'B';
@@ -256,143 +615,272 @@ void handle_signal(pcb_t* pcb, int signal) {
         }
         log_generic_event('c', pcb->pid, pcb->priority, pcb->cmd_str);
         pcb->process_status = 23;  // CONT_BY_SIG
+        wake_waiting_parent(pcb);
       }
-      pcb->signals[1] = false;
+      pcb->pending_signals &= ~P_SIGMASK(P_SIGCONT);
       break;
-    case 2:                             // P_SIGTERM
+    case P_SIGTERM:
       if (pcb->process_state != 'Z') {  // Don't terminate if already zombie
         pcb->process_state = 'Z';
         pcb->process_status = 22;  // TERM_BY_SIG
         log_generic_event('Z', pcb->pid, pcb->priority, pcb->cmd_str);
         delete_process_from_all_queues_except_current(pcb);
-        put_pcb_into_correct_queue(pcb);
-        pcb->process_status = 22;  // TERM_BY_SIG
+        put_pcb_into_correct_queue(pcb);  // wakes a waiting parent
       }
-      pcb->signals[2] = false;
+      pcb->pending_signals &= ~P_SIGMASK(P_SIGTERM);
       break;
   }
 }
 
 /**
- * @brief Shuts down the scheduler and cleans up resources.
+ * @brief Sets the length of a scheduling quantum.
  */
-void s_shutdown_pennos(void) {
-  scheduling_done = true;
+int set_scheduler_quantum(long usec) {
+  if (usec <= 0) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  quantum_usec = usec;
+  spthread_set_timeslice(usec);
+  return 0;
 }
 
 /**
- * @brief The main scheduler function for PennOS.
+ * @brief Gets the length of a scheduling quantum.
  */
-void scheduler() {
-  int curr_priority_queue_num;
-
-  // mask for while scheduler is waiting for alarm
-  sigset_t suspend_set;
-  sigfillset(&suspend_set);
-  sigdelset(&suspend_set, SIGALRM);
-
-  // ensure sigarlm doesn't terminate the process
-  struct sigaction act = (struct sigaction){
-      .sa_handler = alarm_handler,
-      .sa_mask = suspend_set,
-      .sa_flags = SA_RESTART,
-  };
-  sigaction(SIGALRM, &act, NULL);
+long get_scheduler_quantum() {
+  return quantum_usec;
+}
 
-  // make sure SIGALRM is unblocked
-  sigset_t alarm_set;
-  sigemptyset(&alarm_set);
-  sigaddset(&alarm_set, SIGALRM);
-  pthread_sigmask(SIG_UNBLOCK, &alarm_set, NULL);
+/**
+ * @brief Microseconds elapsed since the scheduler started.
+ */
+static long long usec_since_boot() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)(now.tv_sec - boot_time.tv_sec) * 1000000 +
+         (now.tv_nsec - boot_time.tv_nsec) / 1000;
+}
 
-  struct itimerval it;
-  it.it_interval = (struct timeval){.tv_usec = hundred_millisec};
-  it.it_value = it.it_interval;
-  setitimer(ITIMER_REAL, &it, NULL);
+/**
+ * @brief Brings tick_counter up to date with the monotonic clock.
+ */
+static void update_ticks() {
+  tick_counter = (int)(usec_since_boot() / quantum_usec);
+}
 
-  while (!scheduling_done) {
-    // handle signals for the currently running process
-    if (current_running_pcb != NULL) {
-      for (int i = 0; i < 3; i++) {
-        if (current_running_pcb->signals[i]) {
-          handle_signal(current_running_pcb, i);
-          // If process was terminated, don't continue scheduling it
-          if (current_running_pcb->process_state != 'R') {
-            current_running_pcb = NULL;
-            break;
-          }
-        }
+/**
+ * @brief Waits until the given time since boot or until the cpu is kicked.
+ */
+static void wait_for_kick(long long until_usec) {
+  sigset_t kick_set;
+  sigemptyset(&kick_set);
+  sigaddset(&kick_set, SIGALRM);
+
+  while (true) {
+    struct timespec timeout;
+    struct timespec* timeout_ptr = NULL;
+    if (until_usec >= 0) {
+      long long remaining = until_usec - usec_since_boot();
+      if (remaining <= 0) {
+        return;
       }
+      timeout.tv_sec = remaining / 1000000;
+      timeout.tv_nsec = (remaining % 1000000) * 1000;
+      timeout_ptr = &timeout;
     }
 
-    // handle signals for all other processes (currently running or not)
-    for (int i = 0; i < vec_len(&current_pcbs); i++) {
-      pcb_t* curr_pcb = vec_get(&current_pcbs, i);
-      for (int j = 0; j < 3; j++) {
-        if (curr_pcb->signals[j]) {
-          handle_signal(curr_pcb, j);
-        }
-      }
+    // EINTR means a host signal handler ran (e.g. the shell's SIGINT)
+    if (sigtimedwait(&kick_set, NULL, timeout_ptr) != -1 || errno != EINTR) {
+      return;
     }
+  }
+}
 
-    // Check sleep/blocked queue to move processes back to scheduable queues
-    for (int i = 0; i < vec_len(&sleep_blocked_queue); i++) {
-      pcb_t* blocked_proc = vec_get(&sleep_blocked_queue, i);
-      bool make_runnable = false;
-      if (blocked_proc->is_sleeping &&
-          blocked_proc->time_to_wake <= tick_counter) {
-        blocked_proc->is_sleeping = false;
-        blocked_proc->time_to_wake = -1;
-        blocked_proc->signals[2] = false;  // Unlikely, but reset signal
-        make_runnable = true;
-      } else if (blocked_proc->is_sleeping &&
-                 blocked_proc->signals[2]) {  // P_SIGTERM received
-        blocked_proc->is_sleeping = false;
-        blocked_proc->process_state = 'Z';
-        blocked_proc->process_status = 22;  // TERM_BY_SIG
-        blocked_proc->signals[2] = false;
-        delete_process_from_all_queues_except_current(blocked_proc);
-        put_pcb_into_correct_queue(blocked_proc);
-        log_generic_event('Z', blocked_proc->pid, blocked_proc->priority,
-                          blocked_proc->cmd_str);
-        i--;
-      } else if (child_in_zombie_queue(blocked_proc)) {
-        make_runnable = true;
-      } else if (child_with_changed_process_status(blocked_proc)) {
-        make_runnable = true;
-      }
+/**
+ * @brief Ends the running process's quantum and waits to be suspended.
+ */
+void yield_to_scheduler() {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (self == NULL || self->on_cpu == -1) {
+    kernel_unlock();
+    return;  // e.g. a shell signal handler that ran on a scheduler thread
+  }
 
-      if (make_runnable) {
-        blocked_proc->process_state = 'R';
-        vec_erase_no_deletor(&sleep_blocked_queue, i);
-        delete_process_from_all_queues_except_current(blocked_proc);
-        put_pcb_into_correct_queue(blocked_proc);
-        log_generic_event('U', blocked_proc->pid, blocked_proc->priority,
-                          blocked_proc->cmd_str);
-        i--;
-      }
-    }
+#ifndef SPTHREAD_GREEN
+  sigset_t wait_set;
+  sigfillset(&wait_set);
+  sigdelset(&wait_set, SIGPTHD);
+#endif
+
+  // the cpu clears yield_pending once it has suspended us, so there is no
+  // window where we could suspend ourselves after it already has. the flag
+  // is ours rather than the cpu's, since we may be stolen by another cpu and
+  // resumed there. the lock must be free meanwhile, since the cpu takes it to
+  // requeue us
+  self->yield_pending = true;
+  kick_cpu(self->on_cpu);
+  // SIGPTHD stays blocked until the lock is free, so until we take it again
+  // we can only be stopped where we hold no lock. if we are killed meanwhile,
+  // our thread can be given back to the pool once we are reaped
+  spthread_set_releasable_self(true);
+  int depth = kernel_unlock_all();
+  while (self->yield_pending || self->process_state == 'Z') {
+#ifdef SPTHREAD_GREEN
+    // switches straight back to the cpu, which has nothing to interrupt
+    spthread_suspend_self();
+#else
+    sigsuspend(&wait_set);  // a zombie waits here until it is reaped
+#endif
+  }
+  spthread_set_releasable_self(false);
+  kernel_relock(depth);
+  kernel_unlock();
+}
 
-    curr_priority_queue_num = generate_next_priority();
+/**
+ * @brief Shuts down the scheduler and cleans up resources.
+ */
+void s_shutdown_pennos(void) {
+  kernel_lock();
+  scheduling_done = true;
+  for (int i = 0; i < num_cpus; i++) {
+    kick_cpu(i);
+  }
+  kernel_unlock();
+}
 
-    current_running_pcb = get_next_pcb(curr_priority_queue_num);
-    if (current_running_pcb == NULL) {
-      sigsuspend(&suspend_set);  // idle until signal received
-      continue;
+/**
+ * @brief Runs the scheduling loop of one cpu.
+ */
+static void* cpu_loop(void* arg) {
+  cpu_t* cpu = (cpu_t*)arg;
+
+  sigset_t kick_set;
+  sigemptyset(&kick_set);
+  sigaddset(&kick_set, SIGALRM);
+  struct timespec no_wait = {0, 0};
+
+  while (!scheduling_done) {
+    kernel_lock();
+    long long pass_start = sched_stats_now_ns();
+    cpu->idle = false;
+    update_ticks();
+
+    // handle signals only for the processes that were actually signalled
+    drain_pending_signals();
+
+    // wake sleepers whose deadline has passed, earliest first
+    pcb_t* sleeper;
+    while ((sleeper = sleep_queue_pop_expired(tick_counter)) != NULL) {
+      sleeper->is_sleeping = false;
+      sleeper->time_to_wake = -1;
+      sleeper->process_state = 'R';
+      put_pcb_into_correct_queue(sleeper);
+      log_generic_event('U', sleeper->pid, sleeper->priority,
+                        sleeper->cmd_str);
     }
 
-    log_scheduling_event(current_running_pcb->pid, curr_priority_queue_num,
-                         current_running_pcb->cmd_str);
+    for (int priority = 0; priority < 3; priority++) {
+      sched_stats_record(STAT_QUEUE_DEPTH_0 + priority,
+                         cpu->queued_by_priority[priority]);
+    }
+    pcb_t* pcb = pick_runnable(cpu);
+    if (pcb == NULL) {
+      pcb = steal_pcb(cpu);
+    }
+    sched_stats_record(STAT_SCHED_PASS, sched_stats_now_ns() - pass_start);
+
+    if (pcb == NULL) {
+      // tickless idle: only wake for the next sleeper or a kick from a cpu
+      // that made a process runnable
+      int deadline = sleep_queue_next_deadline();
+      cpu->idle = true;
+      kernel_unlock();
+      wait_for_kick(deadline == -1 ? -1 : (long long)deadline * quantum_usec);
+      continue;
+    }
 
-    if (spthread_continue(current_running_pcb->thread_handle) != 0 &&
-        errno != EINTR) {
+    cpu->current = pcb;
+    pcb->on_cpu = cpu->id;
+    log_scheduling_event(pcb->pid, pcb->priority, pcb->cmd_str);
+    long long quantum_start = usec_since_boot();
+    long long quantum_end = quantum_start + quantum_usec;
+    // drop a stale kick, e.g. a yield that raced with the last timeout. kicks
+    // that concern this process can only be sent once we unlock
+    sigtimedwait(&kick_set, NULL, &no_wait);
+    kernel_unlock();
+
+    long long continue_start = sched_stats_now_ns();
+    if (spthread_continue(pcb->thread_handle) != 0 && errno != EINTR) {
       perror("spthread_continue failed in scheduler");
     }
-    sigsuspend(&suspend_set);
-    if (spthread_suspend(current_running_pcb->thread_handle) != 0 &&
-        errno != EINTR) {
+    wait_for_kick(quantum_end);
+    long long run_end = sched_stats_now_ns();
+    if (spthread_suspend(pcb->thread_handle) != 0 && errno != EINTR) {
       perror("spthread_suspend failed in scheduler");
     }
-    put_pcb_into_correct_queue(current_running_pcb);
+
+    kernel_lock();
+    // the thread stamps when it actually started running; an older stamp
+    // means it was suspended again before it got to run
+    long long run_start = spthread_resumed_ns(pcb->thread_handle);
+    if (run_start >= continue_start) {
+      sched_stats_record(STAT_DISPATCH_LATENCY, run_start - continue_start);
+    } else {
+      run_start = run_end;
+    }
+    sched_stats_record(STAT_QUANTUM_USED, run_end - run_start);
+    cpu->current = NULL;
+    pcb->on_cpu = -1;
+    pcb->yield_pending = false;
+    if (get_sched_policy()->ran != NULL) {
+      get_sched_policy()->ran(cpu, pcb, usec_since_boot() - quantum_start);
+    }
+    put_pcb_into_correct_queue(pcb);
+    kernel_unlock();
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief The main scheduler function for PennOS.
+ */
+void scheduler() {
+  // ensure a stray sigalrm doesn't terminate the process
+  struct sigaction act = (struct sigaction){
+      .sa_handler = alarm_handler,
+      .sa_flags = SA_RESTART,
+  };
+  sigfillset(&act.sa_mask);
+  sigaction(SIGALRM, &act, NULL);
+
+  // kicks are only taken through sigtimedwait, so they stay pending until the
+  // cpu waits. every cpu thread inherits this mask
+  sigset_t kick_set;
+  sigemptyset(&kick_set);
+  sigaddset(&kick_set, SIGALRM);
+  pthread_sigmask(SIG_BLOCK, &kick_set, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &boot_time);
+  spthread_set_timeslice(quantum_usec);
+
+  // the calling thread drives cpu 0
+  cpus[0].thread = pthread_self();
+  for (int i = 1; i < num_cpus; i++) {
+    if (pthread_create(&cpus[i].thread, NULL, cpu_loop, &cpus[i]) != 0) {
+      perror("pthread_create failed in scheduler");
+      num_cpus = i;
+      break;
+    }
+  }
+
+  cpu_loop(&cpus[0]);
+
+  for (int i = 1; i < num_cpus; i++) {
+    pthread_join(cpus[i].thread, NULL);
   }
+  pthread_sigmask(SIG_UNBLOCK, &kick_set, NULL);
 }
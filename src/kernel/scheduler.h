@@ -7,11 +7,42 @@
 #ifndef SCHEDULER_H_
 #define SCHEDULER_H_
 
+#include <pthread.h>
 #include <stdbool.h>
 #include "../lib/Vec.h"
 #include "../lib/spthread.h"
 #include "kern_pcb.h"
 
+#define MAX_CPUS 16
+
+/**
+ * @brief A virtual cpu. Each cpu has its own scheduler thread, which runs one
+ *        process at a time from the cpu's own run queues, and steals from
+ *        the busiest other cpu when those are empty.
+ */
+typedef struct cpu_st {
+  int id;                      // index in cpus
+  pthread_t thread;            // scheduler thread driving this cpu
+  pcb_t* current;              // pcb running on this cpu, NULL if none
+  bool idle;                   // true while waiting with nothing to run
+  int queued_by_priority[3];   // runnable pcbs queued per level, for stats
+
+  // run queue state, owned by the scheduling policy (see sched_policy.h)
+  pcb_queue_t run_queues[3];       // priority: one per level, lottery: [0]
+  int priority_arr_index;          // priority: index in det_priorities_arr
+  Vec vtime_heap;                  // stride, cfs: min-heap keyed on vtime
+  unsigned long long min_vtime;    // stride, cfs: vtime of the last pick
+  long total_tickets;              // lottery: tickets of the queued pcbs
+  unsigned int lottery_seed;       // lottery: rand_r state
+} cpu_t;
+
+/**
+ * @brief The pcb of the process running on the calling thread, or NULL if
+ *        the caller isn't a process (e.g. a cpu's scheduler thread). Each
+ *        cpu runs its own process, so this is per-thread, like errno.
+ */
+#define current_running_pcb (get_current_running_pcb())
+
 /////////////////////////////////////////////////////////////////////////////////
 //                         QUEUE MAINTENANCE FUNCTIONS //
 /////////////////////////////////////////////////////////////////////////////////
@@ -28,115 +59,241 @@ void initialize_scheduler_queues();
  */
 void free_scheduler_queues();
 
+/**
+ * @brief Sets the number of virtual cpus. Must be called before scheduler()
+ *        starts, e.g. from the --cpus boot option.
+ *
+ * @param n number of cpus, in [1, MAX_CPUS]. Only 1 with the green spthread
+ *          backend, which runs every process on the scheduler's own thread
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL otherwise
+ */
+int set_num_cpus(int n);
+
+/**
+ * @brief Returns the pcb of the process running on the calling thread. Use
+ *        the current_running_pcb macro instead of calling this directly.
+ *
+ * @return ptr to the calling process's pcb, or NULL if the calling thread
+ *         isn't a process thread
+ */
+pcb_t* get_current_running_pcb();
+
 /////////////////////////////////////////////////////////////////////////////////
-//                          SCHEDULING FUNCTIONS //
+//                          SLEEP QUEUE FUNCTIONS //
 /////////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief Deterministically chooses an integer from 0, 1, 2 at the prescribed
- *        probabilites. In particular, 0 is output 1.5x more than
- *        1, which is output 1.5x more than 2. Notably, it accounts
- *        for cases where some of the queues are empty. If all queues are empty,
- *        it'll return -1.
+ * @brief Inserts a sleeping pcb into the sleep queue, a binary min-heap
+ *        keyed on time_to_wake. O(log n). If the pcb is already in the
+ *        heap, this function does nothing.
  *
- * @pre assumes that at least one of the scheduler queues in non-empty
- * @return int 0, 1, or 2 for priority or -1 to signify that all queues
- *         are empty
+ * @param pcb a pointer to the sleeping pcb
  */
-int generate_next_priority();
+void sleep_queue_insert(pcb_t* pcb);
 
 /**
- * @brief Returns the next PCB in the queue of the specified priority.
- *        or NULL if that queue is empty. Notably, it removes the PCB
- *        from the queue.
+ * @brief Removes the given pcb from the sleep queue (e.g. because it was
+ *        stopped or terminated before its deadline). O(log n). If the pcb
+ *        is not in the heap, this function does nothing.
  *
- * @param priority queue priority to get next PCB from, or -1 if none
- * @return         a ptr to the next pcb struct in queue or NULL
- *                 if the queue is empty
+ * @param pcb a pointer to the pcb to remove
  */
-pcb_t* get_next_pcb(int priority);
+void sleep_queue_remove(pcb_t* pcb);
 
 /**
- * @brief Puts the given pcb struct pointer into its appropriate
- *        queue. Notably, it solely uses the pcb's interal fields
- *        to determine the correct queue (priority and state).
+ * @brief Pops the sleeper with the earliest deadline if that deadline has
+ *        passed.
+ *
+ * @param now the current tick
+ * @return a ptr to a pcb whose time_to_wake <= now, or NULL if no sleeper
+ *         has expired yet
  */
-void put_pcb_into_correct_queue(pcb_t* pcb);
+pcb_t* sleep_queue_pop_expired(int now);
 
 /**
- * @brief Given a queue in the form of a vector, searches through
- *        it for the given pcb and deletes it from the queue if
- *        found. Notably, it does not free the pcb. Instead, the
- *        implmentation calls vec_erase_no_deletor instead of
- *        vec_erase. If the pcb isn't in the queue, this function
- *        does nothing.
+ * @brief Returns the deadline of the earliest sleeper without removing it.
+ *        Used by the scheduler to decide how long it may idle.
+ *
+ * @return the smallest time_to_wake in the sleep queue, or -1 if it is empty
  */
-void delete_process_from_particular_queue(pcb_t* pcb, Vec* queue);
+int sleep_queue_next_deadline();
+
+/////////////////////////////////////////////////////////////////////////////////
+//                          WAIT QUEUE FUNCTIONS //
+/////////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief Searches through all of the scheduler's queues except the one
- *        containing all of the current processes and deletes the given
- *        pcb from all of them Notably, it does not free the pcb via
- *        calling vec_erase_no_deletor instead of vec_erase. If
- *        a particular queue does not contain the pcb, nothing occurs.
+ * @brief Blocks the currently running process on the given wait queue and
+ *        suspends it until another process wakes it. The process takes no
+ *        CPU while it is blocked. Callers should re-check the condition they
+ *        were waiting for after this returns, since the process may also be
+ *        resumed by P_SIGCONT.
  *
- * @param pcb a pointer to the pcb with the pid to delete
+ * @param wait_queue the queue to park the current process on
  */
-void delete_process_from_all_queues_except_current(pcb_t* pcb);
+void block_on_wait_queue(pcb_queue_t* wait_queue);
 
 /**
- * @brief Searches through all of the scheduler's queues and deletes the
- *        the given pcb from all of them. Notably, it does not free the
- *        pcb via calling vec_erase_no_deletor instead of vec_erase. If
- *        a particular queue does not contain the pcb, nothing occurs.
+ * @brief Moves a process blocked on a wait queue back into its run queue.
+ *        Does nothing if the process isn't blocked on a wait queue.
  *
- * @param pcb a pointer to the pcb with the pid to delete
+ * @param pcb the pcb of the blocked process
  */
-void delete_process_from_all_queues(pcb_t* pcb);
+void wake_process(pcb_t* pcb);
 
 /**
- * @brief Given a queue, searches for a particular pid inside that queue
- *        and, if found, returns the pcb_t* associated with that pid.
+ * @brief Wakes every process blocked on the given wait queue.
  *
- * @param queue the queue of pcb_t* ptrs to search
- * @param pid   the pid to search for
- * @return a ptr to the pcb w/ the desired pid if found, NULL otherwise
+ * @param wait_queue the queue whose waiters should be made runnable
  */
-pcb_t* get_pcb_in_queue(Vec* queue, pid_t pid);
+void wake_all(pcb_queue_t* wait_queue);
 
 /**
- * @brief Checks if a child of the given parent process is in the zombie queue.
+ * @brief Called whenever a child changes state (exits, is terminated,
+ *        stopped, or continued). If its parent is blocked in s_waitpid on
+ *        this child (or on any child), the parent is woken. O(1).
  *
- * This function iterates through the zombie queue to determine if any process
- * in the queue has the given parent process as its parent.
+ * @param child the pcb of the child whose state changed
+ */
+void wake_waiting_parent(pcb_t* child);
+
+/////////////////////////////////////////////////////////////////////////////////
+//                        PENDING SIGNAL FUNCTIONS //
+/////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Marks the signal as pending for the given pcb and, if this is the
+ *        pcb's first pending signal, appends it to the kernel's list of
+ *        pcbs with pending signals. The scheduler only drains pcbs on that
+ *        list, so a tick where nobody was signalled costs nothing.
  *
- * @param parent A pointer to the parent PCB.
+ * @param pcb    the pcb being signalled
+ * @param signal the signal number, assumed in [0, P_NSIG)
+ */
+void add_pending_signal(pcb_t* pcb, int signal);
+
+/**
+ * @brief Removes the given pcb from the list of pcbs with pending signals
+ *        and drops its pending signals. Must be called before a pcb with
+ *        pending signals is freed. The list is linked through the pcbs, so
+ *        this is O(1).
  *
- * @return true if a child of the parent is in the zombie queue, false
- * otherwise.
+ * @param pcb the pcb to remove
  */
-bool child_in_zombie_queue(pcb_t* parent);
+void remove_from_pending_signals(pcb_t* pcb);
 
 /**
- * @brief Checks if a child of the given parent process has a changed process
- * status.
+ * @brief Handles every pending signal of every pcb on the pending list and
+ *        removes them from the list. A pcb that is running on a cpu stays
+ *        on the list, since its state may only change once it is suspended.
+ */
+void drain_pending_signals();
+
+/////////////////////////////////////////////////////////////////////////////////
+//                          SCHEDULING FUNCTIONS //
+/////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Work stealing: takes the pcb that the other cpu with the most queued
+ *        pcbs would run next, and makes the thief its home cpu.
  *
- * This function iterates through the current PCBs to determine if any child
- * of the given parent process has a non-zero process status, indicating a
- * change.
+ * @param thief the cpu that ran out of work
+ * @return a ptr to the stolen pcb, or NULL if no other cpu has queued work
+ */
+pcb_t* steal_pcb(cpu_t* thief);
+
+/**
+ * @brief Kicks a cpu: ends the quantum of the process running on it, or wakes
+ *        it up if it is idle.
  *
- * @param parent A pointer to the parent PCB.
+ * @param cpu the cpu id
+ */
+void kick_cpu(int cpu);
+
+/**
+ * @brief Kicks an idle cpu, preferring the given home cpu, so that newly
+ *        runnable work or a pending signal is picked up without waiting for
+ *        a busy cpu's quantum to end. Does nothing if no cpu is idle.
+ *
+ * @param home the cpu to kick if it is idle
+ */
+void kick_idle_cpu(int home);
+
+/**
+ * @brief Puts the given pcb struct pointer into its appropriate
+ *        queue. Notably, it solely uses the pcb's interal fields
+ *        to determine the correct queue (state and home cpu). Runnable
+ *        pcbs are handed to the scheduling policy. If
+ *        the pcb is already on a queue, it is moved rather than duplicated.
+ *        A runnable pcb wakes an idle cpu, and a zombie goes on its
+ *        parent's zombie queue and wakes the parent if it is waiting.
+ *        A pcb that is still running is left to its cpu, which calls this
+ *        again once it has suspended the pcb.
+ */
+void put_pcb_into_correct_queue(pcb_t* pcb);
+
+/**
+ * @brief Unlinks a runnable pcb from its home cpu's run queue, whatever the
+ *        scheduling policy. Does nothing if the pcb isn't queued there.
  *
- * @return true if a child of the parent has a changed process status, false
- * otherwise.
+ * @param pcb a pointer to the pcb to unlink
+ * @return true if the pcb was queued, false otherwise
+ */
+bool dequeue_runnable(pcb_t* pcb);
+
+/**
+ * @brief Deletes the given pcb from the given scheduler queue if it is
+ *        currently on that queue. Notably, it does not free the pcb. If
+ *        the pcb isn't in the queue, this function does nothing. O(1).
  */
-bool child_with_changed_process_status(pcb_t* parent);
+void delete_process_from_particular_queue(pcb_t* pcb, pcb_queue_t* queue);
+
+/**
+ * @brief Unlinks the given pcb from whichever scheduler queue it is on
+ *        (run queues, zombie queues, blocked queue, sleep queue), leaving it
+ *        in the list of current processes. Notably, it does not free the
+ *        pcb. Since a pcb is on at most one queue, this is O(1) for the
+ *        linked queues and O(log n) for the sleep queue.
+ *
+ * @param pcb a pointer to the pcb to delete
+ */
+void delete_process_from_all_queues_except_current(pcb_t* pcb);
+
+/**
+ * @brief Unlinks the given pcb from its scheduler queue and removes it
+ *        from the list of current processes and the pid table, all in O(1)
+ *        (expected, for the pid table). Notably, it does not free the pcb.
+ *
+ * @param pcb a pointer to the pcb to delete
+ */
+void delete_process_from_all_queues(pcb_t* pcb);
+
+/**
+ * @brief Appends a new pcb to the list of current processes (current_pcbs),
+ *        which owns it from then on. The list is intrusive, linked through
+ *        the pcbs' all_prev/all_next, so ps lists processes oldest first.
+ *
+ * @param pcb a pointer to the new pcb
+ */
+void add_to_current_pcbs(pcb_t* pcb);
+
+/**
+ * @brief Given a queue, searches for a particular pid inside that queue
+ *        and, if found, returns the pcb_t* associated with that pid.
+ *
+ * @param queue the queue of pcb_t* ptrs to search
+ * @param pid   the pid to search for
+ * @return a ptr to the pcb w/ the desired pid if found, NULL otherwise
+ */
+pcb_t* get_pcb_in_queue(Vec* queue, pid_t pid);
 
 /**
  * @brief Handles the alarm signal.
  *
- * This function is triggered when the alarm signal is received. It increments
- * the global tick counter, which is used for scheduling and timing purposes.
+ * SIGALRM is used to kick a cpu's scheduler thread, e.g. when a process
+ * yields or becomes runnable. The cpu threads keep it blocked and take it
+ * with sigtimedwait, so the handler only keeps a stray SIGALRM from
+ * terminating PennOS.
  *
  * @param signum The signal number (unused in this implementation).
  */
@@ -151,12 +308,43 @@ void alarm_handler(int signum);
  * - P_SIGCONT: Continues a stopped process.
  * - P_SIGTERM: Terminates the process.
  *
+ * The signal's bit is cleared from the pcb's pending_signals mask.
+ *
  * @param pcb    A pointer to the PCB of the process receiving the signal.
  * @param signal The signal to handle (0 for P_SIGSTOP, 1 for P_SIGCONT, 2 for
  * P_SIGTERM).
  */
 void handle_signal(pcb_t* pcb, int signal);
 
+/**
+ * @brief Ends the running process's quantum early. The process's cpu is
+ *        notified immediately instead of at the end of the quantum, suspends
+ *        the process and picks the next one. Returns once the process is
+ *        scheduled again. The kernel lock is released while waiting.
+ *
+ * The process is requeued according to its state, so a process that is still
+ * runnable goes to the back of its priority queue, while a blocked, stopped or
+ * exited process is only resumed once it is made runnable again (if ever).
+ * Calling this from a thread that isn't a process does nothing.
+ */
+void yield_to_scheduler();
+
+/**
+ * @brief Sets the length of one scheduling quantum (one tick). Must be called
+ *        before scheduler() starts, e.g. from the --quantum-us boot option.
+ *
+ * @param usec quantum length in microseconds, must be positive
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL otherwise
+ */
+int set_scheduler_quantum(long usec);
+
+/**
+ * @brief Gets the length of one scheduling quantum (one tick).
+ *
+ * @return quantum length in microseconds
+ */
+long get_scheduler_quantum();
+
 /**
  * @brief The main scheduler function for PennOS.
  *
@@ -164,14 +352,26 @@ void handle_signal(pcb_t* pcb, int signal);
  * preemption. It ensures that processes are executed based on their priority
  * and handles signals for both the currently running process and other
  * processes.
+ *
+ * It starts one scheduler thread per cpu (the calling thread drives cpu 0)
+ * and returns once all of them have stopped. Each cpu runs the processes on
+ * its own run queues, in the order chosen by the scheduling policy selected
+ * at boot, and steals from the busiest cpu when it has none.
+ * Kernel data shared between cpus is protected by the kernel lock.
+ *
+ * The scheduler is tickless: tick_counter is derived from the monotonic clock
+ * and a cpu only waits for the end of the running process's quantum, which
+ * also ends early if the process calls yield_to_scheduler(). If nothing is
+ * runnable, a cpu waits for the earliest sleeper deadline (or indefinitely)
+ * until another cpu kicks it with new work.
  */
 void scheduler();
 
 /**
  * @brief Shuts down the PennOS scheduler.
  *
- * This function sets the scheduling_done flag to true, signaling the scheduler
- * to terminate its loop and shut down.
+ * This function sets the scheduling_done flag to true and kicks every cpu,
+ * signaling the scheduler threads to terminate their loops and shut down.
  */
 void s_shutdown_pennos();
 
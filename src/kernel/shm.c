@@ -0,0 +1,204 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements reference-counted shared memory segments.
+ */
+
+#include "shm.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/pennos-errno.h"
+#include "kern_lock.h"
+#include "scheduler.h"
+
+static shm_segment_t* segments = NULL;  // every segment, newest first
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Finds the segment with the given name.
+ */
+static shm_segment_t* find_segment(const char* name) {
+  for (shm_segment_t* seg = segments; seg != NULL; seg = seg->next) {
+    if (strcmp(seg->name, name) == 0) {
+      return seg;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Unlinks a segment from the kernel's list and frees it.
+ */
+static void free_segment(shm_segment_t* segment) {
+  shm_segment_t** link = &segments;
+  while (*link != segment) {
+    link = &(*link)->next;
+  }
+  *link = segment->next;
+
+  free(segment->addr);
+  free(segment);
+}
+
+/**
+ * @brief Records an attachment of the process to the segment.
+ *
+ * @return 0 on success, -1 with P_ERRNO set to P_EMALLOC otherwise
+ */
+static int attach(pcb_t* pcb, shm_segment_t* segment) {
+  shm_attachment_t* attachment = malloc(sizeof(shm_attachment_t));
+  if (attachment == NULL) {
+    P_ERRNO = P_EMALLOC;
+    return -1;
+  }
+  attachment->segment = segment;
+  attachment->next = pcb->shm_attachments;
+  pcb->shm_attachments = attachment;
+  segment->attached++;
+  return 0;
+}
+
+/**
+ * @brief Drops one attachment to its segment, freeing the segment if it was
+ *        the last one. The attachment must already be off its list.
+ */
+static void detach(shm_attachment_t* attachment) {
+  shm_segment_t* segment = attachment->segment;
+  free(attachment);
+  if (--segment->attached == 0) {
+    free_segment(segment);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                        SHARED MEMORY SYSTEM CALLS                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Creates a zero-filled segment and attaches the caller to it.
+ */
+void* s_shm_create(const char* name, size_t size) {
+  if (name == NULL || name[0] == '\0' || strlen(name) > SHM_NAME_MAX ||
+      size == 0) {
+    P_ERRNO = P_EINVAL;
+    return NULL;
+  }
+
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return NULL;
+  }
+  if (find_segment(name) != NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EEXIST;
+    return NULL;
+  }
+
+  shm_segment_t* segment = malloc(sizeof(shm_segment_t));
+  void* addr = calloc(1, size);
+  if (segment == NULL || addr == NULL) {
+    free(segment);
+    free(addr);
+    kernel_unlock();
+    P_ERRNO = P_EMALLOC;
+    return NULL;
+  }
+  strcpy(segment->name, name);
+  segment->addr = addr;
+  segment->size = size;
+  segment->attached = 0;
+  segment->next = segments;
+  segments = segment;
+
+  if (attach(self, segment) == -1) {
+    free_segment(segment);
+    kernel_unlock();
+    return NULL;
+  }
+  kernel_unlock();
+  return addr;
+}
+
+/**
+ * @brief Attaches the caller to the segment with the given name.
+ */
+void* s_shm_attach(const char* name, size_t* size) {
+  if (name == NULL) {
+    P_ERRNO = P_EINVAL;
+    return NULL;
+  }
+
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return NULL;
+  }
+  shm_segment_t* segment = find_segment(name);
+  if (segment == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_ENOENT;
+    return NULL;
+  }
+  if (attach(self, segment) == -1) {
+    kernel_unlock();
+    return NULL;
+  }
+
+  if (size != NULL) {
+    *size = segment->size;
+  }
+  void* addr = segment->addr;
+  kernel_unlock();
+  return addr;
+}
+
+/**
+ * @brief Drops one of the caller's attachments to the segment at addr.
+ */
+int s_shm_detach(void* addr) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (addr == NULL || self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  shm_attachment_t** link = &self->shm_attachments;
+  while (*link != NULL && (*link)->segment->addr != addr) {
+    link = &(*link)->next;
+  }
+  if (*link == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  shm_attachment_t* attachment = *link;
+  *link = attachment->next;
+  detach(attachment);
+  kernel_unlock();
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                       KERNEL SHARED MEMORY FUNCTIONS                       //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Drops every attachment of a reaped process.
+ */
+void shm_detach_all(pcb_t* pcb) {
+  while (pcb->shm_attachments != NULL) {
+    shm_attachment_t* attachment = pcb->shm_attachments;
+    pcb->shm_attachments = attachment->next;
+    detach(attachment);
+  }
+}
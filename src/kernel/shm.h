@@ -0,0 +1,90 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines shared memory segments: named, zero-filled buffers that
+ *          PennOS processes attach to by name, so they can exchange data
+ *          without going through PennFAT. A segment is freed once the last
+ *          process attached to it detaches or is reaped.
+ */
+
+#ifndef SHM_H_
+#define SHM_H_
+
+#include <stddef.h>
+#include "kern_pcb.h"
+
+#define SHM_NAME_MAX 32  // longest segment name, without the '\0'
+
+/**
+ * @brief A shared memory segment. All processes share the host's address
+ *        space, so attaching just hands out the segment's address and counts
+ *        the attachment. Every access is made with the kernel lock held.
+ */
+typedef struct shm_segment_st {
+  char name[SHM_NAME_MAX + 1];
+  void* addr;   // the segment's memory
+  size_t size;  // bytes at addr
+  int attached;                 // attachments by all processes
+  struct shm_segment_st* next;  // next segment in the kernel's list
+} shm_segment_t;
+
+/**
+ * @brief One attachment of a process to a segment, kept on a list in the
+ *        process's pcb. A process attaching twice has two of them.
+ */
+typedef struct shm_attachment_st {
+  shm_segment_t* segment;
+  struct shm_attachment_st* next;  // next attachment of the same process
+} shm_attachment_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                        SHARED MEMORY SYSTEM CALLS                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Creates a zero-filled segment and attaches the calling process to
+ *        it.
+ *
+ * @param name the segment's name, 1 to SHM_NAME_MAX characters
+ * @param size the segment's size in bytes, must be positive
+ * @return the segment's address, or NULL with P_ERRNO set to P_EINVAL for a
+ *         bad name or size or if the caller isn't a process, P_EEXIST if a
+ *         segment already has the name, or P_EMALLOC
+ */
+void* s_shm_create(const char* name, size_t size);
+
+/**
+ * @brief Attaches the calling process to an existing segment.
+ *
+ * @param name the segment's name
+ * @param size if not NULL, set to the segment's size
+ * @return the segment's address, or NULL with P_ERRNO set to P_EINVAL if name
+ *         is NULL or the caller isn't a process, P_ENOENT if no segment has
+ *         the name, or P_EMALLOC
+ */
+void* s_shm_attach(const char* name, size_t* size);
+
+/**
+ * @brief Drops one of the calling process's attachments to the segment at
+ *        addr. The segment is freed, and its name can be used again, once
+ *        no process is attached to it.
+ *
+ * @param addr an address returned by s_shm_create or s_shm_attach
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if the caller isn't
+ *         attached to a segment at addr
+ */
+int s_shm_detach(void* addr);
+
+////////////////////////////////////////////////////////////////////////////////
+//                       KERNEL SHARED MEMORY FUNCTIONS                       //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Drops every attachment of a process, freeing the segments nobody
+ *        else is attached to. Called by k_proc_cleanup when the process is
+ *        reaped. Called with the kernel lock held.
+ *
+ * @param pcb the process
+ */
+void shm_detach_all(pcb_t* pcb);
+
+#endif  // SHM_H_
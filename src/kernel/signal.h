@@ -8,6 +8,13 @@
 #define P_SIGCONT 1
 #define P_SIGTERM 2
 
+/**
+ * @brief Number of PennOS signals. Signal numbers are [0, P_NSIG) and each
+ *        one owns a bit in a pcb's pending_signals mask.
+ */
+#define P_NSIG 3
+#define P_SIGMASK(sig) (1u << (sig))
+
 /**
  * @brief Status definitions.
  */
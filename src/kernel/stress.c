@@ -27,8 +27,15 @@
  // #include "syscalls.h"
  #include "../kernel/kern_sys_calls.h"
  #include "../lib/pennos-errno.h"
+ #include "../kernel/signal.h"
  #include "../fs/fs_syscalls.h"
  #include "../fs/fat_routines.h"
+ #include "../shell/builtins.h"
+ #include "../kernel/msg.h"
+ #include "../kernel/sched_stats.h"
+ #include "../kernel/scheduler.h"
+ #include "../kernel/shm.h"
+ #include "../kernel/sync.h"
  
  
  // You can tweak the function signature to make it work.
@@ -145,6 +152,499 @@
    return NULL;
  }
  
+ #define SWARM_DEFAULT 10000          // processes swarm spawns by default
+ #define SWARM_STACK_SIZE (32 * 1024)  // a swarm napper barely uses its stack
+ #define SWARM_NAP_TICKS 100000        // outlasts any swarm; they get killed
+
+ static void* swarm_nap(void* arg) {
+   s_sleep(SWARM_NAP_TICKS);
+   s_exit();
+   return NULL;
+ }
+
+
+ /*
+  * The function below spawns n nappers (10000 by default) on small stacks
+  * with s_spawn_attr, so that all of them are alive at once, then kills and
+  * reaps them.
+  */
+
+ static void swarm_main(int n) {
+   char name[] = "swarmling";
+   char *argv[] = { name, NULL };
+   const spawn_attr_t attr = { .stack_size = SWARM_STACK_SIZE };
+   char msg[80];
+
+   pid_t* pids = malloc(n * sizeof(pid_t));
+   if (pids == NULL) {
+     return;
+   }
+
+   int spawned = 0;
+   while (spawned < n) {
+     const pid_t pid = s_spawn_attr(swarm_nap, argv, 0, 1, &attr);
+     if (pid < 0) {
+       break;
+     }
+     pids[spawned++] = pid;
+   }
+   snprintf(msg, sizeof msg, "swarm: %d of %d processes alive\n", spawned, n);
+   s_write(STDERR_FILENO, msg, strlen(msg));
+
+   for (int i = 0; i < spawned; i++) {
+     s_kill(pids[i], P_SIGTERM);
+   }
+
+   int reaped = 0;
+   while (s_waitpid(-1, NULL, false) > 0) {
+     reaped++;
+   }
+   snprintf(msg, sizeof msg, "swarm: %d reaped\n", reaped);
+   s_write(STDERR_FILENO, msg, strlen(msg));
+
+   free(pids);
+ }
+
+ #define LOCKBENCH_DEFAULT 10000  // handoffs lockbench measures by default
+
+ static p_mutex_t lockbench_running;  // zeroed, so unlocked from the start
+
+ static struct {
+   p_mutex_t mutex;          // the mutex passed back and forth
+   int remaining;            // handoffs still to measure
+   long long released_ns;    // when the last holder unlocked, -1 if measured
+   int released_tick;        // the tick it unlocked in
+   histogram_t latency_ns;   // unlock to the waiter owning it, in ns
+   histogram_t latency_ticks;  // and in ticks
+ } lockbench_state;
+
+
+ /*
+  * Tells whether the other process of the benchmark is gone. Main passes its
+  * peer's pid and reaps the peer if it was killed. The peer passes 0: main
+  * holds lockbench_running until it is done, and a killed process gives up its
+  * mutexes as soon as it is a zombie, so once the peer can take it main is
+  * gone. The peer then keeps it until it exits, so no new run starts under it.
+  */
+
+ static bool lockbench_other_gone(pid_t peer) {
+   if (peer > 0) {
+     return s_waitpid(peer, NULL, true) == peer;
+   }
+   return s_mutex_trylock(&lockbench_running) == 0;
+ }
+
+ /*
+  * Both processes run this loop, holding the mutex when they enter it. Each
+  * one only unlocks once the other is blocked on the mutex, so every unlock
+  * hands the mutex over and the new owner measures how long that took.
+  * Returns true if it stopped because the other process is gone.
+  */
+
+ static bool lockbench_loop(pid_t peer) {
+   p_mutex_t* mutex = &lockbench_state.mutex;
+   while (true) {
+     if (lockbench_state.remaining <= 0) {
+       s_mutex_unlock(mutex);  // lets the other one see that we're done
+       return false;
+     }
+
+     while (s_mutex_has_waiters(mutex) == 0) {
+       if (lockbench_other_gone(peer)) {
+         s_mutex_unlock(mutex);
+         return true;
+       }
+       s_yield();
+     }
+     lockbench_state.released_tick = s_get_ticks();
+     lockbench_state.released_ns = sched_stats_now_ns();
+     s_mutex_unlock(mutex);
+
+     s_mutex_lock(mutex);
+     if (lockbench_state.released_ns != -1) {
+       hist_record(&lockbench_state.latency_ns,
+                   sched_stats_now_ns() - lockbench_state.released_ns);
+       hist_record(&lockbench_state.latency_ticks,
+                   s_get_ticks() - lockbench_state.released_tick);
+       lockbench_state.released_ns = -1;
+       lockbench_state.remaining--;
+     }
+   }
+ }
+
+ static void* lockbench_peer(void* arg) {
+   s_mutex_lock(&lockbench_state.mutex);
+   if (lockbench_loop(0)) {
+     s_mutex_unlock(&lockbench_running);
+   }
+   s_exit();
+   return NULL;
+ }
+
+ static void bench_report(const char* bench, const char* unit,
+                          const histogram_t* hist) {
+   char msg[160];
+   snprintf(msg, sizeof msg,
+            "%s: %-5s p50 %lld  p99 %lld  max %lld  mean %.2f\n", bench, unit,
+            hist_percentile(hist, 50.0), hist_percentile(hist, 99.0),
+            hist->max, hist->count > 0 ? (double)hist->sum / hist->count : 0.0);
+   s_write(STDERR_FILENO, msg, strlen(msg));
+ }
+
+ static void lockbench_main(int rounds) {
+   char name[] = "lockbench-peer";
+   char *argv[] = { name, NULL };
+   char msg[80];
+
+   if (s_mutex_trylock(&lockbench_running) == -1) {
+     const char* busy = "lockbench: already running\n";
+     s_write(STDERR_FILENO, busy, strlen(busy));
+     return;
+   }
+
+   memset(&lockbench_state, 0, sizeof lockbench_state);
+   s_mutex_init(&lockbench_state.mutex);
+   lockbench_state.remaining = rounds;
+   lockbench_state.released_ns = -1;
+
+   // we hold the mutex first, so the peer starts out blocked on it
+   s_mutex_lock(&lockbench_state.mutex);
+   const pid_t pid = s_spawn(lockbench_peer, argv, 0, 1);
+   if (pid < 0) {
+     s_mutex_unlock(&lockbench_state.mutex);
+   } else if (lockbench_loop(pid)) {
+     const char* gone = "lockbench: peer exited early\n";
+     s_write(STDERR_FILENO, gone, strlen(gone));
+   } else {
+     s_waitpid(pid, NULL, false);
+
+     snprintf(msg, sizeof msg, "lockbench: %lld handoffs\n",
+              lockbench_state.latency_ns.count);
+     s_write(STDERR_FILENO, msg, strlen(msg));
+     bench_report("lockbench", "ns", &lockbench_state.latency_ns);
+     bench_report("lockbench", "ticks", &lockbench_state.latency_ticks);
+   }
+
+   s_mutex_destroy(&lockbench_state.mutex);
+   s_mutex_unlock(&lockbench_running);
+ }
+
+
+ #define SHMTEST_DEFAULT 1000   // values shmtest passes by default
+ #define SHMTEST_NAME "shmtest"
+
+ /*
+  * The layout of shmtest's segment. The producer hands the consumer one value
+  * at a time through value, guarded by the two semaphores.
+  */
+
+ typedef struct {
+   p_sem_t attached;  // posted by each child once it is attached
+   p_sem_t items;     // 1 while value holds a value the consumer hasn't taken
+   p_sem_t space;     // 1 while value may be overwritten
+   int rounds;        // values to pass
+   int value;
+   long long sum;     // of the values the consumer took
+ } shmtest_seg_t;
+
+ static shmtest_seg_t* shmtest_attach(void) {
+   size_t size;
+   shmtest_seg_t* seg = s_shm_attach(SHMTEST_NAME, &size);
+   if (seg == NULL || size != sizeof *seg) {
+     u_perror("shmtest: s_shm_attach");
+     return NULL;
+   }
+   s_sem_post(&seg->attached);
+   return seg;
+ }
+
+ // Neither child detaches: reaping it drops its attachment.
+ static void* shmtest_producer(void* arg) {
+   shmtest_seg_t* seg = shmtest_attach();
+   for (int i = 1; seg != NULL && i <= seg->rounds; i++) {
+     s_sem_wait(&seg->space);
+     seg->value = i;
+     s_sem_post(&seg->items);
+   }
+   s_exit();
+   return NULL;
+ }
+
+ static void* shmtest_consumer(void* arg) {
+   shmtest_seg_t* seg = shmtest_attach();
+   for (int i = 1; seg != NULL && i <= seg->rounds; i++) {
+     s_sem_wait(&seg->items);
+     seg->sum += seg->value;
+     s_sem_post(&seg->space);
+   }
+   s_exit();
+   return NULL;
+ }
+
+ static void shmtest_report(const char* what, bool ok) {
+   char msg[96];
+   snprintf(msg, sizeof msg, "shmtest: %s: %s\n", what, ok ? "ok" : "FAILED");
+   s_write(STDERR_FILENO, msg, strlen(msg));
+ }
+
+ /*
+  * Creates a segment, lets a producer and a consumer attach to it, and drops
+  * our own attachment, so the segment then lives on the children alone.
+  * Checks that it outlives the producer, and that its name is free again once
+  * the consumer, the last process attached, is reaped.
+  */
+
+ static void shmtest_main(int rounds) {
+   char producer_name[] = "shmtest-producer";
+   char consumer_name[] = "shmtest-consumer";
+   char *producer_argv[] = { producer_name, NULL };
+   char *consumer_argv[] = { consumer_name, NULL };
+   char msg[96];
+
+   shmtest_seg_t* seg = s_shm_create(SHMTEST_NAME, sizeof *seg);
+   if (seg == NULL) {
+     u_perror("shmtest: s_shm_create");
+     return;
+   }
+   s_sem_init(&seg->attached, 0);
+   s_sem_init(&seg->items, 0);
+   s_sem_init(&seg->space, 1);
+   seg->rounds = rounds;
+
+   const pid_t producer = s_spawn(shmtest_producer, producer_argv, 0, 1);
+   const pid_t consumer = s_spawn(shmtest_consumer, consumer_argv, 0, 1);
+   if (producer < 0 || consumer < 0) {
+     u_perror("shmtest: s_spawn");
+     // without its partner, the other child would wait forever
+     if (producer >= 0) {
+       s_kill(producer, P_SIGTERM);
+       s_waitpid(producer, NULL, false);
+     }
+     if (consumer >= 0) {
+       s_kill(consumer, P_SIGTERM);
+       s_waitpid(consumer, NULL, false);
+     }
+     s_shm_detach(seg);
+     return;
+   }
+
+   s_sem_wait(&seg->attached);
+   s_sem_wait(&seg->attached);
+   s_shm_detach(seg);
+
+   // the consumer is still attached, zombie or not, until we reap it
+   s_waitpid(producer, NULL, false);
+   seg = s_shm_attach(SHMTEST_NAME, NULL);
+   shmtest_report("segment kept after the producer was reaped", seg != NULL);
+   if (seg == NULL) {
+     s_waitpid(consumer, NULL, false);
+     return;
+   }
+   shmtest_report("name taken while attached",
+                  s_shm_create(SHMTEST_NAME, 1) == NULL && P_ERRNO == P_EEXIST);
+
+   s_waitpid(consumer, NULL, false);
+   const long long expected = (long long)rounds * (rounds + 1) / 2;
+   snprintf(msg, sizeof msg, "shmtest: consumer summed %lld, expected %lld\n",
+            seg->sum, expected);
+   s_write(STDERR_FILENO, msg, strlen(msg));
+   s_sem_destroy(&seg->attached);
+   s_sem_destroy(&seg->items);
+   s_sem_destroy(&seg->space);
+   s_shm_detach(seg);
+
+   void* again = s_shm_create(SHMTEST_NAME, 1);
+   shmtest_report("name free once the consumer was reaped", again != NULL);
+   if (again != NULL) {
+     s_shm_detach(again);
+   }
+ }
+
+
+ #define MSGBENCH_DEFAULT 10000  // round trips msgbench measures by default
+
+ static p_mutex_t msgbench_running;  // zeroed, so unlocked from the start
+
+ static msg_t* msgbench_held[MSG_POOL_SIZE];  // messages taken from the pool
+
+ static struct {
+   int hoarded;        // messages the hoarder got out of the pool
+   bool hoard_eagain;  // whether the pool then failed with P_EAGAIN
+ } msgbench_state;
+
+ /*
+  * Sends every message back to its sender, blocking in s_msg_recv while its
+  * mailbox is empty, until it gets an empty one.
+  */
+
+ static void* msgbench_echo(void* arg) {
+   while (true) {
+     msg_t* msg = s_msg_recv(false);
+     if (msg == NULL || msg->len == 0) {
+       s_msg_free(msg);
+       break;
+     }
+     s_msg_send(msg->sender, msg);
+   }
+   s_exit();
+   return NULL;
+ }
+
+ /*
+  * Empties the pool, then sends every other message to itself and exits
+  * holding the rest, so reaping it has to give back both kinds.
+  */
+
+ static void* msgbench_hoarder(void* arg) {
+   msg_t* msg;
+   while ((msg = s_msg_alloc()) != NULL) {
+     if (msgbench_state.hoarded++ % 2 == 0) {
+       s_msg_send(msg->sender, msg);  // alloc sets sender to our pid
+     }
+   }
+   msgbench_state.hoard_eagain = P_ERRNO == P_EAGAIN;
+   s_exit();
+   return NULL;
+ }
+
+ /*
+  * Takes every message left in the pool and frees them all again.
+  *
+  * @return the number of messages taken
+  */
+
+ static int msgbench_count_free(void) {
+   int count = 0;
+   while (count < MSG_POOL_SIZE &&
+          (msgbench_held[count] = s_msg_alloc()) != NULL) {
+     count++;
+   }
+   for (int i = 0; i < count; i++) {
+     s_msg_free(msgbench_held[i]);
+   }
+   return count;
+ }
+
+ static void msgbench_check(const char* what, bool ok) {
+   char msg[112];
+   snprintf(msg, sizeof msg, "msgbench: %s: %s\n", what, ok ? "ok" : "FAILED");
+   s_write(STDERR_FILENO, msg, strlen(msg));
+ }
+
+ /*
+  * Bounces one message off an echo process, which blocks on its mailbox
+  * between rounds. We poll ours instead, so we notice if the echo process is
+  * killed. Returns 1 if every round trip brought back the same message with
+  * the payload we sent, 0 if one didn't, or -1 if we had to stop early.
+  */
+
+ static int msgbench_ping_pong(pid_t echo, int rounds, histogram_t* rtt_ns) {
+   msg_t* msg = s_msg_alloc();
+   if (msg == NULL) {
+     u_perror("msgbench: s_msg_alloc");
+     return -1;
+   }
+
+   bool intact = true;
+   for (int i = 0; i < rounds; i++) {
+     msg->len = snprintf(msg->data, MSG_DATA_SIZE, "ping %d", i);
+     msg_t* sent = msg;
+     const long long start = sched_stats_now_ns();
+     if (s_msg_send(echo, msg) == -1) {
+       u_perror("msgbench: s_msg_send");
+       s_msg_free(msg);  // a failed send leaves it ours
+       return -1;
+     }
+     while ((msg = s_msg_recv(true)) == NULL) {
+       if (s_waitpid(echo, NULL, true) == echo) {
+         s_write(STDERR_FILENO, "msgbench: echo exited early\n",
+                 strlen("msgbench: echo exited early\n"));
+         return -1;
+       }
+       s_yield();
+     }
+     hist_record(rtt_ns, sched_stats_now_ns() - start);
+
+     char expected[MSG_DATA_SIZE];
+     int len = snprintf(expected, sizeof expected, "ping %d", i);
+     intact &= msg == sent && msg->len == len &&
+               memcmp(msg->data, expected, len) == 0;
+   }
+
+   msg->len = 0;  // tells the echo process to stop
+   s_msg_send(echo, msg);
+   return intact ? 1 : 0;
+ }
+
+ /*
+  * Measures message round trips, then checks that sending to a reaped process
+  * fails and that the pool gets back the messages of a reaped process that
+  * emptied it.
+  */
+
+ static void msgbench_main(int rounds) {
+   char echo_name[] = "msgbench-echo";
+   char hoarder_name[] = "msgbench-hoarder";
+   char *echo_argv[] = { echo_name, NULL };
+   char *hoarder_argv[] = { hoarder_name, NULL };
+   char msg[112];
+
+   if (s_mutex_trylock(&msgbench_running) == -1) {
+     const char* busy = "msgbench: already running\n";
+     s_write(STDERR_FILENO, busy, strlen(busy));
+     return;
+   }
+
+   const pid_t echo = s_spawn(msgbench_echo, echo_argv, 0, 1);
+   if (echo < 0) {
+     u_perror("msgbench: s_spawn");
+     s_mutex_unlock(&msgbench_running);
+     return;
+   }
+   histogram_t rtt_ns;
+   memset(&rtt_ns, 0, sizeof rtt_ns);
+   const int intact = msgbench_ping_pong(echo, rounds, &rtt_ns);
+   s_waitpid(echo, NULL, false);  // fails if it was already reaped
+
+   snprintf(msg, sizeof msg, "msgbench: %lld round trips\n", rtt_ns.count);
+   s_write(STDERR_FILENO, msg, strlen(msg));
+   bench_report("msgbench", "ns", &rtt_ns);
+   if (intact != -1) {
+     msgbench_check("same message back each round, payload intact", intact);
+     // a process moved to another cpu must not wait out a whole quantum
+     // before it sees its reply
+     msgbench_check("p99 round trip well under a quantum",
+                    hist_percentile(&rtt_ns, 99.0) <
+                        get_scheduler_quantum() * 1000 / 10);
+   }
+
+   msg_t* orphan = s_msg_alloc();
+   if (orphan != NULL) {
+     msgbench_check("send to a reaped process fails with P_ESRCH",
+                    s_msg_send(echo, orphan) == -1 && P_ERRNO == P_ESRCH);
+     s_msg_free(orphan);
+   }
+
+   memset(&msgbench_state, 0, sizeof msgbench_state);
+   const int before = msgbench_count_free();
+   const pid_t hoarder = s_spawn(msgbench_hoarder, hoarder_argv, 0, 1);
+   if (hoarder < 0) {
+     u_perror("msgbench: s_spawn");
+   } else {
+     s_waitpid(hoarder, NULL, false);
+     snprintf(msg, sizeof msg,
+              "msgbench: hoarder took %d of %d free messages\n",
+              msgbench_state.hoarded, before);
+     s_write(STDERR_FILENO, msg, strlen(msg));
+     msgbench_check("pool empty fails with P_EAGAIN",
+                    msgbench_state.hoard_eagain);
+     msgbench_check("pool refilled once the hoarder was reaped",
+                    msgbench_count_free() == before);
+   }
+
+   s_mutex_unlock(&msgbench_running);
+ }
+
  static char* gen_pattern_str() {
    size_t len = 5480;
  
@@ -230,6 +730,38 @@
     return NULL;
  }
  
+ void* swarm(void* arg) {
+   char** argv = arg;
+   int n = argv[1] != NULL ? atoi(argv[1]) : SWARM_DEFAULT;
+   swarm_main(n > 0 ? n : SWARM_DEFAULT);
+   s_exit();
+   return NULL;
+ }
+
+ void* lockbench(void* arg) {
+   char** argv = arg;
+   int rounds = argv[1] != NULL ? atoi(argv[1]) : LOCKBENCH_DEFAULT;
+   lockbench_main(rounds > 0 ? rounds : LOCKBENCH_DEFAULT);
+   s_exit();
+   return NULL;
+ }
+
+ void* shmtest(void* arg) {
+   char** argv = arg;
+   int rounds = argv[1] != NULL ? atoi(argv[1]) : SHMTEST_DEFAULT;
+   shmtest_main(rounds > 0 ? rounds : SHMTEST_DEFAULT);
+   s_exit();
+   return NULL;
+ }
+
+ void* msgbench(void* arg) {
+   char** argv = arg;
+   int rounds = argv[1] != NULL ? atoi(argv[1]) : MSGBENCH_DEFAULT;
+   msgbench_main(rounds > 0 ? rounds : MSGBENCH_DEFAULT);
+   s_exit();
+   return NULL;
+ }
+
  void* crash(void* arg) {
    // This one only works on a file system big enough to hold 5480 bytes
    crash_main();
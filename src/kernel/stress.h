@@ -5,6 +5,23 @@ void* hang(void*);
 void* nohang(void*);
 void* recur(void*);
 
+// spawns argv[1] (default 10000) processes that are all alive at once.
+void* swarm(void*);
+
+// passes a kernel mutex back and forth between two processes argv[1]
+// (default 10000) times and reports how long each handoff took.
+void* lockbench(void*);
+
+// passes argv[1] (default 1000) values from a producer to a consumer through
+// a shared memory segment, and checks that the segment outlives the producer
+// and that its name is free once the consumer is reaped.
+void* shmtest(void*);
+
+// bounces a message off another process argv[1] (default 10000) times and
+// reports the round trip times, then checks that a reaped process's messages
+// go back to the pool.
+void* msgbench(void*);
+
 // this one requires the fs to hold at least 5480 bytes for a file.
 void* crash(void*);
 
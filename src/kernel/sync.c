@@ -0,0 +1,505 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the kernel mutexes, semaphores and condition variables,
+ *          with handoff on release and priority inheritance for mutexes.
+ */
+
+#include "sync.h"
+#include <stddef.h>
+#include "../lib/pennos-errno.h"
+#include "kern_lock.h"
+#include "scheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                             HELPER FUNCTIONS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Finds the waiter with the best priority, the oldest among equals.
+ */
+static pcb_t* best_waiter(pcb_queue_t* waiters) {
+  pcb_t* best = waiters->head;
+  for (pcb_t* pcb = best; pcb != NULL; pcb = pcb->queue_next) {
+    if (pcb->priority < best->priority) {
+      best = pcb;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Hands a unit of a semaphore to its best waiter, or adds it to the
+ *        count if nobody waits.
+ */
+static void sem_give(p_sem_t* sem) {
+  pcb_t* next = best_waiter(&sem->waiters);
+  if (next != NULL) {
+    next->sem_granted = sem;
+    wake_process(next);  // unlinks it from the waiters
+  } else {
+    sem->count++;
+  }
+}
+
+/**
+ * @brief Moves a pcb to another priority level, requeueing it if it was
+ *        waiting in a run queue.
+ */
+static void set_priority(pcb_t* pcb, int priority) {
+  bool was_queued = dequeue_runnable(pcb);
+  pcb->priority = priority;
+  if (was_queued) {
+    put_pcb_into_correct_queue(pcb);
+  }
+}
+
+/**
+ * @brief Recomputes a pcb's priority from its base priority and the waiters
+ *        on the mutexes it holds.
+ *
+ * @return true if the priority changed
+ */
+static bool update_priority(pcb_t* pcb) {
+  int priority = pcb->base_priority;
+  for (p_mutex_t* m = pcb->held_mutexes; m != NULL; m = m->next_held) {
+    pcb_t* waiter = best_waiter(&m->waiters);
+    if (waiter != NULL && waiter->priority < priority) {
+      priority = waiter->priority;
+    }
+  }
+
+  if (priority == pcb->priority) {
+    return false;
+  }
+  set_priority(pcb, priority);
+  return true;
+}
+
+/**
+ * @brief Recomputes the priority of an owner, then of the owner it waits
+ *        for, and so on, until one doesn't change.
+ */
+static void update_owner_chain(pcb_t* owner) {
+  while (owner != NULL && update_priority(owner)) {
+    owner = owner->blocked_on != NULL ? owner->blocked_on->owner : NULL;
+  }
+}
+
+/**
+ * @brief Makes the owner, and whoever it waits for in turn, run at least at
+ *        the given priority.
+ */
+static void boost_owner_chain(pcb_t* owner, int priority) {
+  while (owner != NULL && owner->priority > priority) {
+    set_priority(owner, priority);
+    owner = owner->blocked_on != NULL ? owner->blocked_on->owner : NULL;
+  }
+}
+
+/**
+ * @brief Unlinks a mutex from its owner's held list.
+ */
+static void held_remove(pcb_t* owner, p_mutex_t* mutex) {
+  p_mutex_t** link = &owner->held_mutexes;
+  while (*link != NULL && *link != mutex) {
+    link = &(*link)->next_held;
+  }
+  if (*link != NULL) {
+    *link = mutex->next_held;
+  }
+  mutex->next_held = NULL;
+}
+
+/**
+ * @brief Makes the pcb the mutex's owner.
+ */
+static void mutex_take(p_mutex_t* mutex, pcb_t* pcb) {
+  mutex->owner = pcb;
+  mutex->next_held = pcb->held_mutexes;
+  pcb->held_mutexes = mutex;
+}
+
+/**
+ * @brief Locks the mutex for the calling process, blocking on it until it is
+ *        free or handed over. Called with the kernel lock held.
+ */
+static void mutex_acquire(p_mutex_t* mutex, pcb_t* self) {
+  while (mutex->owner != self) {
+    if (mutex->owner == NULL) {
+      mutex_take(mutex, self);
+      break;
+    }
+
+    self->blocked_on = mutex;
+    boost_owner_chain(mutex->owner, self->priority);
+    block_on_wait_queue(&mutex->waiters);
+    self->blocked_on = NULL;  // handed over, or resumed by P_SIGCONT
+  }
+}
+
+/**
+ * @brief Unlocks the mutex on behalf of its owner, handing it to the best
+ *        waiter. The old owner drops the priority it inherited through it.
+ *        Called with the kernel lock held.
+ */
+static void mutex_release(p_mutex_t* mutex) {
+  pcb_t* owner = mutex->owner;
+  held_remove(owner, mutex);
+  mutex->owner = NULL;
+
+  pcb_t* next = best_waiter(&mutex->waiters);
+  if (next != NULL) {
+    pcb_queue_remove(next);
+    next->blocked_on = NULL;
+    mutex_take(mutex, next);
+    update_priority(next);  // inherits from the waiters it now blocks
+    wake_process(next);
+  }
+  update_priority(owner);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                           MUTEX SYSTEM CALLS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes an unlocked mutex.
+ */
+int s_mutex_init(p_mutex_t* mutex) {
+  if (mutex == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  mutex->owner = NULL;
+  pcb_queue_init(&mutex->waiters);
+  mutex->next_held = NULL;
+  return 0;
+}
+
+/**
+ * @brief Destroys an unlocked mutex nobody waits for.
+ */
+int s_mutex_destroy(p_mutex_t* mutex) {
+  if (mutex == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  bool busy = mutex->owner != NULL || !pcb_queue_is_empty(&mutex->waiters);
+  kernel_unlock();
+  if (busy) {
+    P_ERRNO = P_EBUSY;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Locks a mutex, blocking while another process owns it.
+ */
+int s_mutex_lock(p_mutex_t* mutex) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (mutex == NULL || self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  if (mutex->owner == self) {
+    kernel_unlock();
+    P_ERRNO = P_EDEADLK;
+    return -1;
+  }
+
+  mutex_acquire(mutex, self);
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Locks a mutex if it is unlocked.
+ */
+int s_mutex_trylock(p_mutex_t* mutex) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (mutex == NULL || self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  if (mutex->owner != NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EBUSY;
+    return -1;
+  }
+
+  mutex_take(mutex, self);
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Unlocks a mutex, handing it to the best waiter.
+ */
+int s_mutex_unlock(p_mutex_t* mutex) {
+  if (mutex == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  if (mutex->owner == NULL || mutex->owner != current_running_pcb) {
+    kernel_unlock();
+    P_ERRNO = P_EPERM;
+    return -1;
+  }
+
+  mutex_release(mutex);
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Tells whether any process is blocked on a mutex.
+ */
+int s_mutex_has_waiters(p_mutex_t* mutex) {
+  if (mutex == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  int ret = pcb_queue_is_empty(&mutex->waiters) ? 0 : 1;
+  kernel_unlock();
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                         SEMAPHORE SYSTEM CALLS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes a semaphore with the given units.
+ */
+int s_sem_init(p_sem_t* sem, int value) {
+  if (sem == NULL || value < 0) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  sem->count = value;
+  pcb_queue_init(&sem->waiters);
+  return 0;
+}
+
+/**
+ * @brief Destroys a semaphore nobody waits for.
+ */
+int s_sem_destroy(p_sem_t* sem) {
+  if (sem == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  bool busy = !pcb_queue_is_empty(&sem->waiters);
+  kernel_unlock();
+  if (busy) {
+    P_ERRNO = P_EBUSY;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Takes a unit, blocking until one is posted if none is available.
+ */
+int s_sem_wait(p_sem_t* sem) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (sem == NULL || self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  self->sem_granted = NULL;
+  while (self->sem_granted == NULL) {
+    if (sem->count > 0) {
+      sem->count--;
+      break;
+    }
+    block_on_wait_queue(&sem->waiters);
+  }
+  self->sem_granted = NULL;
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Takes a unit if one is available.
+ */
+int s_sem_trywait(p_sem_t* sem) {
+  if (sem == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  if (sem->count == 0) {
+    kernel_unlock();
+    P_ERRNO = P_EAGAIN;
+    return -1;
+  }
+  sem->count--;
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Gives back a unit, handing it to the best waiter if there is one.
+ */
+int s_sem_post(p_sem_t* sem) {
+  if (sem == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  sem_give(sem);
+  kernel_unlock();
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                     CONDITION VARIABLE SYSTEM CALLS                        //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes a condition variable.
+ */
+int s_cond_init(p_cond_t* cond) {
+  if (cond == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  pcb_queue_init(&cond->waiters);
+  return 0;
+}
+
+/**
+ * @brief Destroys a condition variable nobody waits for.
+ */
+int s_cond_destroy(p_cond_t* cond) {
+  if (cond == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  bool busy = !pcb_queue_is_empty(&cond->waiters);
+  kernel_unlock();
+  if (busy) {
+    P_ERRNO = P_EBUSY;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Unlocks the mutex and waits on the condition variable, then locks
+ *        the mutex again.
+ */
+int s_cond_wait(p_cond_t* cond, p_mutex_t* mutex) {
+  kernel_lock();
+  pcb_t* self = current_running_pcb;
+  if (cond == NULL || mutex == NULL || self == NULL) {
+    kernel_unlock();
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  if (mutex->owner != self) {
+    kernel_unlock();
+    P_ERRNO = P_EPERM;
+    return -1;
+  }
+
+  // the kernel lock is held from the unlock until we are on the wait queue,
+  // so no signal can slip in between
+  mutex_release(mutex);
+  block_on_wait_queue(&cond->waiters);
+  mutex_acquire(mutex, self);
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Wakes the best waiter.
+ */
+int s_cond_signal(p_cond_t* cond) {
+  if (cond == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  pcb_t* next = best_waiter(&cond->waiters);
+  if (next != NULL) {
+    wake_process(next);
+  }
+  kernel_unlock();
+  return 0;
+}
+
+/**
+ * @brief Wakes every waiter.
+ */
+int s_cond_broadcast(p_cond_t* cond) {
+  if (cond == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+
+  kernel_lock();
+  wake_all(&cond->waiters);
+  kernel_unlock();
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                          KERNEL SYNC FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Sets a process's base priority, keeping any inherited priority.
+ */
+void sync_set_base_priority(pcb_t* pcb, int priority) {
+  pcb->base_priority = priority;
+  update_priority(pcb);
+  if (pcb->blocked_on != NULL) {
+    update_owner_chain(pcb->blocked_on->owner);
+  }
+}
+
+/**
+ * @brief Hands off a zombie's mutexes and semaphore unit, and drops the boost
+ *        it was giving.
+ */
+void sync_release_all(pcb_t* pcb) {
+  while (pcb->held_mutexes != NULL) {
+    mutex_release(pcb->held_mutexes);
+  }
+
+  if (pcb->blocked_on != NULL) {
+    p_mutex_t* mutex = pcb->blocked_on;
+    pcb->blocked_on = NULL;
+    update_owner_chain(mutex->owner);
+  }
+
+  // a unit handed over after it was terminated would otherwise be lost
+  if (pcb->sem_granted != NULL) {
+    p_sem_t* sem = pcb->sem_granted;
+    pcb->sem_granted = NULL;
+    sem_give(sem);
+  }
+}
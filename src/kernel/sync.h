@@ -0,0 +1,242 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the kernel synchronization objects: mutexes, counting
+ *          semaphores and condition variables for PennOS processes. A
+ *          process that has to wait is taken off the run queues and blocked
+ *          on the object's wait queue, instead of spinning on a cpu.
+ */
+
+#ifndef SYNC_H_
+#define SYNC_H_
+
+#include "kern_pcb.h"
+
+/**
+ * @brief A mutex. Unlocking hands it straight to the waiter with the best
+ *        priority (FIFO among equals), so a releaser can't take it back
+ *        before that waiter runs. While it has waiters, its owner runs at
+ *        the best priority among them (priority inheritance), and so does
+ *        whatever owner that owner is itself waiting for. Processes share
+ *        one address space, so a mutex may live in any process's memory. A
+ *        zeroed mutex is unlocked, like one just passed to s_mutex_init.
+ */
+typedef struct p_mutex_st {
+  struct pcb_st* owner;          // NULL while unlocked
+  pcb_queue_t waiters;           // processes blocked in s_mutex_lock
+  struct p_mutex_st* next_held;  // next mutex in the owner's held list
+} p_mutex_t;
+
+/**
+ * @brief A counting semaphore. A post with waiters hands the unit straight
+ *        to the waiter with the best priority instead of raising the count.
+ */
+typedef struct p_sem_st {
+  int count;            // units available, never negative
+  pcb_queue_t waiters;  // processes blocked in s_sem_wait
+} p_sem_t;
+
+/**
+ * @brief A condition variable, used together with a p_mutex_t.
+ */
+typedef struct p_cond_st {
+  pcb_queue_t waiters;  // processes blocked in s_cond_wait
+} p_cond_t;
+
+////////////////////////////////////////////////////////////////////////////////
+//                           MUTEX SYSTEM CALLS                               //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes an unlocked mutex.
+ *
+ * @param mutex the mutex
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if mutex is NULL
+ */
+int s_mutex_init(p_mutex_t* mutex);
+
+/**
+ * @brief Destroys a mutex. It must be unlocked and have no waiters.
+ *
+ * @param mutex the mutex
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if mutex is NULL, or
+ *         P_EBUSY if it is locked or waited for
+ */
+int s_mutex_destroy(p_mutex_t* mutex);
+
+/**
+ * @brief Locks a mutex, blocking the calling process on it while another
+ *        process owns it. Meanwhile, the owner runs at the caller's priority
+ *        if that is better than its own.
+ *
+ * @param mutex the mutex
+ * @return 0 once the caller owns the mutex, -1 with P_ERRNO set to P_EINVAL
+ *         if mutex is NULL or the caller isn't a process, or P_EDEADLK if
+ *         the caller already owns it
+ */
+int s_mutex_lock(p_mutex_t* mutex);
+
+/**
+ * @brief Locks a mutex only if it is unlocked, never blocking.
+ *
+ * @param mutex the mutex
+ * @return 0 if the caller now owns the mutex, -1 with P_ERRNO set to P_EBUSY
+ *         if it is locked, or P_EINVAL if mutex is NULL or the caller isn't a
+ *         process
+ */
+int s_mutex_trylock(p_mutex_t* mutex);
+
+/**
+ * @brief Unlocks a mutex the caller owns. If processes are waiting, it is
+ *        handed to the one with the best priority, which becomes the owner
+ *        right away. The caller drops any priority it inherited through the
+ *        mutex.
+ *
+ * @param mutex the mutex
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if mutex is NULL, or
+ *         P_EPERM if the caller doesn't own it
+ */
+int s_mutex_unlock(p_mutex_t* mutex);
+
+/**
+ * @brief Tells whether any process is blocked on a mutex. The answer can be
+ *        stale by the time the caller looks at it, so it is only a hint, e.g.
+ *        for waiting until another process has blocked on the mutex.
+ *
+ * @param mutex the mutex
+ * @return 1 if a process is waiting, 0 if none is, or -1 with P_ERRNO set to
+ *         P_EINVAL if mutex is NULL
+ */
+int s_mutex_has_waiters(p_mutex_t* mutex);
+
+////////////////////////////////////////////////////////////////////////////////
+//                         SEMAPHORE SYSTEM CALLS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes a semaphore.
+ *
+ * @param sem   the semaphore
+ * @param value the units initially available
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if sem is NULL or
+ *         value is negative
+ */
+int s_sem_init(p_sem_t* sem, int value);
+
+/**
+ * @brief Destroys a semaphore. It must have no waiters.
+ *
+ * @param sem the semaphore
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if sem is NULL, or
+ *         P_EBUSY if it is waited for
+ */
+int s_sem_destroy(p_sem_t* sem);
+
+/**
+ * @brief Takes one unit, blocking the calling process on the semaphore
+ *        until one is posted to it if none is available.
+ *
+ * @param sem the semaphore
+ * @return 0 once a unit is taken, -1 with P_ERRNO set to P_EINVAL if sem is
+ *         NULL or the caller isn't a process
+ */
+int s_sem_wait(p_sem_t* sem);
+
+/**
+ * @brief Takes one unit only if one is available, never blocking.
+ *
+ * @param sem the semaphore
+ * @return 0 if a unit was taken, -1 with P_ERRNO set to P_EAGAIN if none is
+ *         available, or P_EINVAL if sem is NULL
+ */
+int s_sem_trywait(p_sem_t* sem);
+
+/**
+ * @brief Gives back one unit, handing it to the waiter with the best
+ *        priority if there is one.
+ *
+ * @param sem the semaphore
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if sem is NULL
+ */
+int s_sem_post(p_sem_t* sem);
+
+////////////////////////////////////////////////////////////////////////////////
+//                     CONDITION VARIABLE SYSTEM CALLS                        //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Initializes a condition variable.
+ *
+ * @param cond the condition variable
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if cond is NULL
+ */
+int s_cond_init(p_cond_t* cond);
+
+/**
+ * @brief Destroys a condition variable. It must have no waiters.
+ *
+ * @param cond the condition variable
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if cond is NULL, or
+ *         P_EBUSY if it is waited for
+ */
+int s_cond_destroy(p_cond_t* cond);
+
+/**
+ * @brief Unlocks the mutex and blocks the calling process on the condition
+ *        variable in one step, so a signal sent after the unlock is never
+ *        missed, then locks the mutex again before returning. Like
+ *        pthread_cond_wait, it may return without a signal (e.g. after
+ *        P_SIGSTOP and P_SIGCONT), so callers re-check their condition.
+ *
+ * @param cond  the condition variable
+ * @param mutex the mutex, which the caller must own
+ * @return 0 once the mutex is owned again, -1 with P_ERRNO set to P_EINVAL if
+ *         either is NULL or the caller isn't a process, or P_EPERM if the
+ *         caller doesn't own the mutex
+ */
+int s_cond_wait(p_cond_t* cond, p_mutex_t* mutex);
+
+/**
+ * @brief Wakes the waiter with the best priority, if any.
+ *
+ * @param cond the condition variable
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if cond is NULL
+ */
+int s_cond_signal(p_cond_t* cond);
+
+/**
+ * @brief Wakes every waiter.
+ *
+ * @param cond the condition variable
+ * @return 0 on success, -1 with P_ERRNO set to P_EINVAL if cond is NULL
+ */
+int s_cond_broadcast(p_cond_t* cond);
+
+////////////////////////////////////////////////////////////////////////////////
+//                          KERNEL SYNC FUNCTIONS                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Sets the priority a process runs at when it inherits none (see
+ *        s_nice). It keeps running at any better priority it inherits from
+ *        the waiters on its mutexes, and if it is waiting for a mutex
+ *        itself, the owner's inherited priority is updated too. A runnable
+ *        process is requeued at its new priority. Called with the kernel
+ *        lock held.
+ *
+ * @param pcb      the process
+ * @param priority the new base priority (0,1,2)
+ */
+void sync_set_base_priority(pcb_t* pcb, int priority);
+
+/**
+ * @brief Cleans up after a process that exited or was terminated: hands
+ *        every mutex it owns to its next waiter, stops boosting the owner of
+ *        the mutex it was waiting for, and passes on a semaphore unit it was
+ *        handed but never took. Called with the kernel lock held when the
+ *        process becomes a zombie.
+ *
+ * @param pcb the zombie process
+ */
+void sync_release_all(pcb_t* pcb);
+
+#endif  // SYNC_H_
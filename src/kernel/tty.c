@@ -0,0 +1,202 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Implements the terminal line discipline. Only the input thread
+ *          touches the host's stdin, so a process waiting for input sits on
+ *          a wait queue instead of holding a CPU in a host read.
+ */
+
+#include "tty.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "../lib/pennos-errno.h"
+#include "kern_lock.h"
+#include "kern_pcb.h"
+#include "scheduler.h"
+
+static struct {
+  char data[TTY_BUFFER_SIZE];
+  int len;              // bytes buffered
+  int ready;            // bytes at the front that readers may take
+  bool eof;             // an end of file is waiting to be read
+  bool is_terminal;     // stdin is a terminal, so each end of file is one-off
+  bool input_waiting;   // the input thread is waiting on room_sem
+  bool running;         // the input thread was started and not yet joined
+  pcb_queue_t readers;  // processes blocked in tty_read
+  sem_t room_sem;       // posted when a reader frees room or takes an eof
+  pthread_t thread;
+} tty;
+
+////////////////////////////////////////////////////////////////////////////////
+//                              INPUT THREAD                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Lets the input thread read again once a reader has made room.
+ *        Called with the kernel lock held.
+ */
+static void tty_post_room() {
+  if (tty.input_waiting) {
+    tty.input_waiting = false;
+    sem_post(&tty.room_sem);
+  }
+}
+
+/**
+ * @brief Moves the ready mark up after new input. A terminal already hands
+ *        over whole lines (or a line cut short by ^D), so all of it is ready.
+ *        Other input is only ready through its last newline, unless it has
+ *        ended or the buffer is full.
+ */
+static void tty_update_ready() {
+  if (tty.is_terminal || tty.eof || tty.len == TTY_BUFFER_SIZE) {
+    tty.ready = tty.len;
+    return;
+  }
+  for (int i = tty.len; i > tty.ready; i--) {
+    if (tty.data[i - 1] == '\n') {
+      tty.ready = i;
+      return;
+    }
+  }
+}
+
+/**
+ * @brief The input thread. Reads the host's stdin into the line buffer and
+ *        wakes the readers. It can only be cancelled while blocked outside
+ *        the kernel lock.
+ */
+static void* tty_input_loop(void* arg) {
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+  char chunk[TTY_BUFFER_SIZE];
+
+  while (true) {
+    kernel_lock();
+    int room = tty.eof ? 0 : TTY_BUFFER_SIZE - tty.len;
+    tty.input_waiting = room == 0;
+    kernel_unlock();
+
+    if (room == 0) {
+      pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+      while (sem_wait(&tty.room_sem) == -1 && errno == EINTR) {
+      }
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+      continue;
+    }
+
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    ssize_t bytes_read = read(STDIN_FILENO, chunk, room);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    if (bytes_read == -1 && errno == EINTR) {
+      continue;
+    }
+
+    kernel_lock();
+    if (bytes_read <= 0) {
+      tty.eof = true;  // a failed read ends the input too
+    } else {
+      memcpy(tty.data + tty.len, chunk, bytes_read);
+      tty.len += bytes_read;
+    }
+    tty_update_ready();
+    wake_all(&tty.readers);
+    bool done = tty.eof && !tty.is_terminal;
+    kernel_unlock();
+
+    if (done) {
+      return NULL;  // a pipe or file has nothing more to give
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               TTY FUNCTIONS                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Starts the input thread with every host signal blocked.
+ */
+int tty_init() {
+  tty.len = 0;
+  tty.ready = 0;
+  tty.eof = false;
+  tty.input_waiting = false;
+  tty.is_terminal = isatty(STDIN_FILENO);
+  pcb_queue_init(&tty.readers);
+  if (sem_init(&tty.room_sem, 0, 0) == -1) {
+    P_ERRNO = P_EAGAIN;
+    return -1;
+  }
+
+  sigset_t all_signals;
+  sigset_t old_mask;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_SETMASK, &all_signals, &old_mask);
+  int ret = pthread_create(&tty.thread, NULL, tty_input_loop, NULL);
+  pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+  if (ret != 0) {
+    sem_destroy(&tty.room_sem);
+    P_ERRNO = P_EAGAIN;
+    return -1;
+  }
+  tty.running = true;
+  return 0;
+}
+
+/**
+ * @brief Cancels and joins the input thread.
+ */
+void tty_destroy() {
+  if (!tty.running) {
+    return;
+  }
+  pthread_cancel(tty.thread);
+  pthread_join(tty.thread, NULL);
+  sem_destroy(&tty.room_sem);
+  tty.running = false;
+}
+
+/**
+ * @brief Reads the next line of terminal input, blocking until one arrives.
+ */
+int tty_read(char* buf, int n) {
+  if (buf == NULL || n < 0 || current_running_pcb == NULL) {
+    P_ERRNO = P_EINVAL;
+    return -1;
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  while (tty.ready == 0 && !tty.eof) {
+    block_on_wait_queue(&tty.readers);
+  }
+
+  if (tty.ready == 0) {
+    // a pipe's end of file stays, but a terminal's is used up by one read
+    if (tty.is_terminal) {
+      tty.eof = false;
+      tty_post_room();
+    }
+    return 0;
+  }
+
+  int count = 0;
+  while (count < n && count < tty.ready) {
+    if (tty.data[count++] == '\n') {
+      break;
+    }
+  }
+  memcpy(buf, tty.data, count);
+  memmove(tty.data, tty.data + count, tty.len - count);
+  tty.len -= count;
+  tty.ready -= count;
+  tty_post_room();
+  return count;
+}
@@ -0,0 +1,49 @@
+/* CS5480 PennOS Group 61
+ * Authors: Krystof Purtell and Richard Zhang
+ * Purpose: Defines the terminal line discipline. A host thread reads the
+ *          terminal into a kernel line buffer, and PennOS processes reading
+ *          stdin block on a wait queue until a line is ready.
+ */
+
+#ifndef TTY_H_
+#define TTY_H_
+
+#define TTY_BUFFER_SIZE 4096  // bytes of input the kernel holds at most
+
+////////////////////////////////////////////////////////////////////////////////
+//                               TTY FUNCTIONS                                //
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Starts the input thread, which reads the host's stdin into the line
+ *        buffer. Called once at boot, before any process reads stdin. The
+ *        thread blocks every host signal, so terminal signals keep going to
+ *        the scheduler and process threads.
+ *
+ * @return 0 on success, -1 with P_ERRNO set to P_EAGAIN if the thread
+ *         couldn't be created
+ */
+int tty_init();
+
+/**
+ * @brief Stops the input thread. Called at shutdown.
+ */
+void tty_destroy();
+
+/**
+ * @brief Reads the next line of terminal input, blocking the calling process
+ *        on the terminal's wait queue (off every run queue) until a line or
+ *        end of file arrives. Returns at most one line, newline included; a
+ *        line longer than n is returned over several reads. Input from a pipe
+ *        or file is handed out a line at a time too, and a partial last line
+ *        once the input ends. Called with the kernel lock held.
+ *
+ * @param buf the buffer to read into
+ * @param n   the most bytes to read
+ * @return the number of bytes read, 0 at end of file, or -1 with P_ERRNO set
+ *         to P_EINVAL if buf is NULL, n is negative, or the caller isn't a
+ *         process
+ */
+int tty_read(char* buf, int n);
+
+#endif  // TTY_H_
@@ -29,6 +29,10 @@ extern int
 #define P_NEEDF 22           // Error when no file provided to mount
 #define P_INITFAIL 23        // Error when trying to spawn init process
 #define P_EREDIR 24          // Error when trying to redirect
+#define P_EAGAIN 25          // Out of resources (e.g. threads), try again
+#define P_ESRCH 26           // No such process or process group
+#define P_EPIPE 27           // Write to a pipe with no read end open
+#define P_EDEADLK 28         // Locking a mutex the caller already owns
 #define P_EUNKNOWN 99        // Catch-all unknown error
 
 #endif
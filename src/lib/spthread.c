@@ -1,15 +1,23 @@
 #define _GNU_SOURCE
 
 #include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <pthread.h>
+#include <setjmp.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "./spthread.h"
+#include "./spthread_stack.h"
 
-#define MILISEC_IN_NANO 100000
+// the green threads backend replaces this file, see spthread_green.c
+#ifndef SPTHREAD_GREEN
 
 ///////////////////////////////////////////////////////////////////////////////
 // definitions and  thread_local globals
@@ -20,12 +28,6 @@
 typedef void* (*pthread_fn)(void*);
 
 typedef struct spthread_fwd_args_st {
-  // these two are to forward the args of spthread_create so
-  // that the function is actually run since spthread_create
-  // starts the thread in a setup function
-  pthread_fn actual_routine;
-  void* actual_arg;
-
   // these three are to make sure the thread
   // has been created, setup its signal handlers
   // and suspended before spthread_create returns
@@ -40,35 +42,62 @@ typedef struct spthread_fwd_args_st {
   spthread_meta_t* child_meta;
 } spthread_fwd_args;
 
-// struct used to send signal to spthread
-// and so that the thread can set "ack"
-// to acknowledge that it is going to stop/continue
-typedef struct spthread_signal_args_st {
-  const int signal;
-  volatile sig_atomic_t ack;
-  pthread_mutex_t shutup_mutex;
-  // mutex to make helgrind shutup about data races
-  // This mutex is probably not necessary, but
-  // here for now. Problaby should use <stdatmoic.h>
-} spthread_signal_args;
-
 // meta information necessary for
 // spthread to work
 typedef struct spthread_meta_st {
   // the sigmask when a thread suspends
   sigset_t suspend_set;
 
-  // current state of the spthread
+  // current state of the spthread, also the futex word
+  // that suspend and continue wait on for their handshake.
   // Necssary sinnce there may be a
   // race condition on a thread exiting
   // before a signal is sent to it.
   // 0 = normal/running/ready
   // 1 = suspended
   // 2 = exited
-  volatile sig_atomic_t state;
+  // 3 = continued, but not running yet
+  _Atomic int state;
+
+  // set by spthread_suspend before it sends SIGPTHD, so
+  // that the handler knows the signal is a suspend request
+  _Atomic int suspend_requested;
+
+  // when the thread last started running after a continue,
+  // in ns of CLOCK_MONOTONIC
+  _Atomic long long resumed_ns;
 
   // for data races
   pthread_mutex_t meta_mutex;
+
+  // the host thread, and what it runs for its current owner.
+  // A pooled thread gets a new routine for every owner
+  pthread_t pthread;
+  pthread_fn routine;
+  void* arg;
+
+  // the stack spthread mapped for the host thread, which a pooled
+  // thread keeps. Freed once the thread is joined
+  spthread_stack_t stack;
+
+  // tells the owners of a pooled thread apart: handed out with
+  // every spthread_t, and new each time the thread is reused
+  _Atomic unsigned generation;
+
+  // set by spthread_release. The thread jumps back to release_env
+  // the next time it waits while suspended, then parks in the pool
+  _Atomic int release_requested;
+  sigjmp_buf release_env;
+
+  // set while the thread can only be stopped where it holds no
+  // locks: before it first runs, or while its owner says so with
+  // spthread_set_releasable_self. Only then may it be released
+  // into the pool, since jumping out of a handler that stopped it
+  // inside libc would leave libc's locks held
+  _Atomic int releasable;
+
+  // next parked thread in the pool
+  struct spthread_meta_st* next_parked;
 } spthread_meta_t;
 
 // Defines the various states
@@ -76,13 +105,18 @@ typedef struct spthread_meta_st {
 #define SPTHREAD_RUNNING_STATE 0
 #define SPTHREAD_SUSPENDED_STATE 1
 #define SPTHREAD_TERMINATED_STATE 2
-
-// Defined integer values
-// that are sent with SIGPTHD
-// via sigqueue. Other values are
-// safe to send
-#define SPTHREAD_SIG_SUSPEND -1
-#define SPTHREAD_SIG_CONTINUE -2
+#define SPTHREAD_RESUMING_STATE 3
+#define SPTHREAD_PARKED_STATE 4  // in the pool, waiting for a new routine
+
+// the pool of parked threads that spthread_create hands out before it
+// creates new ones. pool_returning counts released threads still on
+// their way back, so that the pool never holds more than pool_capacity
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static spthread_meta_t* pool_head = NULL;
+static int pool_len = 0;
+static int pool_returning = 0;
+static int pool_capacity = 0;
+static _Atomic unsigned next_generation = 1;
 
 // this is a variable that is local to a thread
 // (each thread has their own copy of this global)
@@ -107,6 +141,36 @@ static void* spthread_start(void* arg);
 // sets itself to be in the "terminated" status
 static void mark_self_terminated(void* arg);
 
+// blocks on the futex word until it no longer holds expected
+static void futex_wait(_Atomic int* word, int expected);
+
+// wakes every thread blocked on the futex word
+static void futex_wake(_Atomic int* word);
+
+// sets the state of the spthread and wakes whoever waits for it to change
+static void set_state(spthread_meta_t* meta, int state);
+
+// called by a thread that just marked itself suspended. waits until
+// spthread_continue wakes it, then marks itself running again.
+// All signals should be blocked while this runs
+static void wait_while_suspended(void);
+
+// starts a host thread for the meta on a new stack of stack_size bytes,
+// which either waits suspended for its routine or, without one, parks
+// itself in the pool
+static int start_thread(spthread_meta_t* meta, size_t stack_size);
+
+// joins the host thread of the meta, then frees its stack and the meta
+static int join_thread(spthread_meta_t* meta, void** retval);
+
+// called by a released thread: puts itself back in the pool, then
+// waits until spthread_create hands it a new routine.
+// All signals should be blocked while this runs
+static void park_self(void);
+
+// whether the handle still names the thread's current owner
+static bool is_current(spthread_t thread);
+
 ///////////////////////////////////////////////////////////////////////////////
 // public function definitions
 ///////////////////////////////////////////////////////////////////////////////
@@ -115,57 +179,148 @@ int spthread_create(spthread_t* thread,
                     const pthread_attr_t* attr,
                     pthread_fn start_routine,
                     void* arg) {
-  spthread_meta_t* child_meta = malloc(sizeof(spthread_meta_t));
-  if (child_meta == NULL) {
-    return EAGAIN;
+  size_t stack_size;
+  int ret = spthread_stack_size(attr, &stack_size);
+  if (ret != 0) {
+    return ret;
   }
 
-  spthread_fwd_args* fwd_args = malloc(sizeof(spthread_fwd_args));
-  if (fwd_args == NULL) {
-    free(child_meta);
-    return EAGAIN;
+  // a parked thread already went through setup, so handing it the
+  // routine is all it takes. It waits suspended like a new thread
+  pthread_mutex_lock(&pool_mutex);
+  spthread_meta_t* meta = NULL;
+  for (spthread_meta_t** link = &pool_head; *link != NULL;
+       link = &(*link)->next_parked) {
+    if ((*link)->stack.size == stack_size) {
+      meta = *link;
+      *link = meta->next_parked;
+      break;
+    }
   }
-  *fwd_args = (spthread_fwd_args){
-      .actual_routine = start_routine,
-      .actual_arg = arg,
-      .setup_done = false,
-      .child_meta = child_meta,
+  if (meta != NULL) {
+    pool_len--;
+    meta->routine = start_routine;
+    meta->arg = arg;
+    atomic_store(&meta->generation, atomic_fetch_add(&next_generation, 1));
+    atomic_store(&meta->release_requested, 0);
+    atomic_store(&meta->suspend_requested, 0);
+    atomic_store(&meta->resumed_ns, 0);
+    set_state(meta, SPTHREAD_SUSPENDED_STATE);
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  if (meta == NULL) {
+    meta = malloc(sizeof(spthread_meta_t));
+    if (meta == NULL) {
+      return EAGAIN;
+    }
+    meta->routine = start_routine;
+    meta->arg = arg;
+    ret = start_thread(meta, stack_size);
+    if (ret != 0) {
+      free(meta);
+      return ret;
+    }
+  }
+
+  *thread = (spthread_t){
+      .thread = meta->pthread,
+      .meta = meta,
+      .generation = atomic_load(&meta->generation),
   };
 
-  int ret = pthread_mutex_init(&(fwd_args->setup_mutex), NULL);
-  if (ret != 0) {
-    free(child_meta);
-    free(fwd_args);
-    return EAGAIN;
+  return 0;
+}
+
+int spthread_pool_init(int size) {
+  if (size < 0) {
+    return EINVAL;
   }
 
-  ret = pthread_cond_init(&(fwd_args->setup_cond), NULL);
+  size_t stack_size;
+  int ret = spthread_stack_size(NULL, &stack_size);
   if (ret != 0) {
-    free(child_meta);
-    pthread_mutex_destroy(&(fwd_args->setup_mutex));
-    free(fwd_args);
-    return EAGAIN;
+    return ret;
   }
 
-  pthread_t pthread;
-  int result = pthread_create(&pthread, attr, spthread_start, fwd_args);
+  pthread_mutex_lock(&pool_mutex);
+  pool_capacity = size;
+  int missing = size - pool_len;
+  pthread_mutex_unlock(&pool_mutex);
 
-  pthread_mutex_lock(&(fwd_args->setup_mutex));
-  while (fwd_args->setup_done == false) {
-    pthread_cond_wait(&(fwd_args->setup_cond), &(fwd_args->setup_mutex));
+  // threads without a routine park themselves once set up
+  for (int i = 0; i < missing; i++) {
+    spthread_meta_t* meta = malloc(sizeof(spthread_meta_t));
+    if (meta == NULL) {
+      return EAGAIN;
+    }
+    meta->routine = NULL;
+    meta->arg = NULL;
+    ret = start_thread(meta, stack_size);
+    if (ret != 0) {
+      free(meta);
+      return ret;
+    }
   }
-  pthread_mutex_unlock(&(fwd_args->setup_mutex));
+  return 0;
+}
 
-  pthread_cond_destroy(&(fwd_args->setup_cond));
-  pthread_mutex_destroy(&(fwd_args->setup_mutex));
-  free(fwd_args);
+void spthread_pool_destroy() {
+  pthread_mutex_lock(&pool_mutex);
+  spthread_meta_t* parked = pool_head;
+  pool_head = NULL;
+  pool_len = 0;
+  pool_capacity = 0;
+  pthread_mutex_unlock(&pool_mutex);
+
+  // kicked out of the pool, a thread waits suspended, which is a
+  // cancellation point
+  while (parked != NULL) {
+    spthread_meta_t* next = parked->next_parked;
+    pthread_cancel(parked->pthread);
+    set_state(parked, SPTHREAD_SUSPENDED_STATE);
+    join_thread(parked, NULL);
+    parked = next;
+  }
+}
 
-  *thread = (spthread_t){
-      .thread = pthread,
-      .meta = child_meta,
-  };
+int spthread_release(spthread_t thread) {
+  if (!is_current(thread)) {
+    return ESRCH;
+  }
 
-  return result;
+  // a running thread is stopped first, so that it waits suspended
+  // and releasable can no longer change
+  spthread_meta_t* meta = thread.meta;
+  spthread_suspend(thread);
+
+  pthread_mutex_lock(&pool_mutex);
+  bool room = atomic_load(&meta->state) != SPTHREAD_TERMINATED_STATE &&
+              atomic_load(&meta->releasable) &&
+              pool_len + pool_returning < pool_capacity;
+  if (room) {
+    pool_returning++;
+  }
+  pthread_mutex_unlock(&pool_mutex);
+
+  if (!room) {
+    spthread_cancel(thread);
+    spthread_continue(thread);
+    spthread_suspend(thread);  // forces it to hit a cancellation point
+    return spthread_join(thread, NULL);
+  }
+
+  // the continue changes the futex word before waking the thread,
+  // so it sees the request whether or not it was asleep yet
+  atomic_store(&meta->release_requested, 1);
+  spthread_continue(thread);
+  return 0;
+}
+
+void spthread_set_releasable_self(bool releasable) {
+  if (my_meta != NULL) {
+    atomic_store(&my_meta->releasable, releasable);
+  }
 }
 
 int spthread_suspend(spthread_t thread) {
@@ -175,51 +330,40 @@ int spthread_suspend(spthread_t thread) {
     return spthread_suspend_self();
   }
 
-  spthread_signal_args args = (spthread_signal_args){
-      .signal = SPTHREAD_SIG_SUSPEND,
-      .ack = 0,
-  };
-  pthread_mutex_init(&args.shutup_mutex, NULL);
+  if (!is_current(thread)) {
+    // the thread was released, and may already run for someone else
+    return ESRCH;
+  }
+
+  // a continue the thread hasn't woken up for yet is simply taken back
+  int expected = SPTHREAD_RESUMING_STATE;
+  if (atomic_compare_exchange_strong(&thread.meta->state, &expected,
+                                     SPTHREAD_SUSPENDED_STATE) ||
+      expected != SPTHREAD_RUNNING_STATE) {
+    // already suspended or exited, nothing to do
+    return 0;
+  }
 
-  int ret = pthread_sigqueue(thread.thread, SIGPTHD,
-                             (union sigval){
-                                 .sival_ptr = &args,
-                             });
+  // a signal is still needed to stop the thread wherever it is,
+  // but the handler reads the request from the meta instead of
+  // a sigqueue payload
+  atomic_store(&thread.meta->suspend_requested, 1);
+  int ret = pthread_kill(thread.thread, SIGPTHD);
   if (ret != 0) {
-    pthread_mutex_destroy(&args.shutup_mutex);
+    atomic_store(&thread.meta->suspend_requested, 0);
     // handles the case where the thread is already dead.
     return ret;
   }
 
-  // wait for our signal to be ack'd
-
-  // setting up args to nanosleep
-  const struct timespec t = (struct timespec){
-      .tv_nsec = MILISEC_IN_NANO,
-  };
-
-  nanosleep(&t, NULL);
-
-  pthread_mutex_lock(&args.shutup_mutex);
-  while (args.ack != 1) {
-    // wait for a mili second
-    pthread_mutex_unlock(&args.shutup_mutex);
-
-
-    nanosleep(&t, NULL);
-
-    // fprintf(stderr, "susp checking...\n");
-    pthread_mutex_lock(&args.shutup_mutex);
-
-    if (thread.meta->state == SPTHREAD_TERMINATED_STATE) {
-      // child called exit, can break
-      break;
-    }
+  // wait for our signal to be ack'd: the thread leaves the
+  // running state once it suspended itself or exited
+  int state;
+  while ((state = atomic_load(&thread.meta->state)) ==
+         SPTHREAD_RUNNING_STATE) {
+    futex_wait(&thread.meta->state, state);
   }
-  pthread_mutex_unlock(&args.shutup_mutex);
 
-  pthread_mutex_destroy(&args.shutup_mutex);
-  return ret;
+  return 0;
 }
 
 int spthread_suspend_self() {
@@ -229,11 +373,14 @@ int spthread_suspend_self() {
     return ESRCH;
   }
 
-  my_meta->state = SPTHREAD_SUSPENDED_STATE;
-
-  do {
-    sigsuspend(&my_meta->suspend_set);
-  } while (my_meta->state == SPTHREAD_SUSPENDED_STATE);
+  sigset_t old_set;
+  pthread_sigmask(SIG_SETMASK, &my_meta->suspend_set, &old_set);
+  set_state(my_meta, SPTHREAD_SUSPENDED_STATE);
+  wait_while_suspended();
+  // a spthread_suspend that raced with us suspending ourselves was
+  // satisfied by it; its signal must not suspend us a second time
+  atomic_store(&my_meta->suspend_requested, 0);
+  pthread_sigmask(SIG_SETMASK, &old_set, NULL);
 
   return 0;
 }
@@ -243,54 +390,41 @@ int spthread_continue(spthread_t thread) {
 
   if (pthread_equal(pself, thread.thread) != 0) {
     // I am already runnning... so just return 0
-    my_meta->state = SPTHREAD_RUNNING_STATE;
+    atomic_store(&my_meta->state, SPTHREAD_RUNNING_STATE);
     return 0;
   }
 
-  spthread_signal_args args = (spthread_signal_args){
-      .signal = SPTHREAD_SIG_CONTINUE,
-      .ack = 0,
-  };
-  pthread_mutex_init(&args.shutup_mutex, NULL);
-
-  int ret = pthread_sigqueue(thread.thread, SIGPTHD,
-                             (union sigval){
-                                 .sival_ptr = &args,
-                             });
-  if (ret != 0) {
-    pthread_mutex_destroy(&args.shutup_mutex);
-    // handles the case where the thread is already dead.
-    return ret;
+  if (!is_current(thread)) {
+    return ESRCH;
   }
 
-  // wait for our signal to be ack'd
-
-  // setting up args to nanosleep
-  const struct timespec t = (struct timespec){
-      .tv_nsec = MILISEC_IN_NANO,
-  };
-
-  pthread_mutex_lock(&args.shutup_mutex);
-  while (args.ack != 1) {
-    // wait for a mili second
-    pthread_mutex_unlock(&args.shutup_mutex);
+  // only a suspended thread is continued; it waits on the
+  // futex, so no signal is needed to wake it up. There is no
+  // need to wait for it to run either: a spthread_suspend that
+  // comes first takes the continue back (see above)
+  int expected = SPTHREAD_SUSPENDED_STATE;
+  if (atomic_compare_exchange_strong(&thread.meta->state, &expected,
+                                     SPTHREAD_RESUMING_STATE)) {
+    futex_wake(&thread.meta->state);
+  }
 
-    nanosleep(&t, NULL);
+  // otherwise already running or exited, nothing to do
+  return 0;
+}
 
-    // fprintf(stderr, "susp checking...\n");
-    pthread_mutex_lock(&args.shutup_mutex);
+long long spthread_resumed_ns(spthread_t thread) {
+  return atomic_load(&thread.meta->resumed_ns);
+}
 
-    if (thread.meta->state == SPTHREAD_TERMINATED_STATE) {
-      // child called exit, can break
-      break;
-    }
-  }
-  pthread_mutex_unlock(&args.shutup_mutex);
-  pthread_mutex_destroy(&args.shutup_mutex);
-  return ret;
+int spthread_set_timeslice([[maybe_unused]] long usec) {
+  // a thread runs until whoever continued it suspends it
+  return 0;
 }
 
 int spthread_cancel(spthread_t thread) {
+  if (!is_current(thread)) {
+    return ESRCH;
+  }
   return pthread_cancel(thread.thread);
 }
 
@@ -301,15 +435,13 @@ bool spthread_self(spthread_t* thread) {
   *thread = (spthread_t){
       .thread = pthread_self(),
       .meta = my_meta,
+      .generation = atomic_load(&my_meta->generation),
   };
   return true;
 }
 
 int spthread_join(spthread_t thread, void** retval) {
-  int res = pthread_join(thread.thread, retval);
-  pthread_mutex_destroy(&thread.meta->meta_mutex);
-  free(thread.meta);
-  return res;
+  return join_thread(thread.meta, retval);
 }
 
 void spthread_exit(void* status) {
@@ -320,7 +452,8 @@ void spthread_exit(void* status) {
 }
 
 bool spthread_equal(spthread_t first, spthread_t second) {
-  return pthread_equal(first.thread, second.thread) && (first.meta == second.meta);
+  return pthread_equal(first.thread, second.thread) &&
+         first.meta == second.meta && first.generation == second.generation;
 }
 
 int spthread_disable_interrupts_self() {
@@ -362,76 +495,191 @@ int spthread_enable_interrupts_self() {
 ///////////////////////////////////////////////////////////////////////////////
 // helper definitions
 ///////////////////////////////////////////////////////////////////////////////
-#include <string.h>
-#include <stdio.h>
+static void futex_wait(_Atomic int* word, int expected) {
+  // returns right away if the word changed in the meantime
+  syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic int* word) {
+  syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void set_state(spthread_meta_t* meta, int state) {
+  atomic_store(&meta->state, state);
+  futex_wake(&meta->state);
+}
+
+static void wait_while_suspended(void) {
+  while (true) {
+    // waiting here replaces the sigsuspend that used to be the
+    // cancellation point of a suspended thread
+    pthread_testcancel();
+
+    if (atomic_load(&my_meta->release_requested)) {
+      // back to spthread_start, also from within the handler:
+      // a released thread is given up wherever it stopped
+      siglongjmp(my_meta->release_env, 1);
+    }
+
+    int state = SPTHREAD_RESUMING_STATE;
+    if (atomic_compare_exchange_strong(&my_meta->state, &state,
+                                       SPTHREAD_RUNNING_STATE)) {
+      // woken by spthread_continue; clock_gettime is
+      // async-signal-safe
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      atomic_store(&my_meta->resumed_ns,
+                   (long long)now.tv_sec * 1000000000 + now.tv_nsec);
+      return;
+    }
+    if (state != SPTHREAD_SUSPENDED_STATE) {
+      return;
+    }
+    // a deferred pthread_cancel doesn't wake the futex, so a cancel
+    // that comes in after the testcancel above would be missed. Only
+    // the syscall itself is asynchronously cancelable
+    int old_type;
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &old_type);
+    futex_wait(&my_meta->state, state);
+    pthread_setcanceltype(old_type, NULL);
+  }
+}
 
 static void sigpthd_handler(int signum,
-                            siginfo_t* info,
+                            [[maybe_unused]] siginfo_t* info,
                             [[maybe_unused]] void* ucontext) {
-  //  since suspended is a volatile thread_local primitve,
-  //  it should be safe to access from handler
+  //  since the meta fields are lock free atomics,
+  //  they are safe to access from the handler
   if (signum != SIGPTHD) {
     // ignore non SIGPTHD signals
     return;
   }
 
-  if (info->si_code == SI_TKILL) {
-    // this is an ack message
+  if (atomic_exchange(&my_meta->suspend_requested, 0) == 0) {
+    // not a suspend request, e.g. a stray SIGPTHD
     return;
   }
 
-  if (info->si_code != SI_QUEUE) {
-    char* msg =
-        "ERROR: got a sigpthd signal that is not SI_QUEUE or SI_TKILL\nPLEASE CONTACT COURSE STAFF\n";
-    write(STDERR_FILENO, msg, strlen(msg));
-    char buf[1024];
-    snprintf(buf, 1024, "SI_TKILL %d\tSI_QUEUE %d\tACTUAL %d\n", SI_TKILL,
-             SI_QUEUE, info->si_code);
-    write(STDERR_FILENO, buf, strlen(buf));
-    exit(EXIT_FAILURE);
+  // every signal is blocked while the handler runs (see
+  // spthread_start), so the thread stays put until continued.
+  // futex(2) is a raw system call, safe to use from a handler
+  int saved_errno = errno;
+  set_state(my_meta, SPTHREAD_SUSPENDED_STATE);
+  wait_while_suspended();
+  errno = saved_errno;
+}
+
+static int start_thread(spthread_meta_t* meta, size_t stack_size) {
+  int ret = spthread_stack_alloc(stack_size, &meta->stack);
+  if (ret != 0) {
+    return ret;
+  }
 
-    return;
+  // the host thread runs on our stack, so pthread adds no guard page or
+  // stack of its own
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, spthread_stack_bottom(meta->stack),
+                        meta->stack.size);
+
+  spthread_fwd_args* fwd_args = malloc(sizeof(spthread_fwd_args));
+  if (fwd_args == NULL) {
+    pthread_attr_destroy(&attr);
+    spthread_stack_free(meta->stack);
+    return EAGAIN;
   }
+  *fwd_args = (spthread_fwd_args){
+      .setup_done = false,
+      .child_meta = meta,
+  };
 
-  spthread_signal_args* args =
-      ((spthread_signal_args*)info->si_value.sival_ptr);
-  pthread_mutex_lock(&args->shutup_mutex);
-  int s_val = args->signal;
-
-  if (s_val == SPTHREAD_SIG_SUSPEND) {
-    my_meta->state = SPTHREAD_SUSPENDED_STATE;
-    args->ack = 1;
-    pthread_mutex_unlock(&args->shutup_mutex);
-    do {
-      // man 7 signal-saftey says
-      // this function is safe for signal handlers;
-      sigsuspend(&my_meta->suspend_set);
-    } while (my_meta->state == SPTHREAD_SUSPENDED_STATE);
-  } else if (s_val == SPTHREAD_SIG_CONTINUE) {
-    my_meta->state = SPTHREAD_RUNNING_STATE;
-    args->ack = 1;
-    pthread_mutex_unlock(&args->shutup_mutex);
-  } else {
-    pthread_mutex_unlock(&args->shutup_mutex);
+  ret = pthread_mutex_init(&(fwd_args->setup_mutex), NULL);
+  if (ret != 0) {
+    pthread_attr_destroy(&attr);
+    spthread_stack_free(meta->stack);
+    free(fwd_args);
+    return EAGAIN;
+  }
+
+  ret = pthread_cond_init(&(fwd_args->setup_cond), NULL);
+  if (ret != 0) {
+    pthread_attr_destroy(&attr);
+    spthread_stack_free(meta->stack);
+    pthread_mutex_destroy(&(fwd_args->setup_mutex));
+    free(fwd_args);
+    return EAGAIN;
+  }
+
+  atomic_init(&meta->generation, atomic_fetch_add(&next_generation, 1));
+  int result = pthread_create(&meta->pthread, &attr, spthread_start, fwd_args);
+  pthread_attr_destroy(&attr);
+
+  if (result == 0) {
+    pthread_mutex_lock(&(fwd_args->setup_mutex));
+    while (fwd_args->setup_done == false) {
+      pthread_cond_wait(&(fwd_args->setup_cond), &(fwd_args->setup_mutex));
+    }
+    pthread_mutex_unlock(&(fwd_args->setup_mutex));
   }
+
+  pthread_cond_destroy(&(fwd_args->setup_cond));
+  pthread_mutex_destroy(&(fwd_args->setup_mutex));
+  free(fwd_args);
+  if (result != 0) {
+    spthread_stack_free(meta->stack);
+  }
+  return result;
+}
+
+static int join_thread(spthread_meta_t* meta, void** retval) {
+  int res = pthread_join(meta->pthread, retval);
+  if (res == 0) {
+    // the thread is gone, so nothing runs on its stack anymore
+    spthread_stack_free(meta->stack);
+  }
+  pthread_mutex_destroy(&meta->meta_mutex);
+  free(meta);
+  return res;
+}
+
+static void park_self(void) {
+  pthread_mutex_lock(&pool_mutex);
+  pool_returning--;
+  my_meta->next_parked = pool_head;
+  pool_head = my_meta;
+  pool_len++;
+  set_state(my_meta, SPTHREAD_PARKED_STATE);
+  pthread_mutex_unlock(&pool_mutex);
+
+  int state;
+  while ((state = atomic_load(&my_meta->state)) == SPTHREAD_PARKED_STATE) {
+    futex_wait(&my_meta->state, state);
+  }
+}
+
+static bool is_current(spthread_t thread) {
+  return atomic_load(&thread.meta->generation) == thread.generation;
 }
 
 static void* spthread_start(void* arg) {
   spthread_fwd_args* args = (spthread_fwd_args*)arg;
-  spthread_fwd_args func = *args;
   void* res = NULL;
 
-  // using sigaction so that we can also send a value
-  // with sig_queue
+  // every signal is blocked while the handler runs, so a
+  // suspended thread can't run host signal handlers
   struct sigaction action = {0};  // 0 init (zero out the struct)
   action.sa_sigaction = &sigpthd_handler;
   action.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigfillset(&action.sa_mask);
   sigaction(SIGPTHD, &action, NULL);
 
   my_meta = args->child_meta;
 
   sigfillset(&my_meta->suspend_set);
-  sigdelset(&my_meta->suspend_set, SIGPTHD);
+  atomic_init(&my_meta->suspend_requested, 0);
+  atomic_init(&my_meta->resumed_ns, 0);
+  atomic_init(&my_meta->release_requested, 0);
+  atomic_init(&my_meta->releasable, 0);
 
   pthread_mutex_init(&my_meta->meta_mutex, NULL);
 
@@ -439,19 +687,37 @@ static void* spthread_start(void* arg) {
 
   // let spthread_create caller know that
   // we finished setup
+  sigset_t old_set;
+  pthread_sigmask(SIG_SETMASK, &my_meta->suspend_set, &old_set);
+  // a thread started for the pool parks right away
+  bool parked = my_meta->routine == NULL;
+  if (parked) {
+    pthread_mutex_lock(&pool_mutex);
+    pool_returning++;
+    pthread_mutex_unlock(&pool_mutex);
+  }
   pthread_mutex_lock(&(args->setup_mutex));
   args->setup_done = true;
-  my_meta->state = SPTHREAD_SUSPENDED_STATE;
+  atomic_init(&my_meta->state, SPTHREAD_SUSPENDED_STATE);
   pthread_cond_broadcast(&(args->setup_cond));
   pthread_mutex_unlock(&(args->setup_mutex));
 
-  // suspend our selves till the scheduler runs us
-  do {
-    sigsuspend(&my_meta->suspend_set);
-  } while (my_meta->state == SPTHREAD_SUSPENDED_STATE);
+  // a released thread comes back here, with every signal blocked
+  // again, to wait in the pool for its next routine
+  if (sigsetjmp(my_meta->release_env, 1) != 0 || parked) {
+    atomic_store(&my_meta->release_requested, 0);
+    park_self();
+  }
+
+  // suspend our selves till the scheduler runs us. Nothing has run
+  // yet, so the thread can still be given back to the pool
+  atomic_store(&my_meta->releasable, 1);
+  wait_while_suspended();
+  atomic_store(&my_meta->releasable, 0);
+  pthread_sigmask(SIG_SETMASK, &old_set, NULL);
 
   // run the desired function
-  res = func.actual_routine(func.actual_arg);
+  res = my_meta->routine(my_meta->arg);
 
   pthread_cleanup_pop(1);
 
@@ -466,5 +732,8 @@ static void mark_self_terminated(void* arg) {
   sigaddset(&mask, SIGPTHD);
   pthread_sigmask(SIG_BLOCK, &mask, NULL);
 
-  my_meta->state = SPTHREAD_TERMINATED_STATE;
-}
\ No newline at end of file
+  // wakes a suspend or continue waiting for an ack
+  set_state(my_meta, SPTHREAD_TERMINATED_STATE);
+}
+
+#endif  // SPTHREAD_GREEN
@@ -3,6 +3,7 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 // CAUTION: according to `man 7 pthread`:
 //
@@ -18,6 +19,15 @@
 // to suspend and continue a spthread
 #define SIGPTHD SIGUSR1
 
+// BACKENDS: by default (spthread.c) every spthread is a host pthread that
+// is suspended and continued through SIGPTHD and a futex. Building with
+// SPTHREAD_GREEN defined (make SPTHREAD=green) selects spthread_green.c
+// instead, where spthreads are user-level contexts multiplexed on the one
+// host thread that continues them: spthread_continue switches into the
+// thread and returns once its time slice (see spthread_set_timeslice) ran
+// out, or it suspended itself or exited. The API below is the same for
+// both; differences are noted where they matter.
+
 // declares a struct, but the internals of the
 // struct cannot be seen by functions outside of spthread.c
 typedef struct spthread_meta_st spthread_meta_t;
@@ -28,6 +38,7 @@ typedef struct spthread_meta_st spthread_meta_t;
 typedef struct spthread_st {
   pthread_t thread;
   spthread_meta_t* meta;
+  unsigned generation;  // tells apart the owners of a reused thread
 } spthread_t;
 
 // NOTE:
@@ -60,11 +71,72 @@ int spthread_create(spthread_t* thread,
                     void* (*start_routine)(void*),
                     void* arg);
 
+// STACKS: spthread maps every thread's stack itself, with a guard page
+// below it so that an overflow faults, and reuses the stacks of joined
+// threads. A thread created with a NULL attr gets the default stack size;
+// of a non-NULL attr only the stack size (pthread_attr_setstacksize) is
+// used. Both backends do this.
+#define SPTHREAD_DEFAULT_STACKSIZE (64 * 1024)
+
+// Sets the stack size of threads created with a NULL attr from now on,
+// rounded up to whole pages.
+//
+// returns:
+// - 0 on success
+// - EINVAL if size is below PTHREAD_STACK_MIN
+int spthread_set_default_stacksize(size_t size);
+
+// THREAD POOL: spthread_release gives a finished spthread back to a pool
+// of parked host threads instead of ending it, and spthread_create hands
+// the next routine to a parked thread with the same stack size before it
+// creates a new one. That skips pthread_create and its setup handshake,
+// and the cancel and join of the old thread. The pool is empty until
+// spthread_pool_init.
+
+// Pre-creates parked threads, with the default stack size, until the pool
+// holds size of them, and lets spthread_release keep up to size threads
+// parked. A size of 0 turns pooling off.
+//
+// returns:
+// - 0 on success
+// - EINVAL if size is negative
+// - EAGAIN if a thread could not be created
+int spthread_pool_init(int size);
+
+// Ends every parked thread and empties the pool.
+void spthread_pool_destroy();
+
+// Stops the specified thread wherever it is suspended (like
+// spthread_cancel, but without running cleanup handlers) and parks it
+// in the pool. Only a thread that never ran, or that was suspended while
+// spthread_set_releasable_self said so, is parked: one stopped at an arbitrary
+// point may hold libc locks (malloc, stdio) that the next routine would
+// deadlock on. Any other thread, or one released while the pool is full
+// or after it exited, is cancelled and joined instead. Either way the
+// handle must not be used again, and no spthread_join is needed.
+//
+// The green backend has nothing worth pooling: it always cancels and
+// joins.
+//
+// returns:
+// - 0 on success
+// - ESRCH if the thread was already released
+int spthread_release(spthread_t thread);
+
+// Tells spthread_release whether the calling thread may be parked in the
+// pool if it is suspended from now on: pass true only while the thread
+// holds no locks wherever it could be stopped, e.g. while it waits to be
+// scheduled again, and false before it takes any again.
+void spthread_set_releasable_self(bool releasable);
+
 // The spthread_suspend function will signal to the
-// specified thread to suspend execution.
+// specified thread to suspend execution, and returns once
+// it has stopped. The thread waits on a futex until continued.
 //
 // Calling spthread_suspend on an already suspended
-// thread does not do anything.
+// thread does not do anything. Calling it on a thread that
+// was continued but has not started running yet takes the
+// continue back.
 //
 // It is worth noting that this function is not signal safe.
 // In other words, it should not be called from a signal handler.
@@ -92,8 +164,10 @@ int spthread_suspend(spthread_t thread);
 // - ESRCH if the calling thread is not an spthread
 int spthread_suspend_self();
 
-// The spthread_continue function will signal to the
+// The spthread_continue function will wake the
 // specified thread to resume execution if suspended.
+// No signal is sent, and it returns without waiting for
+// the thread to actually run (see spthread_resumed_ns).
 //
 // Calling spthread_continue on an already non-suspended
 // thread does not do anything.
@@ -113,9 +187,30 @@ int spthread_suspend_self();
 // - ESRCH if the thread specified is not a valid pthread
 int spthread_continue(spthread_t thread);
 
+// Returns when the specified thread last started running
+// after a spthread_continue, in nanoseconds of CLOCK_MONOTONIC,
+// or 0 if it never has. Used to measure how long a thread
+// takes to run once continued.
+long long spthread_resumed_ns(spthread_t thread);
+
+// Sets how long a thread may run after a spthread_continue before it
+// is preempted. Only the green backend preempts on its own: with the
+// pthread backend this does nothing, since a thread runs until
+// whoever continued it suspends it.
+//
+// returns:
+// - 0 on success
+// - EINVAL if usec is not positive
+int spthread_set_timeslice(long usec);
+
 // The spthread_cancel function will send a
 // cancellation request to the specified thread.
 //
+// With the green backend there are no cancellation points: a
+// cancelled thread exits the next time it is continued, and
+// spthread_join frees one that is still suspended right away,
+// without running its cleanup handlers.
+//
 // as of now, this function is identical to pthread_cancel(3)
 // so to avoid repitition, you should look there.
 //
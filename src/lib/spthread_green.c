@@ -0,0 +1,544 @@
+// The green threads backend of spthread, built when SPTHREAD_GREEN is
+// defined (make SPTHREAD=green). It implements the same API as spthread.c,
+// but an spthread is a user-level context with its own stack instead of a
+// host thread. All of them are multiplexed on the one host thread that
+// continues them (the PennOS scheduler): spthread_continue switches straight
+// into the thread and returns once it is switched out again, because its
+// time slice ran out, it suspended itself or it exited.
+//
+// A switch saves the callee-saved registers and swaps stack pointers, with
+// no system call. Preemption comes from a timer that sends SIGPTHD to the
+// host thread; its handler switches out of the running thread. Blocking
+// SIGPTHD (e.g. in the kernel lock) therefore still keeps a thread from
+// being suspended, like it does in the pthread backend.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "./spthread.h"
+#include "./spthread_stack.h"
+
+#ifdef SPTHREAD_GREEN
+
+#ifndef __x86_64__
+#error "the green spthread backend only supports x86-64"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// definitions and globals
+///////////////////////////////////////////////////////////////////////////////
+
+// function potiner to a function
+// that takes a void* and returns a void*
+typedef void* (*pthread_fn)(void*);
+
+#define GREEN_TIMESLICE_NS 10000000    // 10 ms until spthread_set_timeslice
+#define GREEN_RETRY_NS 20000           // retry delay of a deferred preemption
+#define MXCSR_DEFAULT 0x1F80           // sse control word at process start
+#define FPU_CW_DEFAULT 0x037F          // x87 control word at process start
+
+// meta information necessary for
+// spthread to work
+typedef struct spthread_meta_st {
+  // the stack pointer the thread was switched out at. The
+  // registers it needs to continue are saved on top of it
+  void* sp;
+
+  // the mmap'd stack, with its guard page
+  spthread_stack_t stack;
+
+  // what the thread runs, and what it returned
+  pthread_fn routine;
+  void* arg;
+  void* retval;
+
+  // current state of the spthread
+  // 0 = running (the host thread is running it)
+  // 1 = suspended
+  // 2 = exited
+  int state;
+
+  // set by spthread_cancel. The thread exits the next time
+  // it is switched back in
+  bool canceled;
+
+  // when the thread last started running after a continue,
+  // and when that time slice ends, in ns of CLOCK_MONOTONIC
+  long long resumed_ns;
+  long long deadline_ns;
+
+  // unique per thread, since a freed meta's address may be reused
+  unsigned generation;
+} spthread_meta_t;
+
+// Defines the various states
+// an spthread is in
+#define SPTHREAD_RUNNING_STATE 0
+#define SPTHREAD_SUSPENDED_STATE 1
+#define SPTHREAD_TERMINATED_STATE 2
+
+// the thread the host thread is running, or NULL while it runs its own
+// code (e.g. the scheduler). Only ever touched by the host thread and
+// its SIGPTHD handler
+static spthread_meta_t* volatile running = NULL;
+
+// set for the few instructions where a switch is half done, during
+// which the SIGPTHD handler must not switch
+static volatile sig_atomic_t switching = 0;
+
+// the stack pointer of the host thread's own code while it runs a thread
+static void* host_sp = NULL;
+
+// the mask the host thread had when its thread was preempted. The handler
+// runs with every signal blocked, which the host must not inherit
+static sigset_t host_mask;
+static volatile sig_atomic_t restore_host_mask = false;
+
+// the preemption timer, which sends SIGPTHD to the host thread
+static timer_t preempt_timer;
+static bool timer_ready = false;
+static volatile long long armed_until = 0;  // 0 when disarmed
+
+static long long timeslice_ns = GREEN_TIMESLICE_NS;
+
+static unsigned next_generation = 1;
+
+// the bounds of the program's own code, from the linker
+extern char __executable_start[];
+extern char etext[];
+
+///////////////////////////////////////////////////////////////////////////////
+// helper declarations
+///////////////////////////////////////////////////////////////////////////////
+
+// saves the callee-saved registers and control words on the current stack,
+// stores the stack pointer in *save_sp, then restores them from load_sp and
+// returns into that context. Defined in assembly below
+void spthread_green_switch(void** save_sp, void* load_sp);
+
+// handler for SIGPTHD to preempt the running thread
+static void sigpthd_handler(int signum, siginfo_t*, void*);
+
+// the function a new thread is first switched into. Runs the routine
+// then exits the thread
+static void green_start(void);
+
+// switches from the running thread back to the host thread's own code,
+// leaving it in the given state. Returns once it is continued again
+static void switch_out(spthread_meta_t* self, int state);
+
+// exits the running thread. Does not return
+static void green_exit(spthread_meta_t* self, void* status);
+
+// creates the preemption timer on the calling (host) thread
+static int setup_timer(void);
+
+// (re)arms the preemption timer to fire in ns nanoseconds
+static void arm_timer(long long ns);
+
+// whether a thread interrupted at the given context can be switched out.
+// Our own code can, but host library code may hold a lock (malloc) that
+// the next thread would then deadlock on
+static bool at_safe_point(const ucontext_t* context);
+
+static long long now_ns(void);
+
+__asm__(
+    ".text\n"
+    ".globl spthread_green_switch\n"
+    ".hidden spthread_green_switch\n"
+    ".type spthread_green_switch, @function\n"
+    "spthread_green_switch:\n"
+    "  pushq %rbp\n"
+    "  pushq %rbx\n"
+    "  pushq %r12\n"
+    "  pushq %r13\n"
+    "  pushq %r14\n"
+    "  pushq %r15\n"
+    "  subq $8, %rsp\n"
+    "  stmxcsr (%rsp)\n"
+    "  fnstcw 4(%rsp)\n"
+    "  movq %rsp, (%rdi)\n"
+    "  movq %rsi, %rsp\n"
+    "  ldmxcsr (%rsp)\n"
+    "  fldcw 4(%rsp)\n"
+    "  addq $8, %rsp\n"
+    "  popq %r15\n"
+    "  popq %r14\n"
+    "  popq %r13\n"
+    "  popq %r12\n"
+    "  popq %rbx\n"
+    "  popq %rbp\n"
+    "  ret\n"
+    ".size spthread_green_switch, .-spthread_green_switch\n");
+
+///////////////////////////////////////////////////////////////////////////////
+// public function definitions
+///////////////////////////////////////////////////////////////////////////////
+
+int spthread_create(spthread_t* thread,
+                    const pthread_attr_t* attr,
+                    pthread_fn start_routine,
+                    void* arg) {
+  static bool handler_ready = false;
+  if (!handler_ready) {
+    // every signal is blocked while the handler runs, the
+    // host thread gets its mask back once switched to
+    struct sigaction action = {0};  // 0 init (zero out the struct)
+    action.sa_sigaction = &sigpthd_handler;
+    action.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigfillset(&action.sa_mask);
+    sigaction(SIGPTHD, &action, NULL);
+    handler_ready = true;
+  }
+
+  size_t stack_size;
+  int ret = spthread_stack_size(attr, &stack_size);
+  if (ret != 0) {
+    return ret;
+  }
+
+  spthread_meta_t* meta = malloc(sizeof(spthread_meta_t));
+  if (meta == NULL) {
+    return EAGAIN;
+  }
+
+  spthread_stack_t stack;
+  ret = spthread_stack_alloc(stack_size, &stack);
+  if (ret != 0) {
+    free(meta);
+    return ret;
+  }
+
+  // lay out the frame spthread_green_switch pops: control words, six
+  // zeroed registers, then green_start as the return address. The slot
+  // above it stands in for green_start's own return address, which
+  // leaves the stack aligned the way a called function expects
+  uintptr_t top =
+      ((uintptr_t)spthread_stack_bottom(stack) + stack.size) & ~(uintptr_t)15;
+  uint64_t* frame = (uint64_t*)top - 9;
+  uint32_t* control = (uint32_t*)frame;
+  control[0] = MXCSR_DEFAULT;
+  control[1] = FPU_CW_DEFAULT;
+  for (int i = 1; i <= 6; i++) {
+    frame[i] = 0;
+  }
+  frame[7] = (uint64_t)(uintptr_t)green_start;
+  frame[8] = 0;
+
+  *meta = (spthread_meta_t){
+      .sp = frame,
+      .stack = stack,
+      .routine = start_routine,
+      .arg = arg,
+      .state = SPTHREAD_SUSPENDED_STATE,
+      .generation = next_generation++,
+  };
+
+  *thread = (spthread_t){
+      .thread = pthread_self(),
+      .meta = meta,
+      .generation = meta->generation,
+  };
+
+  return 0;
+}
+
+int spthread_suspend(spthread_t thread) {
+  if (thread.meta == running) {
+    return spthread_suspend_self();
+  }
+
+  // any other thread is already switched out; it doesn't run
+  // again until the host thread continues it
+  return 0;
+}
+
+int spthread_suspend_self() {
+  spthread_meta_t* self = running;
+  if (self == NULL) {
+    return ESRCH;
+  }
+
+  switch_out(self, SPTHREAD_SUSPENDED_STATE);
+  return 0;
+}
+
+int spthread_continue(spthread_t thread) {
+  spthread_meta_t* meta = thread.meta;
+
+  if (running != NULL) {
+    // only the host thread's own code runs threads. A thread
+    // continuing another (or itself) has nothing to do, since
+    // that one runs as soon as the host thread continues it
+    return 0;
+  }
+
+  if (meta->state != SPTHREAD_SUSPENDED_STATE) {
+    // already exited, nothing to do
+    return 0;
+  }
+
+  if (!timer_ready && setup_timer() != 0) {
+    return EAGAIN;
+  }
+
+  // the timer only needs re-arming if it would fire after this time
+  // slice ends; one that fires earlier is re-armed by the handler for
+  // the rest of the slice. Continues within a slice need no syscall
+  switching = 1;
+  long long now = now_ns();
+  meta->resumed_ns = now;
+  meta->deadline_ns = now + timeslice_ns;
+  if (armed_until == 0 || armed_until > meta->deadline_ns) {
+    arm_timer(timeslice_ns);
+  }
+
+  meta->state = SPTHREAD_RUNNING_STATE;
+  running = meta;
+  spthread_green_switch(&host_sp, meta->sp);
+
+  // the thread was switched out again
+  running = NULL;
+  switching = 0;
+  if (restore_host_mask) {
+    restore_host_mask = false;
+    pthread_sigmask(SIG_SETMASK, &host_mask, NULL);
+  }
+  return 0;
+}
+
+long long spthread_resumed_ns(spthread_t thread) {
+  return thread.meta->resumed_ns;
+}
+
+int spthread_set_timeslice(long usec) {
+  if (usec <= 0) {
+    return EINVAL;
+  }
+  timeslice_ns = (long long)usec * 1000;
+  return 0;
+}
+
+int spthread_cancel(spthread_t thread) {
+  // there is no cancellation point to wait for: a switched out
+  // thread is exited the next time it is continued, or simply
+  // thrown away by spthread_join
+  thread.meta->canceled = true;
+  return 0;
+}
+
+bool spthread_self(spthread_t* thread) {
+  spthread_meta_t* self = running;
+  if (self == NULL) {
+    return false;
+  }
+  *thread = (spthread_t){
+      .thread = pthread_self(),
+      .meta = self,
+      .generation = self->generation,
+  };
+  return true;
+}
+
+int spthread_join(spthread_t thread, void** retval) {
+  spthread_meta_t* meta = thread.meta;
+
+  while (meta->state != SPTHREAD_TERMINATED_STATE && !meta->canceled) {
+    if (running != NULL) {
+      // only the host thread's own code can run it to its end
+      return EDEADLK;
+    }
+    spthread_continue(thread);
+  }
+
+  if (retval != NULL) {
+    *retval = meta->state == SPTHREAD_TERMINATED_STATE ? meta->retval
+                                                       : PTHREAD_CANCELED;
+  }
+  spthread_stack_free(meta->stack);
+  free(meta);
+  return 0;
+}
+
+int spthread_pool_init(int size) {
+  // creating a thread mostly reuses a stack from the free list, and
+  // nothing needs tearing down when it exits, so there is no pool
+  return size < 0 ? EINVAL : 0;
+}
+
+void spthread_pool_destroy() {}
+
+int spthread_release(spthread_t thread) {
+  spthread_cancel(thread);
+  return spthread_join(thread, NULL);
+}
+
+void spthread_set_releasable_self(bool releasable) {}
+
+void spthread_exit(void* status) {
+  spthread_meta_t* self = running;
+  if (self == NULL) {
+    pthread_exit(status);
+  }
+  green_exit(self, status);
+}
+
+bool spthread_equal(spthread_t first, spthread_t second) {
+  return first.meta == second.meta && first.generation == second.generation;
+}
+
+int spthread_disable_interrupts_self() {
+  sigset_t block_set;
+  int res = sigemptyset(&block_set);
+  if (res != 0) {
+    return res;
+  }
+  res = sigaddset(&block_set, SIGPTHD);
+  if (res != 0) {
+    return res;
+  }
+  res = pthread_sigmask(SIG_BLOCK, &block_set, NULL);
+  if (res != 0) {
+    return res;
+  }
+  return 0;
+}
+
+// -1 on error
+//  0 on success
+int spthread_enable_interrupts_self() {
+  sigset_t block_set;
+  int res = sigemptyset(&block_set);
+  if (res != 0) {
+    return res;
+  }
+  res = sigaddset(&block_set, SIGPTHD);
+  if (res != 0) {
+    return res;
+  }
+  res = pthread_sigmask(SIG_UNBLOCK, &block_set, NULL);
+  if (res != 0) {
+    return res;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// helper definitions
+///////////////////////////////////////////////////////////////////////////////
+
+static void green_start(void) {
+  spthread_meta_t* self = running;
+  switching = 0;
+
+  void* res = PTHREAD_CANCELED;
+  if (!self->canceled) {
+    res = self->routine(self->arg);
+  }
+  green_exit(self, res);
+}
+
+static void switch_out(spthread_meta_t* self, int state) {
+  switching = 1;
+  self->state = state;
+  spthread_green_switch(&self->sp, host_sp);
+
+  // continued again
+  switching = 0;
+  if (self->canceled) {
+    green_exit(self, PTHREAD_CANCELED);
+  }
+}
+
+static void green_exit(spthread_meta_t* self, void* status) {
+  self->retval = status;
+  switch_out(self, SPTHREAD_TERMINATED_STATE);
+  abort();  // an exited thread is never continued
+}
+
+static void sigpthd_handler(int signum,
+                            [[maybe_unused]] siginfo_t* info,
+                            void* context) {
+  if (signum != SIGPTHD) {
+    // ignore non SIGPTHD signals
+    return;
+  }
+
+  // timer_settime and clock_gettime are async-signal-safe
+  int saved_errno = errno;
+  armed_until = 0;
+  spthread_meta_t* self = running;
+
+  if (switching) {
+    // in the middle of a switch, try again shortly
+    arm_timer(GREEN_RETRY_NS);
+  } else if (self != NULL) {
+    long long now = now_ns();
+    if (now < self->deadline_ns) {
+      // armed for an earlier slice that ended early
+      arm_timer(self->deadline_ns - now);
+    } else if (!at_safe_point(context)) {
+      arm_timer(GREEN_RETRY_NS);
+    } else {
+      host_mask = ((ucontext_t*)context)->uc_sigmask;
+      restore_host_mask = true;
+      switch_out(self, SPTHREAD_SUSPENDED_STATE);
+    }
+  }
+
+  errno = saved_errno;
+}
+
+static bool at_safe_point(const ucontext_t* context) {
+  const unsigned char* ip =
+      (const unsigned char*)context->uc_mcontext.gregs[REG_RIP];
+  if (ip >= (unsigned char*)__executable_start &&
+      ip < (unsigned char*)etext) {
+    return true;
+  }
+
+  // a read or write blocked in the host kernel (e.g. the shell waiting
+  // for input) is rewound to its syscall instruction, and restarts once
+  // the thread is continued. No lock is held across those
+  long nr = context->uc_mcontext.gregs[REG_RAX];
+  return ip[0] == 0x0f && ip[1] == 0x05 && (nr == SYS_read || nr == SYS_write);
+}
+
+static int setup_timer(void) {
+  struct sigevent event = {0};
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGPTHD;
+  event._sigev_un._tid = (pid_t)syscall(SYS_gettid);  // no glibc macro
+  if (timer_create(CLOCK_MONOTONIC, &event, &preempt_timer) != 0) {
+    return -1;
+  }
+  timer_ready = true;
+  return 0;
+}
+
+static void arm_timer(long long ns) {
+  struct itimerspec spec = {
+      .it_value = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000},
+  };
+  armed_until = now_ns() + ns;
+  timer_settime(preempt_timer, 0, &spec, NULL);
+}
+
+static long long now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#endif  // SPTHREAD_GREEN
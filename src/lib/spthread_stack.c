@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "./spthread.h"
+#include "./spthread_stack.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// definitions and globals
+///////////////////////////////////////////////////////////////////////////////
+
+// a stack on the free list. The node lives at the bottom of the
+// stack itself, so keeping a stack costs no extra memory
+typedef struct free_stack_st {
+  spthread_stack_t stack;
+  struct free_stack_st* next;
+} free_stack_t;
+
+static pthread_mutex_t stack_mutex = PTHREAD_MUTEX_INITIALIZER;
+static free_stack_t* free_stacks = NULL;
+static int num_free_stacks = 0;
+static size_t default_stacksize = SPTHREAD_DEFAULT_STACKSIZE;
+
+///////////////////////////////////////////////////////////////////////////////
+// helper declarations
+///////////////////////////////////////////////////////////////////////////////
+
+// rounds size up to whole pages
+static size_t page_round(size_t size);
+
+///////////////////////////////////////////////////////////////////////////////
+// function definitions
+///////////////////////////////////////////////////////////////////////////////
+
+int spthread_set_default_stacksize(size_t size) {
+  if (size < PTHREAD_STACK_MIN) {
+    return EINVAL;
+  }
+  pthread_mutex_lock(&stack_mutex);
+  default_stacksize = page_round(size);
+  pthread_mutex_unlock(&stack_mutex);
+  return 0;
+}
+
+int spthread_stack_size(const pthread_attr_t* attr, size_t* size) {
+  size_t wanted;
+  if (attr == NULL) {
+    pthread_mutex_lock(&stack_mutex);
+    wanted = default_stacksize;
+    pthread_mutex_unlock(&stack_mutex);
+  } else if (pthread_attr_getstacksize(attr, &wanted) != 0) {
+    return EINVAL;
+  }
+
+  if (wanted < PTHREAD_STACK_MIN) {
+    return EINVAL;
+  }
+  *size = page_round(wanted);
+  return 0;
+}
+
+int spthread_stack_alloc(size_t size, spthread_stack_t* stack) {
+  // stacks mostly all have the default size, so the first
+  // match is usually the head
+  pthread_mutex_lock(&stack_mutex);
+  for (free_stack_t** link = &free_stacks; *link != NULL;
+       link = &(*link)->next) {
+    if ((*link)->stack.size == size) {
+      *stack = (*link)->stack;
+      *link = (*link)->next;
+      num_free_stacks--;
+      pthread_mutex_unlock(&stack_mutex);
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&stack_mutex);
+
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  void* base = mmap(NULL, size + page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE,
+                    -1, 0);
+  if (base == MAP_FAILED) {
+    return EAGAIN;
+  }
+  if (mprotect(base, page_size, PROT_NONE) != 0) {
+    munmap(base, size + page_size);
+    return EAGAIN;
+  }
+
+  *stack = (spthread_stack_t){.base = base, .size = size};
+  return 0;
+}
+
+void spthread_stack_free(spthread_stack_t stack) {
+  pthread_mutex_lock(&stack_mutex);
+  bool keep = num_free_stacks < SPTHREAD_STACK_CACHE;
+  if (keep) {
+    free_stack_t* node = spthread_stack_bottom(stack);
+    node->stack = stack;
+    node->next = free_stacks;
+    free_stacks = node;
+    num_free_stacks++;
+  }
+  pthread_mutex_unlock(&stack_mutex);
+
+  if (!keep) {
+    munmap(stack.base, stack.size + (size_t)sysconf(_SC_PAGESIZE));
+  }
+}
+
+void* spthread_stack_bottom(spthread_stack_t stack) {
+  return (char*)stack.base + sysconf(_SC_PAGESIZE);
+}
+
+static size_t page_round(size_t size) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  return (size + page_size - 1) / page_size * page_size;
+}
@@ -0,0 +1,48 @@
+#ifndef SPTHREAD_STACK_H_
+#define SPTHREAD_STACK_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Stacks for spthreads, shared by both backends (spthread.c and
+// spthread_green.c). Not part of the spthread API: include spthread.h.
+//
+// Every stack is mmap'd with one PROT_NONE guard page below it, so an
+// overflow faults right away instead of running into whatever is mapped
+// below. Freed stacks go on a free list, up to SPTHREAD_STACK_CACHE of
+// them, so that creating a thread usually reuses a mapping.
+
+#define SPTHREAD_STACK_CACHE 256  // most free stacks kept for reuse
+
+typedef struct spthread_stack_st {
+  void* base;   // start of the mapping, which is the guard page
+  size_t size;  // usable bytes, above the guard page
+} spthread_stack_t;
+
+// Finds the stack size a thread created with attr gets: the stack size
+// of attr (see pthread_attr_setstacksize), or the default one (see
+// spthread_set_default_stacksize) if attr is NULL. Rounded up to whole
+// pages.
+//
+// returns:
+// - 0 on success
+// - EINVAL if the size is below PTHREAD_STACK_MIN
+int spthread_stack_size(const pthread_attr_t* attr, size_t* size);
+
+// Takes a stack of the given (page rounded) size from the free list,
+// or maps a new one.
+//
+// returns:
+// - 0 on success
+// - EAGAIN if no memory could be mapped
+int spthread_stack_alloc(size_t size, spthread_stack_t* stack);
+
+// Gives a stack no thread runs on anymore back to the free list, or
+// unmaps it if the free list is full.
+void spthread_stack_free(spthread_stack_t stack);
+
+// Returns the lowest usable address of the stack, just above its guard
+// page.
+void* spthread_stack_bottom(spthread_stack_t stack);
+
+#endif  // SPTHREAD_STACK_H_
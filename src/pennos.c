@@ -1,38 +1,135 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "fs/fs_syscalls.h"
 #include "kernel/kern_sys_calls.h"
+#include "kernel/msg.h"
+#include "kernel/pcb_alloc.h"
+#include "kernel/sched_policy.h"
+#include "kernel/sched_stats.h"
 #include "kernel/scheduler.h"
+#include "kernel/tty.h"
 #include "shell/builtins.h"
 #include "lib/pennos-errno.h"
+#include "lib/spthread.h"
 #include "fs/fat_routines.h"
 
+#define DEFAULT_THREAD_POOL 16      // parked host threads kept for s_spawn
+#define MAX_STACK_KB (1024 * 1024)  // largest default stack, 1 GiB
+
 extern int tick_counter;
 extern int log_fd;
 
+/**
+ * @brief Parses the numeric value of a boot option such as --cpus=N.
+ *
+ * @param value the text after the '='
+ * @param out   set to the value on success
+ * @return 0 on success, -1 if value is empty, isn't a whole number or
+ *         doesn't fit in a long
+ */
+static int parse_long_option(const char* value, long* out) {
+  char* endptr;
+  errno = 0;
+  long parsed = strtol(value, &endptr, 10);
+  if (endptr == value || *endptr != '\0' || errno != 0) {
+    return -1;
+  }
+  *out = parsed;
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
+  // split the boot options from the positional [fs] [log] arguments
+  char* positional[2] = {NULL, NULL};
+  int num_positional = 0;
+  long thread_pool = DEFAULT_THREAD_POOL;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--quantum-us=", 13) == 0) {
+      long quantum;
+      if (parse_long_option(argv[i] + 13, &quantum) == -1 ||
+          set_scheduler_quantum(quantum) == -1) {
+        P_ERRNO = P_EINVAL;
+        u_perror("invalid --quantum-us");
+        return -1;
+      }
+    } else if (strncmp(argv[i], "--cpus=", 7) == 0) {
+      long cpus;
+      if (parse_long_option(argv[i] + 7, &cpus) == -1 || cpus > MAX_CPUS ||
+          set_num_cpus((int)cpus) == -1) {
+        P_ERRNO = P_EINVAL;
+        u_perror("invalid --cpus");
+        return -1;
+      }
+    } else if (strncmp(argv[i], "--stack-kb=", 11) == 0) {
+      long stack_kb;
+      if (parse_long_option(argv[i] + 11, &stack_kb) == -1 || stack_kb <= 0 ||
+          stack_kb > MAX_STACK_KB ||
+          spthread_set_default_stacksize((size_t)stack_kb * 1024) != 0) {
+        P_ERRNO = P_EINVAL;
+        u_perror("invalid --stack-kb");
+        return -1;
+      }
+    } else if (strncmp(argv[i], "--pid-reuse-delay=", 18) == 0) {
+      long delay;
+      if (parse_long_option(argv[i] + 18, &delay) == -1 || delay > INT_MAX ||
+          set_pid_reuse_delay((int)delay) == -1) {
+        P_ERRNO = P_EINVAL;
+        u_perror("invalid --pid-reuse-delay");
+        return -1;
+      }
+    } else if (strncmp(argv[i], "--thread-pool=", 14) == 0) {
+      if (parse_long_option(argv[i] + 14, &thread_pool) == -1 ||
+          thread_pool < 0 || thread_pool > INT_MAX) {
+        P_ERRNO = P_EINVAL;
+        u_perror("invalid --thread-pool");
+        return -1;
+      }
+    } else if (strncmp(argv[i], "--sched=", 8) == 0) {
+      if (set_sched_policy(argv[i] + 8) == -1) {
+        u_perror("invalid --sched");
+        return -1;
+      }
+    } else if (num_positional < 2) {
+      positional[num_positional++] = argv[i];
+    }
+  }
+
   // mount the filesystem
-  if (argc < 2) {
+  if (positional[0] == NULL) {
     P_ERRNO = P_NEEDF;
     u_perror("need a pennfat file to mount");
     return -1;
   } else {
-    if (mount(argv[1]) == -1) {
+    if (mount(positional[0]) == -1) {
       u_perror("mount failed");
       return -1;
     }
   }
 
   // get the log fd
-  if (argc >= 3) {
-    log_fd = open(argv[2], O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (positional[1] != NULL) {
+    log_fd = open(positional[1], O_RDWR | O_CREAT | O_TRUNC, 0644);
   } else {
     log_fd = open("log/log", O_RDWR | O_CREAT | O_TRUNC, 0644);
   }
 
   // initialize scheduler architecture and init process
   initialize_scheduler_queues();
+  if (tty_init() == -1) {
+    u_perror("tty_init failed");
+    return -1;
+  }
+  msg_pool_init();
+  int pool_ret = spthread_pool_init((int)thread_pool);
+  if (pool_ret != 0) {
+    errno = pool_ret;
+    perror("spthread_pool_init failed");  // s_spawn still creates threads
+  }
 
   pid_t init_pid = s_spawn_init();
   if (init_pid == -1) {
@@ -42,9 +139,12 @@ int main(int argc, char* argv[]) {
   }
 
   scheduler();
+  sched_stats_dump(log_fd);
 
   // cleanup
+  tty_destroy();
   s_cleanup_init_process();
+  spthread_pool_destroy();
   free_scheduler_queues();
   unmount();
   close(log_fd);
@@ -89,6 +89,18 @@ void u_perror(const char *msg) {
     case P_EREDIR:
       error_msg = "input and output cannot be the same when appending";
       break;
+    case P_EAGAIN:
+      error_msg = "resource temporarily unavailable";
+      break;
+    case P_ESRCH:
+      error_msg = "no such process";
+      break;
+    case P_EPIPE:
+      error_msg = "broken pipe";
+      break;
+    case P_EDEADLK:
+      error_msg = "resource deadlock avoided";
+      break;
     default:
       error_msg = "Unknown error";
       break;
@@ -29,8 +29,8 @@
 #define MAX_BUFFER_SIZE 4096
 #define MAX_LINE_BUFFER_SIZE 128
 
-// Global variable to track foreground process for signal forwarding.
-extern pid_t current_fg_pid;
+// Global variable to track the foreground job's group for signal forwarding.
+extern pid_t current_fg_pgid;
 // Global job list and job counter (for background processes)
 Vec job_list;           // initialize in main; holds job pointers
 jid_t next_job_id = 1;  // global job id counter
@@ -47,10 +47,11 @@ int is_append = 0;
 
 // Signal handler for (Ctrl-C)
 void shell_sigint_handler(int sig) {
-  // If there's a foreground process, forward SIGINT (terminate) to it, as long
-  // as it's not the shell current_fg_pid will also never be 1 (INIT)
-  if (current_fg_pid != 2) {
-    s_kill(current_fg_pid, 2);  // P_SIGTERM
+  // If there's a foreground job, forward SIGINT (terminate) to its whole
+  // group, as long as it's not the shell's. current_fg_pgid will also never
+  // be 1 (INIT)
+  if (current_fg_pgid != 2) {
+    s_killpg(current_fg_pgid, P_SIGTERM);
   }
 
   if (s_write(STDOUT_FILENO, "\n", 1) == -1) {
@@ -60,9 +61,9 @@ void shell_sigint_handler(int sig) {
 
 // Signal handler for (Ctrl-Z)
 void shell_sigstp_handler(int sig) {
-  // If there's a foreground process, forward SIGTSTP (stop) to it
-  if (current_fg_pid != 2) {
-    s_kill(current_fg_pid, 0);  // P_SIGSTOP
+  // If there's a foreground job, forward SIGTSTP (stop) to its whole group
+  if (current_fg_pgid != 2) {
+    s_killpg(current_fg_pgid, P_SIGSTOP);
   }
 
   if (s_write(STDOUT_FILENO, "\n", 1) == -1) {
@@ -167,6 +168,9 @@ pid_t u_execute_command(struct parsed_command* cmd) {
                    output_fd_script);
   } else if (strcmp(cmd->commands[0][0], "ps") == 0) {
     return s_spawn(u_ps, cmd->commands[0], input_fd_script, output_fd_script);
+  } else if (strcmp(cmd->commands[0][0], "schedstat") == 0) {
+    return s_spawn(u_schedstat, cmd->commands[0], input_fd_script,
+                   output_fd_script);
   } else if (strcmp(cmd->commands[0][0], "kill") == 0) {
     return s_spawn(u_kill, cmd->commands[0], input_fd_script, output_fd_script);
   } else if (strcmp(cmd->commands[0][0], "zombify") == 0) {
@@ -181,6 +185,17 @@ pid_t u_execute_command(struct parsed_command* cmd) {
     return s_spawn(nohang, cmd->commands[0], input_fd_script, output_fd_script);
   } else if (strcmp(cmd->commands[0][0], "recur") == 0) {
     return s_spawn(recur, cmd->commands[0], input_fd_script, output_fd_script);
+  } else if (strcmp(cmd->commands[0][0], "swarm") == 0) {
+    return s_spawn(swarm, cmd->commands[0], input_fd_script, output_fd_script);
+  } else if (strcmp(cmd->commands[0][0], "lockbench") == 0) {
+    return s_spawn(lockbench, cmd->commands[0], input_fd_script,
+                   output_fd_script);
+  } else if (strcmp(cmd->commands[0][0], "shmtest") == 0) {
+    return s_spawn(shmtest, cmd->commands[0], input_fd_script,
+                   output_fd_script);
+  } else if (strcmp(cmd->commands[0][0], "msgbench") == 0) {
+    return s_spawn(msgbench, cmd->commands[0], input_fd_script,
+                   output_fd_script);
   } else if (strcmp(cmd->commands[0][0], "crash") == 0) {
     return s_spawn(crash, cmd->commands[0], input_fd_script, output_fd_script);
   }
@@ -192,6 +207,9 @@ pid_t u_execute_command(struct parsed_command* cmd) {
   } else if (strcmp(cmd->commands[0][0], "nice_pid") == 0) {
     u_nice_pid(cmd->commands[0]);
     return 0;
+  } else if (strcmp(cmd->commands[0][0], "tickets") == 0) {
+    u_tickets(cmd->commands[0]);
+    return 0;
   } else if (strcmp(cmd->commands[0][0], "man") == 0) {
     u_man(cmd->commands[0]);
     return 0;
@@ -253,17 +271,112 @@ void* u_read_and_execute_script(void* arg) {
   return NULL;
 }
 
+/**
+ * @brief Helper function that spawns a command run from the prompt as a new
+ *        job, leading its own process group, so that job control can signal
+ *        the whole job (including anything it spawns) with s_killpg.
+ */
+static pid_t spawn_job(void* (*func)(void*), char* argv[], int fd0, int fd1) {
+  spawn_attr_t attr = {.pgid = SPAWN_NEW_PGRP};
+  return s_spawn_attr(func, argv, fd0, fd1, &attr);
+}
+
+/**
+ * @brief Helper function that closes an fd the shell opened for a job but
+ *        didn't hand to a child. The standard fds are left alone.
+ */
+static void close_job_fd(int fd) {
+  if (fd > STDERR_FILENO && s_close(fd) == -1) {
+    u_perror("s_close error i.e. not a valid fd");
+  }
+}
+
+/**
+ * @brief Helper function that runs a pipeline such as `cat f | cat | cat`.
+ *        Each stage reads the pipe the stage before it writes, and every
+ *        stage joins the group of the first, so the whole pipeline is one
+ *        job. Each stage must be a program (see get_associated_ufunc).
+ *
+ * @param cmd       the parsed command, with more than one stage
+ * @param input_fd  the first stage's input, handed to it
+ * @param output_fd the last stage's output, handed to it
+ * @param pids      filled with the pid of each stage
+ * @return the pid of the first stage, which is the job's pgid, or -1 if the
+ *         pipeline couldn't be started
+ */
+static pid_t spawn_pipeline(struct parsed_command* cmd,
+                            int input_fd,
+                            int output_fd,
+                            pid_t* pids) {
+  for (size_t i = 0; i < cmd->num_commands; i++) {
+    if (get_associated_ufunc(cmd->commands[i][0]) == NULL) {
+      P_ERRNO = P_ECOMMAND;
+      u_perror(cmd->commands[i][0]);
+      close_job_fd(input_fd);
+      close_job_fd(output_fd);
+      return -1;
+    }
+  }
+
+  spawn_attr_t attr = {.pgid = SPAWN_NEW_PGRP};
+  int stage_in = input_fd;
+  for (size_t i = 0; i < cmd->num_commands; i++) {
+    // every stage but the last writes into a new pipe
+    int pipe_fds[2] = {-1, -1};
+    int stage_out = output_fd;
+    if (i + 1 < cmd->num_commands) {
+      if (s_pipe(pipe_fds) == -1) {
+        u_perror("s_pipe");
+      }
+      stage_out = pipe_fds[1];
+    }
+
+    pid_t pid = -1;
+    if (stage_out != -1) {
+      pid = s_spawn_attr(get_associated_ufunc(cmd->commands[i][0]),
+                         cmd->commands[i], stage_in, stage_out, &attr);
+      if (pid == -1) {
+        u_perror("s_spawn");
+      }
+    }
+
+    // on failure, stop the stages already running and close what's left
+    if (pid == -1) {
+      if (i > 0) {
+        s_killpg(pids[0], P_SIGTERM);
+      }
+      close_job_fd(stage_in);
+      close_job_fd(pipe_fds[0]);
+      close_job_fd(pipe_fds[1]);
+      if (stage_out != output_fd) {
+        close_job_fd(output_fd);
+      }
+      return -1;
+    }
+
+    pids[i] = pid;
+    if (i == 0) {
+      attr.pgid = pid;  // the rest join the first stage's group
+    }
+    stage_in = pipe_fds[0];
+  }
+  return pids[0];
+}
+
 /**
  * @brief Helper function to execute a parsed command from the shell.
  * In particular, it spawns a child process to execute the command if
  * the built-in should run as a separate process. Otherwise, it just
- * calls the subroutine directly.
+ * calls the subroutine directly. A command with several stages is run
+ * as a pipeline.
  *
- * @param cmd the parsed command to execute, assumed non-null
- * @return the created child id on successful spawn, 0 on successful
- *         subroutine call, -1 when nothing was called
+ * @param cmd  the parsed command to execute, assumed non-null
+ * @param pids filled with the pid of each stage of a pipeline
+ * @return the created child id on successful spawn (the first stage's for a
+ *         pipeline), 0 on successful subroutine call, -1 when nothing was
+ *         called
  */
-pid_t execute_command(struct parsed_command* cmd) {
+pid_t execute_command(struct parsed_command* cmd, pid_t* pids) {
   // setup fds
   int input_fd = STDIN_FILENO;  // standard fds
   int output_fd = STDOUT_FILENO;
@@ -286,43 +399,57 @@ pid_t execute_command(struct parsed_command* cmd) {
     output_fd = STDOUT_FILENO;  // reset to default
   }
 
+  if (cmd->num_commands > 1) {
+    return spawn_pipeline(cmd, input_fd, output_fd, pids);
+  }
+
   // check for independently scheduled processes
   if (strcmp(cmd->commands[0][0], "cat") == 0) {
-    return s_spawn(u_cat, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_cat, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "sleep") == 0) {
-    return s_spawn(u_sleep, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_sleep, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "busy") == 0) {
-    return s_spawn(u_busy, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_busy, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "echo") == 0) {
-    return s_spawn(u_echo, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_echo, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "ls") == 0) {
-    return s_spawn(u_ls, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_ls, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "touch") == 0) {
-    return s_spawn(u_touch, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_touch, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "mv") == 0) {
-    return s_spawn(u_mv, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_mv, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "cp") == 0) {
-    return s_spawn(u_cp, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_cp, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "rm") == 0) {
-    return s_spawn(u_rm, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_rm, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "chmod") == 0) {
-    return s_spawn(u_chmod, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_chmod, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "ps") == 0) {
-    return s_spawn(u_ps, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_ps, cmd->commands[0], input_fd, output_fd);
+  } else if (strcmp(cmd->commands[0][0], "schedstat") == 0) {
+    return spawn_job(u_schedstat, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "kill") == 0) {
-    return s_spawn(u_kill, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_kill, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "zombify") == 0) {
-    return s_spawn(u_zombify, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_zombify, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "orphanify") == 0) {
-    return s_spawn(u_orphanify, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(u_orphanify, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "hang") == 0) {
-    return s_spawn(hang, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(hang, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "nohang") == 0) {
-    return s_spawn(nohang, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(nohang, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "recur") == 0) {
-    return s_spawn(recur, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(recur, cmd->commands[0], input_fd, output_fd);
+  } else if (strcmp(cmd->commands[0][0], "swarm") == 0) {
+    return spawn_job(swarm, cmd->commands[0], input_fd, output_fd);
+  } else if (strcmp(cmd->commands[0][0], "lockbench") == 0) {
+    return spawn_job(lockbench, cmd->commands[0], input_fd, output_fd);
+  } else if (strcmp(cmd->commands[0][0], "shmtest") == 0) {
+    return spawn_job(shmtest, cmd->commands[0], input_fd, output_fd);
+  } else if (strcmp(cmd->commands[0][0], "msgbench") == 0) {
+    return spawn_job(msgbench, cmd->commands[0], input_fd, output_fd);
   } else if (strcmp(cmd->commands[0][0], "crash") == 0) {
-    return s_spawn(crash, cmd->commands[0], input_fd, output_fd);
+    return spawn_job(crash, cmd->commands[0], input_fd, output_fd);
   }
 
   // check for sub-routines
@@ -332,6 +459,9 @@ pid_t execute_command(struct parsed_command* cmd) {
   } else if (strcmp(cmd->commands[0][0], "nice_pid") == 0) {
     u_nice_pid(cmd->commands[0]);
     return 0;
+  } else if (strcmp(cmd->commands[0][0], "tickets") == 0) {
+    u_tickets(cmd->commands[0]);
+    return 0;
   } else if (strcmp(cmd->commands[0][0], "man") == 0) {
     u_man(cmd->commands[0]);
     return 0;
@@ -366,10 +496,12 @@ pid_t execute_command(struct parsed_command* cmd) {
 
     char* script_argv[] = {cmd->commands[0][0], NULL};
     pid_t wait_on =
-        s_spawn(u_read_and_execute_script, script_argv, input_fd, output_fd);
+        spawn_job(u_read_and_execute_script, script_argv, input_fd, output_fd);
     int status;
+    current_fg_pgid = wait_on;  // the script's commands stay in its group
     s_waitpid(wait_on, &status, false);  // wait for script to finish
-    script_fd = -1;                      // reset global
+    current_fg_pgid = 2;
+    script_fd = -1;  // reset global
     input_fd_script = STDIN_FILENO;
     output_fd_script = STDOUT_FILENO;
     if (s_close(script_fd_open) == -1) {
@@ -487,14 +619,25 @@ void* shell(void*) {
       continue;
     }
 
-    child_pid = execute_command(cmd);
+    pid_t* pids = malloc(cmd->num_commands * sizeof(pid_t));
+    if (pids == NULL) {
+      perror("Error: mallocing pids failed");
+      free(cmd);
+      continue;
+    }
+    child_pid = execute_command(cmd, pids);
     if (child_pid < 0) {
+      free(pids);
       free(cmd);
       continue;
     } else if (child_pid == 0) {
+      free(pids);
       free(cmd);
       continue;
     }
+    if (cmd->num_commands == 1) {
+      pids[0] = child_pid;
+    }
 
     // If background, add the process to the job list.
     if (cmd->is_background) {
@@ -502,20 +645,14 @@ void* shell(void*) {
       job* new_job = malloc(sizeof(job));
       if (new_job == NULL) {
         perror("Error: mallocing new_job failed");
+        free(pids);
         free(cmd);
         continue;
       }
       new_job->id = next_job_id++;
-      new_job->pgid = child_pid;  // For single commands, child's pid = pgid.
-      new_job->num_pids = 1;
-      new_job->pids = malloc(sizeof(pid_t));
-      if (new_job->pids == NULL) {
-        perror("Error: mallocing new_job->pids failed");
-        free(new_job);
-        free(cmd);
-        continue;
-      }
-      new_job->pids[0] = child_pid;
+      new_job->pgid = child_pid;  // the first stage leads the job's group
+      new_job->num_pids = cmd->num_commands;
+      new_job->pids = pids;
       new_job->state = RUNNING;
       new_job->cmd = cmd;  // Retain command info; do not free here.
       new_job->finished_count = 0;
@@ -529,33 +666,43 @@ void* shell(void*) {
         u_perror("s_write error");
       }
     } else {
-      // Foreground execution.
-      current_fg_pid = child_pid;
-      int status;
-      s_waitpid(child_pid, &status, false);
+      // Foreground execution: wait for every stage, or for one to stop
+      current_fg_pgid = child_pid;  // the job leads its own group
+      int status = 0;
+      size_t finished_count = 0;
+      while (finished_count < cmd->num_commands) {
+        if (s_waitpid(-child_pid, &status, false) < 0) {
+          if (P_ERRNO == P_EINTR) {
+            continue;
+          }
+          break;
+        }
+        if (P_WIFSTOPPED(status)) {
+          break;
+        }
+        // a stage that was only continued hasn't finished
+        if (P_WIFEXITED(status) || P_WIFSIGNALED(status)) {
+          finished_count++;
+        }
+      }
 
       if (P_WIFSTOPPED(status)) {
         // Create a new job entry (this time for a stopped process)
         job* new_job = malloc(sizeof(job));
         if (new_job == NULL) {
           perror("Error: mallocing new_job failed");
+          current_fg_pgid = 2;
+          free(pids);
           free(cmd);
           continue;
         }
         new_job->id = next_job_id++;
-        new_job->pgid = child_pid;  // For single commands, child's pid = pgid.
-        new_job->num_pids = 1;
-        new_job->pids = malloc(sizeof(pid_t));
-        if (new_job->pids == NULL) {
-          perror("Error: mallocing new_job->pids failed");
-          free(new_job);
-          free(cmd);
-          continue;
-        }
-        new_job->pids[0] = child_pid;
+        new_job->pgid = child_pid;  // the first stage leads the job's group
+        new_job->num_pids = cmd->num_commands;
+        new_job->pids = pids;
         new_job->state = STOPPED;
         new_job->cmd = cmd;  // Retain command info; do not free here.
-        new_job->finished_count = 0;
+        new_job->finished_count = finished_count;
         vec_push_back(&job_list, new_job);
 
         // Print stopped job
@@ -573,9 +720,11 @@ void* shell(void*) {
         }
         snprintf(buf, sizeof(buf), "\n");
         s_write(STDOUT_FILENO, buf, strlen(buf));
+      } else {
+        free(pids);
       }
 
-      current_fg_pid = 2;
+      current_fg_pgid = 2;
 
       // Free cmd memory for foreground commands.
       // free(cmd); // TODO --> check if this is already freed, it may be
@@ -29,7 +29,7 @@
 
 // needed for job control
 extern Vec job_list;
-extern pid_t current_fg_pid;
+extern pid_t current_fg_pgid;
 
 ////////////////////////////////////////////////////////////////////////////////
 //        The following shell built-in routines should run as                 //
@@ -61,7 +61,8 @@ void* u_sleep(void* arg) {
     return NULL;
   }
 
-  int sleep_ticks = sleep_secs * 10;
+  int sleep_ticks =
+      (int)((long long)sleep_secs * 1000000 / get_scheduler_quantum());
   s_sleep(sleep_ticks);
   s_exit();
   return NULL;
@@ -154,6 +155,16 @@ void* u_ps(void* arg) {
   return NULL;
 }
 
+/**
+ * @brief 'schedstat' program built-in that prints the scheduler's
+ *        latency and utilization histograms
+ */
+void* u_schedstat(void* arg) {
+  s_schedstat(arg);
+  s_exit();
+  return NULL;
+}
+
 /**
  * @brief Standard 'kill' program built-in that sends the
  *        specified signal to a process
@@ -241,6 +252,8 @@ void* (*get_associated_ufunc(char* func))(void*) {
     return u_chmod;
   } else if (strcmp(func, "ps") == 0) {
     return u_ps;
+  } else if (strcmp(func, "schedstat") == 0) {
+    return u_schedstat;
   } else if (strcmp(func, "kill") == 0) {
     return u_kill;
   }
@@ -294,6 +307,31 @@ void* u_nice_pid(void* arg) {
   return NULL;
 }
 
+/**
+ * @brief Sets the number of tickets of an existing process
+ */
+void* u_tickets(void* arg) {
+  char** args = (char**)arg;
+  if (args[1] == NULL || args[2] == NULL) {
+    return NULL;
+  }
+
+  char* endptr;
+  errno = 0;
+  int tickets = (int)strtol(args[1], &endptr, 10);
+  if (*endptr != '\0' || errno != 0) {  // error catch
+    return NULL;
+  }
+  pid_t pid = (pid_t)strtol(args[2], &endptr, 10);
+  if (*endptr != '\0' || errno != 0) {
+    return NULL;
+  }
+  if (s_set_tickets(pid, tickets) == -1) {
+    u_perror("tickets");
+  }
+  return NULL;
+}
+
 /**
  * @brief Lists all available commands in PennOS in terminal
  */
@@ -314,12 +352,16 @@ void* u_man(void* arg) {
       "(+x, +rw, etc)\n"
       "ps                    : lists all processes on PennOS, displaying PID, "
       "PPID, priority, status, and command name\n"
+      "schedstat             : shows histograms of scheduler dispatch "
+      "latency, quantum use, pass time and run queue depth\n"
       "kill (-__) pid1 pid 2 : sends specified signal (term default) to list "
       "of processes\n"
       "nice n command        : spawns a new process for command and sets its "
       "priority to n\n"
       "nice_pid n pid        : adjusts the priority level of an existing "
       "process to n\n"
+      "tickets n pid         : gives an existing process n tickets under the "
+      "stride and lottery schedulers (0 = follow its priority)\n"
       "man                   : lists all available commands in PennOS\n"
       "bg                    : resumes most recently stopped process in "
       "background or the one specified by job_id\n"
@@ -399,8 +441,7 @@ void* u_bg(void* arg) {
     }
     snprintf(buf, sizeof(buf), "\n");
     s_write(STDOUT_FILENO, buf, strlen(buf));
-    // P_SIGCONT is 1
-    s_kill(job_ptr->pids[0], P_SIGCONT);
+    s_killpg(job_ptr->pgid, P_SIGCONT);  // the whole job
     return NULL;
   } else if (job_ptr->state == RUNNING) {
     snprintf(buf, sizeof(buf), "bg: job [%lu] is already running\n",
@@ -452,8 +493,7 @@ void* u_fg(void* arg) {
     }
     snprintf(buf, sizeof(buf), "\n");
     s_write(STDOUT_FILENO, buf, strlen(buf));
-    // P_SIGCONT is 1
-    s_kill(job_ptr->pids[0], P_SIGCONT);
+    s_killpg(job_ptr->pgid, P_SIGCONT);  // the whole job
   } else {
     snprintf(buf, sizeof(buf), "Bringing to foreground: ");
     s_write(STDOUT_FILENO, buf, strlen(buf));
@@ -469,11 +509,11 @@ void* u_fg(void* arg) {
     snprintf(buf, sizeof(buf), "\n");
   }
 
-  current_fg_pid = job_ptr->pids[0];
+  current_fg_pgid = job_ptr->pgid;
 
   while (true) {
     int status = 0;
-    pid_t wpid = s_waitpid(job_ptr->pgid, &status, false);
+    pid_t wpid = s_waitpid(-job_ptr->pgid, &status, false);  // any member
     if (wpid < 0) {
       if (P_ERRNO == P_EINTR) {
         continue;
@@ -481,6 +521,9 @@ void* u_fg(void* arg) {
       break;
     }
     if (P_WIFEXITED(status) || P_WIFSIGNALED(status)) {
+      if (++job_ptr->finished_count < job_ptr->num_pids) {
+        continue;  // wait for the rest of the job
+      }
       job_ptr->state = FINISHED;
       // Remove finished job from list
       for (size_t i = 0; i < vec_len(&job_list); i++) {
@@ -501,7 +544,7 @@ void* u_fg(void* arg) {
   }
 
   // back to shell
-  current_fg_pid = 2;
+  current_fg_pgid = 2;
   return NULL;
 }
 
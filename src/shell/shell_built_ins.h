@@ -129,6 +129,14 @@ void* u_chmod(void* arg);
  */
 void* u_ps(void* arg);
 
+/**
+ * @brief Shows histograms (count, min, percentiles, max, mean) of the
+ * scheduler's dispatch latency, quantum use, pass time and run queue depth.
+ *
+ * Example Usage: schedstat
+ */
+void* u_schedstat(void* arg);
+
 /**
  * @brief Sends a specified signal to a list of processes.
  * If a signal name is not specified, default to "term".
@@ -147,6 +155,15 @@ void* u_kill(void* arg);
 //     than as an independent process.                                        //
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Looks up the program behind a command name, e.g. u_cat for "cat".
+ *        Only the programs nice and pipelines may run are listed.
+ *
+ * @param func the command name
+ * @return a ptr to the program, or NULL if there is none
+ */
+void* (*get_associated_ufunc(char* func))(void*);
+
 /**
  * @brief Spawn a new process for `command` and set its priority to `priority`.
  *
@@ -161,6 +178,14 @@ void* u_nice(void* arg);
  */
 void* u_nice_pid(void* arg);
 
+/**
+ * @brief Set the number of tickets of an existing process, its share of the
+ *        cpu under the stride and lottery scheduling policies.
+ *
+ * Example Usage: tickets 300 123 (gives PID 123 300 tickets)
+ */
+void* u_tickets(void* arg);
+
 /**
  * @brief Lists all available commands.
  *
@@ -0,0 +1,209 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lib/spthread.h"
+
+#define MAX_THREADS 16
+#define DEFAULT_SECONDS 2
+#define QUANTUM_NS 10000  // 10 microseconds
+
+// Measures how many context switches per second a scheduler built on
+// spthread can do: one switch is a spthread_continue of the next thread,
+// a very short quantum, then a spthread_suspend of it, like one pass of
+// the PennOS scheduler. Everything above the quantum is handshake cost.
+//
+// With several threads on a single host cpu, the host scheduler may hold
+// back the bench's own wakeups to be fair to the spinning threads, which
+// then dominates the result. One thread (the default) measures just the
+// handshake.
+//
+// In yield mode the threads suspend themselves as soon as they run, like a
+// process blocking right away, so a switch is the round trip alone. This is
+// the mode to compare backends with: under the green backend (make
+// SPTHREAD=green) spthread_continue runs the thread on the calling thread
+// until it is switched out, so in spin mode it includes the quantum.
+//
+// Spawn mode instead measures a process's whole life the way the PennOS
+// kernel drives it: spthread_create, a continue, the thread suspending
+// itself like an exiting process does, then spthread_release. The second
+// argument is the thread pool size there (0 turns the pool off).
+//
+// usage: ./bin/spthread-bench [seconds] [threads|pool size] [spin|yield|spawn]
+
+///////////////////////////////////////////////////////////////////////////////
+// thread funcs stuff
+///////////////////////////////////////////////////////////////////////////////
+
+static volatile unsigned long spins[MAX_THREADS];
+
+static void* spin(void* arg) {
+  int thread_num = *(int*)arg;
+  free(arg);
+  while (true) {
+    spins[thread_num]++;  // busy, like the PennOS busy built-in
+  }
+  return NULL;
+}
+
+static void* yield(void* arg) {
+  int thread_num = *(int*)arg;
+  free(arg);
+  while (true) {
+    spins[thread_num]++;
+    spthread_suspend_self();
+  }
+  return NULL;
+}
+
+static volatile unsigned long exits;
+
+static void* exit_right_away(void* arg) {
+  exits++;
+  while (true) {
+    spthread_suspend_self();  // waits to be reaped, like a zombie
+  }
+  return NULL;
+}
+
+static long long now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void cancel_and_join(spthread_t thread) {
+  spthread_cancel(thread);
+  spthread_continue(thread);
+  spthread_suspend(thread);  // forces the spthread to hit a cancellation point
+  spthread_join(thread, NULL);
+}
+
+static void spawn_bench(int seconds, int pool_size) {
+  if (spthread_pool_init(pool_size) != 0) {
+    perror("spthread_pool_init");
+    return;
+  }
+
+  long spawns = 0;
+  long long create_ns = 0;
+  long long release_ns = 0;
+  long long start = now_ns();
+  long long end = start + (long long)seconds * 1000000000;
+  long long now = start;
+
+  while (now < end) {
+    unsigned long exited = exits;
+
+    long long before = now_ns();
+    spthread_t thread;
+    if (spthread_create(&thread, NULL, exit_right_away, NULL) != 0) {
+      perror("spthread_create");
+      break;
+    }
+    long long created = now_ns();
+    while (exits == exited) {
+      spthread_continue(thread);
+      sched_yield();
+    }
+    long long exited_at = now_ns();
+    spthread_release(thread);
+    now = now_ns();
+
+    create_ns += created - before;
+    release_ns += now - exited_at;
+    spawns++;
+  }
+
+  double elapsed = (now - start) / 1e9;
+  printf("pool size:          %d\n", pool_size);
+  printf("spawns:             %ld in %.2f s\n", spawns, elapsed);
+  printf("spawns/sec:         %.0f\n", spawns / elapsed);
+  printf("spthread_create:    %.1f us avg\n", create_ns / 1e3 / spawns);
+  printf("spthread_release:   %.1f us avg\n", release_ns / 1e3 / spawns);
+
+  spthread_pool_destroy();
+}
+
+int main(int argc, char** argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+  if (seconds <= 0) {
+    seconds = DEFAULT_SECONDS;
+  }
+  if (argc > 3 && strcmp(argv[3], "spawn") == 0) {
+    int pool_size = argc > 2 ? atoi(argv[2]) : 0;
+    spawn_bench(seconds, pool_size < 0 ? 0 : pool_size);
+    return EXIT_SUCCESS;
+  }
+  int num_threads = argc > 2 ? atoi(argv[2]) : 1;
+  if (num_threads <= 0 || num_threads > MAX_THREADS) {
+    num_threads = 1;
+  }
+  bool yield_mode = argc > 3 && strcmp(argv[3], "yield") == 0;
+
+  spthread_set_timeslice(QUANTUM_NS / 1000);
+  spthread_t threads[MAX_THREADS];
+  for (int i = 0; i < num_threads; i++) {
+    int* arg = malloc(sizeof(int));
+    *arg = i;
+    spthread_create(&threads[i], NULL, yield_mode ? yield : spin, arg);
+  }
+
+  long long continue_ns = 0;
+  long long suspend_ns = 0;
+  long switches = 0;
+  long ran = 0;  // quanta in which the thread actually got to run
+  long long start = now_ns();
+  long long end = start + (long long)seconds * 1000000000;
+  long long now = start;
+
+  while (now < end) {
+    spthread_t curr_thread = threads[switches % num_threads];
+
+    unsigned long spun = spins[switches % num_threads];
+
+    long long before = now_ns();
+    spthread_continue(curr_thread);
+    long long continued = now_ns();
+    if (yield_mode) {
+      // under the green backend it already suspended itself, unless it was
+      // preempted on its way there last time and needs another continue
+      while (spins[switches % num_threads] == spun) {
+        sched_yield();
+        spthread_continue(curr_thread);
+      }
+    } else {
+      const struct timespec quantum = {.tv_nsec = QUANTUM_NS};
+      nanosleep(&quantum, NULL);
+    }
+    long long quantum_over = now_ns();
+    spthread_suspend(curr_thread);
+    now = now_ns();
+
+    continue_ns += continued - before;
+    suspend_ns += now - quantum_over;
+    ran += spins[switches % num_threads] != spun;
+    switches++;
+  }
+
+  double elapsed = (now - start) / 1e9;
+  printf("threads:            %d (%s)\n", num_threads,
+         yield_mode ? "yield" : "spin");
+  printf("switches:           %ld in %.2f s (%ld ran)\n", switches, elapsed,
+         ran);
+  printf("switches/sec:       %.0f\n", switches / elapsed);
+  printf("spthread_continue:  %.1f us avg\n", continue_ns / 1e3 / switches);
+  printf("spthread_suspend:   %.1f us avg\n", suspend_ns / 1e3 / switches);
+  printf("handshake/switch:   %.1f us avg\n",
+         (continue_ns + suspend_ns) / 1e3 / switches);
+
+  // cleanup
+  for (int i = 0; i < num_threads; i++) {
+    cancel_and_join(threads[i]);
+  }
+
+  return EXIT_SUCCESS;
+}